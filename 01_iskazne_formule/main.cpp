@@ -28,77 +28,76 @@ template<typename T>
 bool is(const FormulaPtr& f) { return std::holds_alternative<T>(*f);}
 
 template<typename T>
-T as(const FormulaPtr& f) { return std::get<T>(*f); }
+const T& as(const FormulaPtr& f) { return std::get<T>(*f); }
+
+// Grananje po vrsti cvora: std::visit poziva lambdu za alternativu koju formula sadrzi
+// (po referenci, bez kopiranja), a lambda sa auto parametrom pokriva preostale vrste
+template<typename... Cases>
+struct Overloaded : Cases... { using Cases::operator()...; };
+
+template<typename... Cases>
+decltype(auto) match(const FormulaPtr& f, Cases... cases) { return std::visit(Overloaded{cases...}, *f); }
 
 // Valuation
 using Valuation = std::map<std::string, bool>;
 
 int complexity(const FormulaPtr& f) {
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return 0;
-    if(is<Not>(f))
-        return 1 + complexity(as<Not>(f).subformula);
-    if(is<Binary>(f))
-        return 1 + complexity(as<Binary>(f).left) + complexity(as<Binary>(f).right);
-    return 0;
+    return match(f,
+        [](const Not& n) { return 1 + complexity(n.subformula); },
+        [](const Binary& b) { return 1 + complexity(b.left) + complexity(b.right); },
+        [](const auto&) { return 0; });
 }
 
 std::string print(const FormulaPtr& f) {
-    if(is<False>(f)) return "F";
-    if(is<True>(f))  return "T";
-    if(is<Atom>(f))  return as<Atom>(f).name;
-    if(is<Not>(f))   return "~" + print(as<Not>(f).subformula);
-    if(is<Binary>(f)) {
-        std::string sign;
-        switch(as<Binary>(f).type) {
-            case Binary::And:  sign = "&";   break;
-            case Binary::Or:   sign = "|";   break;
-            case Binary::Impl: sign = "->";  break;
-            case Binary::Eq:   sign = "<->"; break;
-        }
-        return "(" + print(as<Binary>(f).left) + " " + sign + " " + print(as<Binary>(f).right) + ")";
-    }
-    return "";
+    return match(f,
+        [](const False&) -> std::string { return "F"; },
+        [](const True&) -> std::string { return "T"; },
+        [](const Atom& a) { return a.name; },
+        [](const Not& n) { return "~" + print(n.subformula); },
+        [](const Binary& b) {
+            std::string sign;
+            switch(b.type) {
+                case Binary::And:  sign = "&";   break;
+                case Binary::Or:   sign = "|";   break;
+                case Binary::Impl: sign = "->";  break;
+                case Binary::Eq:   sign = "<->"; break;
+            }
+            return "(" + print(b.left) + " " + sign + " " + print(b.right) + ")";
+        });
 }
 
 bool evaluate(const FormulaPtr& f, Valuation& v) {
-    if(is<False>(f))
-        return false;
-    if(is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return v[as<Atom>(f).name];
-    if(is<Not>(f))
-        return !evaluate(as<Not>(f).subformula, v);
-    if(is<Binary>(f)) {
-        bool evalL = evaluate(as<Binary>(f).left, v);
-        bool evalR = evaluate(as<Binary>(f).right, v);
-        switch(as<Binary>(f).type) {
-            case Binary::And:  return evalL && evalR;
-            case Binary::Or:   return evalL || evalR;
-            case Binary::Impl: return !evalL || evalR;
-            case Binary::Eq:   return evalL == evalR;
-        }
-    }
-    return false;
+    return match(f,
+        [](const False&) { return false; },
+        [](const True&) { return true; },
+        [&](const Atom& a) { return v[a.name]; },
+        [&](const Not& n) { return !evaluate(n.subformula, v); },
+        [&](const Binary& b) {
+            bool evalL = evaluate(b.left, v);
+            bool evalR = evaluate(b.right, v);
+            switch(b.type) {
+                case Binary::And:  return evalL && evalR;
+                case Binary::Or:   return evalL || evalR;
+                case Binary::Impl: return !evalL || evalR;
+                case Binary::Eq:   return evalL == evalR;
+            }
+            return false;
+        });
 }
 
+// Obe formule su iste vrste, pa se grana samo po prvoj
 bool equal(const FormulaPtr& f, const FormulaPtr& g) {
     if(f->index() != g->index())
         return false;
 
-    if(is<False>(f) || is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return as<Atom>(f).name == as<Atom>(g).name;
-    if(is<Not>(f))
-        return equal(as<Not>(f).subformula, as<Not>(g).subformula);
-    if(is<Binary>(f)) {
-        return as<Binary>(f).type == as<Binary>(g).type &&
-               equal(as<Binary>(f).left, as<Binary>(g).left) &&
-               equal(as<Binary>(f).right, as<Binary>(g).right);
-    }
-    return false;
+    return match(f,
+        [&](const Atom& a) { return a.name == as<Atom>(g).name; },
+        [&](const Not& n) { return equal(n.subformula, as<Not>(g).subformula); },
+        [&](const Binary& b) {
+            const Binary& c = as<Binary>(g);
+            return b.type == c.type && equal(b.left, c.left) && equal(b.right, c.right);
+        },
+        [](const auto&) { return true; });
 }
 
 int main() {
@@ -0,0 +1,393 @@
+#ifndef BDD_H
+#define BDD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Redukovani uredjeni binarni dijagrami odlucivanja (ROBDD)
+// Cvor je promenljiva sa dva potomka: low (promenljiva netacna) i high (promenljiva tacna).
+// Grana (BddEdge) je indeks cvora pomeren za jedan bit, a najnizi bit oznacava komplement,
+// pa je negacija samo promena tog bita. Jedini list je cvor 0 (tacno); netacno je njegov komplement.
+// Da bi prikaz bio jedinstven, high grana cvora nikada nije komplementirana.
+using BddEdge = std::uint32_t;
+
+constexpr BddEdge BddTrue = 0;
+constexpr BddEdge BddFalse = 1;
+
+struct Bdd;
+
+struct BddManager {
+    struct Node {
+        std::uint32_t var;
+        BddEdge low, high;
+        std::uint32_t ref;      // broj grana iz drugih cvorova i spoljasnjih Bdd objekata
+    };
+
+    // Unos kes tabele za ite(f, g, h)
+    struct CacheEntry {
+        BddEdge f = UINT32_MAX, g = 0, h = 0, result = 0;
+    };
+
+    // List se nikada ne oslobadja, pa mu broj referenci ne moze pasti na nulu
+    std::vector<Node> nodes = {{UINT32_MAX, BddTrue, BddTrue, UINT32_MAX / 2}};
+    std::vector<std::uint32_t> freeNodes;
+    std::size_t dead = 0;       // cvorovi bez referenci, oslobadja ih gc()
+
+    // Jedinstvena tabela, posebna za svaku promenljivu: (low, high) -> cvor
+    std::vector<std::unordered_map<std::uint64_t, std::uint32_t>> unique;
+    std::vector<std::uint32_t> level;   // nivo promenljive (0 je koren)
+    std::vector<std::uint32_t> order;   // promenljiva na nivou
+
+    std::vector<CacheEntry> cache = std::vector<CacheEntry>(1 << 18);
+    std::size_t cacheHits = 0, cacheMisses = 0;
+
+    // Automatsko preuredjivanje promenljivih kada broj cvorova predje granicu
+    bool autoReorder = false;
+    std::size_t reorderAt = 1 << 14;
+
+    explicit BddManager(std::uint32_t varCount = 0) {
+        while(unique.size() < varCount)
+            addVariable();
+    }
+
+    std::uint32_t varCount() const { return std::uint32_t(unique.size()); }
+
+    // Broj zivih cvorova (bez lista)
+    std::size_t size() const { return nodes.size() - 1 - freeNodes.size() - dead; }
+
+    static std::uint32_t index(BddEdge e) { return e >> 1; }
+    static bool complemented(BddEdge e) { return e & 1; }
+    static bool isConstant(BddEdge e) { return index(e) == 0; }
+
+    std::uint32_t varOf(BddEdge e) const { return nodes[index(e)].var; }
+    std::uint32_t levelOf(BddEdge e) const { return isConstant(e) ? UINT32_MAX : level[varOf(e)]; }
+
+    void ref(BddEdge e) {
+        if(nodes[index(e)].ref++ == 0)
+            dead--;
+    }
+
+    void deref(BddEdge e) {
+        if(--nodes[index(e)].ref == 0)
+            dead++;
+    }
+
+    std::uint32_t addVariable() {
+        std::uint32_t var = varCount();
+        unique.emplace_back();
+        level.push_back(var);
+        order.push_back(var);
+        return var;
+    }
+
+    // Cvor (var, low, high) iz jedinstvene tabele; pravi se samo ako vec ne postoji
+    BddEdge mk(std::uint32_t var, BddEdge low, BddEdge high) {
+        if(low == high)
+            return low;
+        // high grana ne sme biti komplementirana: x ? ~h : ~l je komplement od x ? h : l
+        BddEdge negate = complemented(high);
+        low ^= negate;
+        high ^= negate;
+        std::uint64_t key = std::uint64_t(low) << 32 | high;
+        auto [it, inserted] = unique[var].try_emplace(key, 0);
+        if(inserted) {
+            std::uint32_t n;
+            if(freeNodes.empty()) {
+                n = std::uint32_t(nodes.size());
+                nodes.push_back({});
+            }
+            else {
+                n = freeNodes.back();
+                freeNodes.pop_back();
+            }
+            nodes[n] = {var, low, high, 0};
+            ref(low);
+            ref(high);
+            dead++;
+            it->second = n;
+        }
+        return (it->second << 1) ^ negate;
+    }
+
+    // Kofaktori grane po promenljivoj sa datog nivoa: (high, low)
+    std::pair<BddEdge, BddEdge> cofactors(BddEdge e, std::uint32_t lvl) const {
+        if(levelOf(e) != lvl)
+            return {e, e};
+        const Node& node = nodes[index(e)];
+        BddEdge negate = complemented(e);
+        return {node.high ^ negate, node.low ^ negate};
+    }
+
+    BddEdge iteRec(BddEdge f, BddEdge g, BddEdge h) {
+        if(f == BddTrue)
+            return g;
+        if(f == BddFalse)
+            return h;
+        if(g == f)
+            g = BddTrue;
+        else if(g == (f ^ 1))
+            g = BddFalse;
+        if(h == f)
+            h = BddFalse;
+        else if(h == (f ^ 1))
+            h = BddTrue;
+        if(g == h)
+            return g;
+        if(g == BddTrue && h == BddFalse)
+            return f;
+        if(g == BddFalse && h == BddTrue)
+            return f ^ 1;
+        // Normalizacija: f i g bez komplementa, da bi jednaki pozivi imali isti kljuc u kesu
+        if(complemented(f)) {
+            f ^= 1;
+            std::swap(g, h);
+        }
+        BddEdge negate = complemented(g);
+        g ^= negate;
+        h ^= negate;
+
+        CacheEntry& entry = cache[(f * 12582917u ^ g * 4256249u ^ h * 741457u) & (cache.size() - 1)];
+        if(entry.f == f && entry.g == g && entry.h == h) {
+            cacheHits++;
+            return entry.result ^ negate;
+        }
+        cacheMisses++;
+
+        std::uint32_t top = std::min({levelOf(f), levelOf(g), levelOf(h)});
+        auto [f1, f0] = cofactors(f, top);
+        auto [g1, g0] = cofactors(g, top);
+        auto [h1, h0] = cofactors(h, top);
+        BddEdge t = iteRec(f1, g1, h1);
+        BddEdge e = iteRec(f0, g0, h0);
+        BddEdge result = mk(order[top], e, t);
+        entry = {f, g, h, result};
+        return result ^ negate;
+    }
+
+    void clearCache() {
+        std::fill(begin(cache), end(cache), CacheEntry{});
+    }
+
+    // Oslobadja cvorove bez referenci (i potomke koji time ostanu bez referenci)
+    void gc() {
+        if(dead == 0)
+            return;
+        std::vector<std::uint32_t> stack;
+        for(std::uint32_t n = 1; n < nodes.size(); n++)
+            if(nodes[n].ref == 0 && nodes[n].var != UINT32_MAX)
+                stack.push_back(n);
+        while(!stack.empty()) {
+            std::uint32_t n = stack.back();
+            stack.pop_back();
+            Node& node = nodes[n];
+            unique[node.var].erase(std::uint64_t(node.low) << 32 | node.high);
+            for(BddEdge child : {node.low, node.high})
+                if(--nodes[index(child)].ref == 0)
+                    stack.push_back(index(child));
+            node.var = UINT32_MAX;
+            freeNodes.push_back(n);
+        }
+        dead = 0;
+        clearCache();
+    }
+
+    // Zamena promenljivih na nivoima lvl i lvl + 1
+    // Cvorovi se menjaju u mestu, pa sve postojece grane i dalje predstavljaju iste funkcije
+    void swapLevels(std::uint32_t lvl) {
+        std::uint32_t x = order[lvl], y = order[lvl + 1];
+        std::vector<std::uint32_t> xNodes;
+        for(const auto& [key, n] : unique[x])
+            xNodes.push_back(n);
+        for(std::uint32_t n : xNodes) {
+            BddEdge f1 = nodes[n].high, f0 = nodes[n].low;
+            if(levelOf(f1) != lvl + 1 && levelOf(f0) != lvl + 1)
+                continue;
+            auto [f11, f10] = cofactors(f1, lvl + 1);
+            auto [f01, f00] = cofactors(f0, lvl + 1);
+            BddEdge high = mk(x, f01, f11);
+            ref(high);
+            BddEdge low = mk(x, f00, f10);
+            ref(low);
+            unique[x].erase(std::uint64_t(f0) << 32 | f1);
+            deref(f1);
+            deref(f0);
+            nodes[n].var = y;
+            nodes[n].low = low;
+            nodes[n].high = high;
+            unique[y].emplace(std::uint64_t(low) << 32 | high, n);
+        }
+        std::swap(order[lvl], order[lvl + 1]);
+        level[x] = lvl + 1;
+        level[y] = lvl;
+    }
+
+    // Premesta promenljivu na nivo target zamenama susednih nivoa
+    void moveTo(std::uint32_t var, std::uint32_t target) {
+        while(level[var] < target) {
+            swapLevels(level[var]);
+            gc();
+        }
+        while(level[var] > target) {
+            swapLevels(level[var] - 1);
+            gc();
+        }
+    }
+
+    // Prosejavanje (sifting): svaka promenljiva se pomera kroz sve nivoe i ostavlja na nivou
+    // na kom je dijagram najmanji. Smer se napusta cim dijagram poraste za vise od 20%.
+    void reorder() {
+        gc();
+        std::vector<std::uint32_t> vars(varCount());
+        for(std::uint32_t v = 0; v < varCount(); v++)
+            vars[v] = v;
+        std::sort(begin(vars), end(vars), [&](std::uint32_t a, std::uint32_t b) {
+            return unique[a].size() > unique[b].size();
+        });
+        for(std::uint32_t var : vars) {
+            std::size_t best = size();
+            std::uint32_t bestLevel = level[var];
+            for(int direction : {1, -1}) {
+                while(direction > 0 ? level[var] + 1 < varCount() : level[var] > 0) {
+                    moveTo(var, level[var] + direction);
+                    if(size() < best) {
+                        best = size();
+                        bestLevel = level[var];
+                    }
+                    if(size() > best + best / 5)
+                        break;
+                }
+            }
+            moveTo(var, bestLevel);
+        }
+    }
+
+    // Sigurna tacka (nema nereferenciranih medjurezultata): sakupljanje smeca i preuredjivanje
+    void maintain() {
+        if(dead > size())
+            gc();
+        if(autoReorder && size() > reorderAt) {
+            reorder();
+            reorderAt = std::max(reorderAt, 2 * size());
+        }
+    }
+
+    Bdd wrap(BddEdge e);
+    Bdd constant(bool value);
+    Bdd var(std::uint32_t v);
+    Bdd ite(const Bdd& f, const Bdd& g, const Bdd& h);
+
+    // Broj cvorova dijagrama grane e (bez lista)
+    std::size_t nodeCount(BddEdge e) const {
+        std::vector<std::uint8_t> seen(nodes.size());
+        std::vector<std::uint32_t> stack = {index(e)};
+        std::size_t count = 0;
+        while(!stack.empty()) {
+            std::uint32_t n = stack.back();
+            stack.pop_back();
+            if(n == 0 || seen[n])
+                continue;
+            seen[n] = 1;
+            count++;
+            stack.push_back(index(nodes[n].low));
+            stack.push_back(index(nodes[n].high));
+        }
+        return count;
+    }
+
+    // Verovatnoca da je funkcija tacna za slucajnu valuaciju, za svaki cvor jednom
+    double probability(BddEdge e, std::unordered_map<std::uint32_t, double>& memo) const {
+        double p = 1;
+        if(!isConstant(e)) {
+            auto it = memo.find(index(e));
+            if(it != memo.end())
+                p = it->second;
+            else {
+                const Node& node = nodes[index(e)];
+                p = (probability(node.low, memo) + probability(node.high, memo)) / 2;
+                memo.emplace(index(e), p);
+            }
+        }
+        return complemented(e) ? 1 - p : p;
+    }
+};
+
+// Spoljasnja referenca na dijagram: dok postoji, gc() ne oslobadja njegove cvorove
+struct Bdd {
+    BddManager* manager = nullptr;
+    BddEdge edge = BddFalse;
+
+    Bdd() = default;
+    Bdd(BddManager* manager, BddEdge edge) : manager(manager), edge(edge) { manager->ref(edge); }
+    Bdd(const Bdd& other) : manager(other.manager), edge(other.edge) {
+        if(manager)
+            manager->ref(edge);
+    }
+    Bdd(Bdd&& other) noexcept : manager(other.manager), edge(other.edge) { other.manager = nullptr; }
+    Bdd& operator=(Bdd other) noexcept {
+        std::swap(manager, other.manager);
+        std::swap(edge, other.edge);
+        return *this;
+    }
+    ~Bdd() {
+        if(manager)
+            manager->deref(edge);
+    }
+
+    // Zbog jedinstvenosti prikaza, funkcije su jednake akko su grane jednake
+    bool operator==(const Bdd& other) const { return edge == other.edge; }
+
+    bool isTrue() const { return edge == BddTrue; }
+    bool isFalse() const { return edge == BddFalse; }
+
+    Bdd operator!() const { return manager->wrap(edge ^ 1); }
+    Bdd operator&(const Bdd& other) const { return manager->ite(*this, other, manager->constant(false)); }
+    Bdd operator|(const Bdd& other) const { return manager->ite(*this, manager->constant(true), other); }
+    Bdd operator^(const Bdd& other) const { return manager->ite(*this, !other, other); }
+};
+
+Bdd BddManager::wrap(BddEdge e) { return Bdd(this, e); }
+Bdd BddManager::constant(bool value) { return wrap(value ? BddTrue : BddFalse); }
+
+Bdd BddManager::var(std::uint32_t v) {
+    while(varCount() <= v)
+        addVariable();
+    return wrap(mk(v, BddFalse, BddTrue));
+}
+
+Bdd BddManager::ite(const Bdd& f, const Bdd& g, const Bdd& h) {
+    maintain();
+    return wrap(iteRec(f.edge, g.edge, h.edge));
+}
+
+// Broj modela funkcije nad promenljivama 0, ..., varCount - 1
+double satCount(const Bdd& f, std::uint32_t varCount) {
+    std::unordered_map<std::uint32_t, double> memo;
+    double count = f.manager->probability(f.edge, memo);
+    for(std::uint32_t i = 0; i < varCount; i++)
+        count *= 2;
+    return count;
+}
+
+// Jedan model funkcije: vrednost svake promenljive (-1 ako nije bitna), ili nista ako je nezadovoljiva
+std::optional<std::vector<signed char>> anySat(const Bdd& f) {
+    if(f.isFalse())
+        return {};
+    const BddManager& m = *f.manager;
+    std::vector<signed char> values(m.varCount(), -1);
+    BddEdge e = f.edge;
+    while(!BddManager::isConstant(e)) {
+        const BddManager::Node& node = m.nodes[BddManager::index(e)];
+        BddEdge negate = BddManager::complemented(e);
+        // Grana ka netacnom je jedina koja nema model; tada je druga grana zadovoljiva
+        bool high = (node.low ^ negate) == BddFalse;
+        values[node.var] = high;
+        e = (high ? node.high : node.low) ^ negate;
+    }
+    return values;
+}
+
+#endif //BDD_H
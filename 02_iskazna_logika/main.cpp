@@ -2,8 +2,40 @@
 #include <variant>
 #include <optional>
 #include <memory>
+#include <vector>
+#include <utility>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <string_view>
+#include <random>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "bdd.h"
 
 // Structures for defining a Formula
 struct False;
@@ -18,19 +50,388 @@ using FormulaPtr = std::shared_ptr<Formula>;
 struct False {};
 struct True {};
 struct Atom { std::string name; };
-struct Not { FormulaPtr subformula; };
+struct Not {
+    FormulaPtr subformula;
+    ~Not();
+};
 struct Binary {
     enum Type { And, Or, Impl, Eq } type;
     FormulaPtr left, right;
+    ~Binary();
+};
+
+// Grananje po vrsti cvora: match(f, lambde...) poziva lambdu za alternativu koju cvor sadrzi,
+// i to po referenci, bez kopiranja. std::visit bira lambdu jednim skokom po indeksu alternative
+// umesto niza provera is<T>, a lambda sa auto parametrom pokriva sve preostale vrste.
+template<typename... Cases>
+struct Overloaded : Cases... { using Cases::operator()...; };
+
+template<typename... Cases>
+decltype(auto) match(const Formula& f, Cases... cases) { return std::visit(Overloaded{cases...}, f); }
+
+template<typename... Cases>
+decltype(auto) match(const FormulaPtr& f, Cases... cases) { return std::visit(Overloaded{cases...}, *f); }
+
+// Jedinstvena tabela (hash-consing): cvor se pravi samo ako strukturno jednak cvor
+// vec ne postoji, pa su jednake formule uvek isti pokazivac. Cvor odredjuju vrsta cvora
+// i pokazivaci na potformule (koje su i same jedinstvene), odnosno ime atoma.
+std::size_t mixHash(std::size_t h) {
+    h *= 0x9E3779B97F4A7C15;
+    return h ^ (h >> 29);
+}
+
+// Hes cvora ~sub, odnosno (left type right), samo od pokazivaca na potformule
+// 0 oznacava prazno mesto u tabeli, pa hes nikad nije 0
+std::size_t notHash(const Formula* sub) {
+    std::size_t h = mixHash(std::size_t(sub) ^ 3);
+    return h ? h : 1;
+}
+
+std::size_t binaryHash(Binary::Type type, const Formula* left, const Formula* right) {
+    std::size_t h = mixHash(mixHash(std::size_t(left) ^ (4 + 8 * type)) ^ std::size_t(right));
+    return h ? h : 1;
+}
+
+std::size_t nodeHash(const Formula& f) {
+    std::size_t h = match(f,
+        [&](const Atom& a) { return mixHash(std::hash<std::string>()(a.name) ^ f.index()); },
+        [&](const Not& n) { return notHash(n.subformula.get()); },
+        [&](const Binary& b) { return binaryHash(b.type, b.left.get(), b.right.get()); },
+        [&](const auto&) { return mixHash(f.index() + 1); });
+    return h ? h : 1;
+}
+
+bool sameNode(const Formula& f, const Formula& g) {
+    if(f.index() != g.index())
+        return false;
+    return match(f,
+        [&](const Atom& a) { return a.name == std::get<Atom>(g).name; },
+        [&](const Not& n) { return n.subformula == std::get<Not>(g).subformula; },
+        [&](const Binary& b) {
+            const Binary& c = std::get<Binary>(g);
+            return b.type == c.type && b.left == c.left && b.right == c.right;
+        },
+        [&](const auto&) { return true; });
+}
+
+// Arena za cvorove formula: memorija se uzima od sistema u velikim blokovima, pa je pravljenje
+// cvora obicno samo pomeranje pokazivaca. Memorija unistenog cvora se vraca u listu slobodnih
+// mesta njegove velicine i koristi za sledeci cvor te velicine, pa arena ne raste dok ne raste
+// broj zivih cvorova. Blokovi se vracaju sistemu odjednom (clear) kada u areni nema zivih cvorova.
+struct NodeArena {
+    static constexpr std::size_t BlockSize = 1 << 16;
+    // Mesta su poravnata na Granule bajtova; mesta do SizeClasses * Granule bajtova se ponovo koriste
+    static constexpr std::size_t Granule = 16;
+    static constexpr std::size_t SizeClasses = 16;
+
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::size_t used = BlockSize;
+    std::size_t allocated = 0;
+    std::atomic<std::size_t> live = 0;
+    // Broj unistenih cvorova; njihova memorija ostaje zauzeta dok postoje slabi pokazivaci na njih
+    std::atomic<std::size_t> destroyed = 0;
+    // Arena iz ArenaScope koji je zavrsen: oslobadja se cim u njoj vise nema zivih cvorova
+    bool retired = false;
+    // Slobodna mesta po velicini. Cvor moze da se unisti u bilo kojoj niti, pa se njegovo mesto
+    // atomicno dodaje u returned; allocate (pod bravom pozivaoca) preuzima celu tu listu odjednom
+    // kada mu ponestane mesta u free, pa mesto iz liste skida samo jedna nit u svakom trenutku.
+    std::array<FreeSlot*, SizeClasses> free{};
+    std::array<std::atomic<FreeSlot*>, SizeClasses> returned{};
+
+    static std::size_t sizeClass(std::size_t size, std::size_t align) {
+        return align <= Granule ? (size + Granule - 1) / Granule - 1 : SizeClasses;
+    }
+
+    void* allocate(std::size_t size, std::size_t align) {
+        allocated++;
+        live++;
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            if(!free[c] && returned[c].load(std::memory_order_relaxed))
+                free[c] = returned[c].exchange(nullptr, std::memory_order_acquire);
+            if(FreeSlot* slot = free[c]) {
+                free[c] = slot->next;
+                return slot;
+            }
+            size = (c + 1) * Granule;
+            align = Granule;
+        }
+        used = (used + align - 1) / align * align;
+        if(used + size > BlockSize) {
+            blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(BlockSize));
+            used = 0;
+        }
+        void* p = blocks.back().get() + used;
+        used += size;
+        return p;
+    }
+
+    void deallocate(void* p, std::size_t size, std::size_t align) {
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            FreeSlot* slot = new(p) FreeSlot{returned[c].load(std::memory_order_relaxed)};
+            while(!returned[c].compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {}
+        }
+        live--;
+    }
+
+    bool clear() {
+        if(live > 0)
+            return false;
+        blocks.clear();
+        used = BlockSize;
+        free.fill(nullptr);
+        for(auto& list : returned)
+            list.store(nullptr, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+// Arena u koju ova nit smesta nove cvorove (vidi ArenaScope); nullptr je zajednicka arena
+thread_local NodeArena* scopeArena = nullptr;
+
+// Alokator preko kog std::allocate_shared smesta cvor zajedno sa brojacem referenci u arenu
+template<typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    NodeArena* arena;
+
+    explicit ArenaAllocator(NodeArena* arena) : arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, std::size_t n) { arena->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    template<typename U>
+    void destroy(U* p) {
+        p->~U();
+        arena->destroyed++;
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+};
+
+// Tabela cuva slabe pokazivace, pa ne odrzava cvorove u zivotu: kada se formula unisti,
+// njen unos istekne, a istekli unosi se uklanjaju kada se tabela prosiruje. Tabela je niz sa
+// otvorenim adresiranjem (linearno trazenje) koji pamti i hes svakog cvora, pa se pri trazenju
+// ne pravi kljuc, a cvor se cita (zakljucava i poredi) samo kada mu je hes jednak trazenom.
+struct UniqueTable {
+    struct Entry {
+        std::size_t hash = 0;
+        std::weak_ptr<Formula> node;
+    };
+
+    std::mutex mutex;
+    NodeArena arena;
+    // Arene iz ArenaScope, i zavrsene dok u njima jos ima zivih cvorova
+    std::vector<std::unique_ptr<NodeArena>> scopes;
+    std::vector<Entry> entries = std::vector<Entry>(1024);
+    // Zauzeta mesta, ukljucujuci istekle unose
+    std::size_t used = 0;
+    // destroyedNodes() pri poslednjem izbacivanju isteklih unosa
+    std::size_t destroyedAtSweep = 0;
+
+    std::size_t size() const { return used; }
+
+    std::size_t destroyedNodes() const {
+        std::size_t count = arena.destroyed;
+        for(const auto& scope : scopes)
+            count += scope->destroyed;
+        return count;
+    }
+
+    // Not i Binary imaju destruktor, pa nemaju implicitni konstruktor premestanja: std::move bi
+    // ih kopirao, uz atomicne promene brojaca referenci potformula. Cvor se zato pravi od delova
+    // iz f, koji se premestaju.
+    FormulaPtr allocate(Formula& f) {
+        ArenaAllocator<Formula> allocator(scopeArena ? scopeArena : &arena);
+        return std::visit(Overloaded{
+            [&](Not& n) {
+                return std::allocate_shared<Formula>(allocator, std::in_place_type<Not>, std::move(n.subformula));
+            },
+            [&](Binary& b) {
+                return std::allocate_shared<Formula>(allocator, std::in_place_type<Binary>, b.type,
+                                                     std::move(b.left), std::move(b.right));
+            },
+            [&](auto& g) { return std::allocate_shared<Formula>(allocator, std::move(g)); }}, f);
+    }
+
+    // Premesta unose u tabelu sa capacity mesta
+    void rebuild(std::size_t capacity) {
+        std::vector<Entry> old = std::exchange(entries, std::vector<Entry>(capacity));
+        used = 0;
+        for(Entry& entry : old)
+            if(entry.hash != 0)
+                place(entry.hash, std::move(entry.node));
+    }
+
+    // Izbacuje istekle unose (zivi unosi su posle toga najvise cetvrtina mesta) i oslobadja
+    // arene zavrsenih ArenaScope u kojima vise nema zivih cvorova
+    void sweep() {
+        destroyedAtSweep = destroyedNodes();
+        std::vector<Entry> live;
+        for(Entry& entry : entries)
+            if(entry.hash != 0 && !entry.node.expired())
+                live.push_back(std::move(entry));
+        std::size_t capacity = 1024;
+        while(capacity < 4 * live.size())
+            capacity *= 2;
+        entries.assign(capacity, Entry{});
+        used = 0;
+        for(Entry& entry : live)
+            place(entry.hash, std::move(entry.node));
+        std::erase_if(scopes, [](const auto& scope) { return scope->retired && scope->live == 0; });
+    }
+
+    // Kada su tri cetvrtine tabele zauzete, istekli unosi se izbacuju ako ih je bar polovina
+    // (arena broji unistene cvorove), a inace se tabela samo udvostrucuje. Hes je u unosu, pa duze
+    // trazenje pri vecoj popunjenosti ne cita cvorove, a tabela zauzima upola manje memorije.
+    void reserve(std::size_t count) {
+        if(4 * (used + count) <= 3 * entries.size())
+            return;
+        if(2 * (destroyedNodes() - destroyedAtSweep) >= used)
+            sweep();
+        while(4 * (used + count) > 3 * entries.size())
+            rebuild(2 * entries.size());
+    }
+
+    // Upisuje unos za cvor za koji se zna da nije u tabeli (mesto mora postojati, vidi reserve)
+    void place(std::size_t hash, std::weak_ptr<Formula> node) {
+        std::size_t mask = entries.size() - 1;
+        std::size_t i = hash & mask;
+        while(entries[i].hash != 0)
+            i = (i + 1) & mask;
+        entries[i] = {hash, std::move(node)};
+        used++;
+    }
+
+    void prefetch(std::size_t hash) const {
+        __builtin_prefetch(&entries[hash & (entries.size() - 1)]);
+    }
+
+    // Trazi cvor sa hesom hash za koji same vraca true, bez upisivanja (poziva se pod bravom)
+    template<typename Same>
+    FormulaPtr find(std::size_t hash, Same same) const {
+        std::size_t mask = entries.size() - 1;
+        for(std::size_t i = hash & mask; entries[i].hash != 0; i = (i + 1) & mask)
+            if(entries[i].hash == hash)
+                if(FormulaPtr node = entries[i].node.lock(); node && same(*node))
+                    return node;
+        return nullptr;
+    }
+
+    // Poziva se pod bravom (mutex). Istekli unosi ostaju do sledeceg sweep(): provera da li je
+    // unos istekao bi citala sam cvor, pa se cvorovi citaju samo kada im je hes jednak trazenom.
+    FormulaPtr intern(Formula f, std::size_t hash) {
+        reserve(1);
+        std::size_t mask = entries.size() - 1;
+        std::size_t i = hash & mask;
+        for(; entries[i].hash != 0; i = (i + 1) & mask)
+            if(entries[i].hash == hash)
+                if(FormulaPtr node = entries[i].node.lock(); node && sameNode(*node, f))
+                    return node;
+        FormulaPtr node = allocate(f);
+        entries[i] = {hash, node};
+        used++;
+        return node;
+    }
+
+    FormulaPtr intern(Formula f) {
+        std::size_t hash = nodeHash(f);
+        return intern(std::move(f), hash);
+    }
 };
 
-FormulaPtr ptr(const Formula& f) { return std::make_shared<Formula>(f); }
+UniqueTable& uniqueTable() {
+    static UniqueTable table;
+    return table;
+}
+
+FormulaPtr ptr(Formula f) {
+    UniqueTable& table = uniqueTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.intern(std::move(f));
+}
+
+// Vraca svu memoriju cvorova odjednom, npr. posle obrade jednog problema
+// Uspeva samo ako nijedna formula vise nije ziva
+bool releaseFormulas() {
+    UniqueTable& table = uniqueTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    table.sweep();
+    return table.size() == 0 && table.arena.clear();
+}
+
+// Arena jednog problema: dok je ArenaScope ziv, nove cvorove ova nit smesta u njegovu arenu.
+// Kada se zavrsi, arena se vraca sistemu cim u njoj vise nema zivih cvorova, i kada su cvorovi
+// drugih problema (u zajednickoj ili drugim arenama) jos zivi, sto releaseFormulas ne moze.
+// Cvor iz arene problema moze da se deli i sa kasnijim formulama (jedinstvena tabela); tada
+// arena ostaje dok i takve formule ne nestanu.
+struct ArenaScope {
+    NodeArena* arena;
+    NodeArena* previous;
+
+    ArenaScope() {
+        UniqueTable& table = uniqueTable();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        arena = table.scopes.emplace_back(std::make_unique<NodeArena>()).get();
+        previous = std::exchange(scopeArena, arena);
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ~ArenaScope() {
+        scopeArena = previous;
+        UniqueTable& table = uniqueTable();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        arena->retired = true;
+        table.sweep();
+    }
+};
+
+// Unistavanje formule bez rekurzije: potformule cvora koji se unistava se ne unistavaju
+// odmah (sto bi kod dubokih formula prepunilo stek), vec se odlazu na stek i unistavaju redom
+void release(FormulaPtr& f) {
+    static thread_local std::vector<FormulaPtr>* pending = nullptr;
+    if(!f)
+        return;
+    if(pending) {
+        pending->push_back(std::move(f));
+        return;
+    }
+    // Cvor koji jos neko koristi se ne unistava, pa stek nije potreban
+    if(f.use_count() > 1) {
+        f.reset();
+        return;
+    }
+    std::vector<FormulaPtr> stack;
+    pending = &stack;
+    stack.push_back(std::move(f));
+    while(!stack.empty()) {
+        FormulaPtr g = std::move(stack.back());
+        stack.pop_back();
+    }
+    pending = nullptr;
+}
+
+Not::~Not() {
+    release(subformula);
+}
+Binary::~Binary() {
+    release(left);
+    release(right);
+}
 
 template<typename T>
 bool is(const FormulaPtr& f) { return std::holds_alternative<T>(*f);}
 
 template<typename T>
-T as(const FormulaPtr& f) { return std::get<T>(*f); }
+const T& as(const FormulaPtr& f) { return std::get<T>(*f); }
 
 // Valuation
 using Valuation = std::map<std::string, bool>;
@@ -38,103 +439,228 @@ using Valuation = std::map<std::string, bool>;
 // AtomSet
 using AtomSet = std::set<std::string>;
 
-int complexity(const FormulaPtr& f) {
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return 0;
-    if(is<Not>(f))
-        return 1 + complexity(as<Not>(f).subformula);
-    if(is<Binary>(f))
-        return 1 + complexity(as<Binary>(f).left) + complexity(as<Binary>(f).right);
-    return 0;
+// Obilazak formule bez rekurzije
+// Duboke formule (npr. konjunkcija milion atoma) bi rekurzijom prepunile stek programa,
+// zato funkcije nad formulama koriste eksplicitni stek
+
+// i-ta potformula formule f, ili nullptr ako je nema
+const FormulaPtr* subformula(const FormulaPtr& f, int i) {
+    return match(f,
+        [&](const Not& n) -> const FormulaPtr* { return i == 0 ? &n.subformula : nullptr; },
+        [&](const Binary& b) -> const FormulaPtr* { return i == 0 ? &b.left : i == 1 ? &b.right : nullptr; },
+        [](const auto&) -> const FormulaPtr* { return nullptr; });
 }
 
-std::string print(const FormulaPtr& f) {
-    if(is<False>(f)) return "F";
-    if(is<True>(f))  return "T";
-    if(is<Atom>(f))  return as<Atom>(f).name;
-    if(is<Not>(f))   return "~" + print(as<Not>(f).subformula);
-    if(is<Binary>(f)) {
-        std::string sign;
-        switch(as<Binary>(f).type) {
-            case Binary::And:  sign = "&";   break;
-            case Binary::Or:   sign = "|";   break;
-            case Binary::Impl: sign = "->";  break;
-            case Binary::Eq:   sign = "<->"; break;
-        }
-        return "(" + print(as<Binary>(f).left) + " " + sign + " " + print(as<Binary>(f).right) + ")";
+// walk poziva visit(g, i) za cvor g pre obilaska njegove i-te potformule i jos jednom posle
+// poslednje, pa se isti obilazak koristi za prefiksni, infiksni i postfiksni redosled
+template<typename Visit>
+void walk(const FormulaPtr& f, Visit visit) {
+    std::vector<std::pair<const FormulaPtr*, int>> stack = {{&f, 0}};
+    while(!stack.empty()) {
+        auto [g, i] = stack.back();
+        visit(*g, i);
+        if(const FormulaPtr* sub = subformula(*g, i)) {
+            stack.back().second++;
+            stack.emplace_back(sub, 0);
+        } else
+            stack.pop_back();
     }
-    return "";
 }
 
-bool evaluate(const FormulaPtr& f, Valuation& v) {
-    if(is<False>(f))
-        return false;
-    if(is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return v[as<Atom>(f).name];
-    if(is<Not>(f))
-        return !evaluate(as<Not>(f).subformula, v);
-    if(is<Binary>(f)) {
-        bool evalL = evaluate(as<Binary>(f).left, v);
-        bool evalR = evaluate(as<Binary>(f).right, v);
-        switch(as<Binary>(f).type) {
-            case Binary::And:  return evalL && evalR;
-            case Binary::Or:   return evalL || evalR;
-            case Binary::Impl: return !evalL || evalR;
-            case Binary::Eq:   return evalL == evalR;
+// fold racuna rezultat u postfiksnom redosledu: child(frame, i) vraca stanje i-tog potomka
+// (stanje pored cvora moze da nosi i dodatne podatke, npr. da li je cvor pod negacijom),
+// a combine(frame, args) pravi rezultat cvora od rezultata potomaka
+template<typename Result, typename Frame, typename Child, typename Combine>
+Result fold(Frame root, Child child, Combine combine) {
+    std::vector<std::pair<Frame, int>> stack = {{root, 0}};
+    std::vector<Result> results;
+    Result args[4];
+    while(!stack.empty()) {
+        auto& [frame, i] = stack.back();
+        std::optional<Frame> next = child(frame, i);
+        if(next) {
+            i++;
+            stack.emplace_back(*next, 0);
+            continue;
         }
+        for(int k = i - 1; k >= 0; k--) {
+            args[k] = std::move(results.back());
+            results.pop_back();
+        }
+        results.push_back(combine(std::as_const(frame), args));
+        stack.pop_back();
     }
-    return false;
+    return std::move(results.back());
 }
 
-bool equal(const FormulaPtr& f, const FormulaPtr& g) {
-    if(f->index() != g->index())
-        return false;
+// Najcesci slucaj: stanje je sam cvor, a potomci su njegove potformule
+template<typename Result, typename Combine>
+Result fold(const FormulaPtr& f, Combine combine) {
+    auto child = [](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    return fold<Result>(&f, child, [&](const FormulaPtr* g, Result* args) { return combine(*g, args); });
+}
 
-    if(is<False>(f) || is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return as<Atom>(f).name == as<Atom>(g).name;
-    if(is<Not>(f))
-        return equal(as<Not>(f).subformula, as<Not>(g).subformula);
-    if(is<Binary>(f)) {
-        return as<Binary>(f).type == as<Binary>(g).type &&
-               equal(as<Binary>(f).left, as<Binary>(g).left) &&
-               equal(as<Binary>(f).right, as<Binary>(g).right);
+// Kao fold, ali se rezultat racuna jednom za svaki kljuc stanja (npr. cvor i polaritet).
+// Kako su iste potformule isti cvor, formula se obradjuje kao DAG: zajednicke potformule
+// se ne obilaze ponovo, a rezultat je DAG velicine linearne u velicini ulaza.
+template<typename Result, typename Frame, typename Key, typename Child, typename Combine>
+Result foldShared(Frame root, Key key, Child child, Combine combine) {
+    std::unordered_map<std::uintptr_t, Result> memo;
+    auto memoChild = [&](const Frame& frame, int i) -> std::optional<Frame> {
+        if(memo.contains(key(frame)))
+            return {};
+        return child(frame, i);
+    };
+    return fold<Result>(root, memoChild, [&](const Frame& frame, Result* args) -> Result {
+        auto it = memo.find(key(frame));
+        if(it != memo.end())
+            return it->second;
+        Result result = combine(frame, args);
+        memo.emplace(key(frame), result);
+        return result;
+    });
+}
+
+// Najcesci slucaj: kljuc je sam cvor
+template<typename Result, typename Combine>
+Result foldShared(const FormulaPtr& f, Combine combine) {
+    auto key = [](const FormulaPtr* g) { return reinterpret_cast<std::uintptr_t>(g->get()); };
+    auto child = [](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    return foldShared<Result>(&f, key, child, [&](const FormulaPtr* g, Result* args) { return combine(*g, args); });
+}
+
+// Broj veznika u stablu formule. Ne treba rezultat po cvoru, pa umesto fold (koji za svaki cvor
+// posebno trazi i-tu potformulu i slaze rezultate potomaka) cvorovi idu kroz stek, uz jedan
+// match po cvoru.
+int complexity(const FormulaPtr& f) {
+    int count = 0;
+    std::vector<const Formula*> stack = {f.get()};
+    while(!stack.empty()) {
+        const Formula* g = stack.back();
+        stack.pop_back();
+        match(*g,
+            [&](const Not& n) {
+                count++;
+                stack.push_back(n.subformula.get());
+            },
+            [&](const Binary& b) {
+                count++;
+                stack.push_back(b.right.get());
+                stack.push_back(b.left.get());
+            },
+            [](const auto&) {});
+    }
+    return count;
+}
+
+std::string sign(Binary::Type type) {
+    switch(type) {
+        case Binary::And:  return "&";
+        case Binary::Or:   return "|";
+        case Binary::Impl: return "->";
+        case Binary::Eq:   return "<->";
     }
-    return false;
+    return "";
+}
+
+std::string print(const FormulaPtr& f) {
+    std::string result;
+    walk(f, [&](const FormulaPtr& g, int i) {
+        match(g,
+            [&](const False&) { result += "F"; },
+            [&](const True&) { result += "T"; },
+            [&](const Atom& a) { result += a.name; },
+            [&](const Not&) {
+                if(i == 0)
+                    result += "~";
+            },
+            [&](const Binary& b) {
+                if(i == 0)
+                    result += "(";
+                else if(i == 1)
+                    result += " " + sign(b.type) + " ";
+                else
+                    result += ")";
+            });
+    });
+    return result;
+}
+
+bool evaluate(const FormulaPtr& f, Valuation& v) {
+    return fold<bool>(f, [&](const FormulaPtr& g, bool* args) {
+        return match(g,
+            [](const False&) { return false; },
+            [](const True&) { return true; },
+            [&](const Atom& a) -> bool { return v[a.name]; },
+            [&](const Not&) { return !args[0]; },
+            [&](const Binary& b) {
+                switch(b.type) {
+                    case Binary::And:  return args[0] && args[1];
+                    case Binary::Or:   return args[0] || args[1];
+                    case Binary::Impl: return !args[0] || args[1];
+                    case Binary::Eq:   return args[0] == args[1];
+                }
+                return false;
+            });
+    });
+}
+
+// Zbog jedinstvene tabele strukturno jednake formule su isti cvor
+bool equal(const FormulaPtr& f, const FormulaPtr& g) {
+    return f == g;
 }
 
 // Drugi cas
 
-FormulaPtr substitute(const FormulaPtr& f, const FormulaPtr& what, const FormulaPtr& with) {
-    if(equal(f, what))
-        return with;
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
+// Smena potformula: svako pojavljivanje kljuca iz s zamenjuje se odgovarajucom formulom, i to
+// sve smene odjednom (u umetnutim formulama se nista dalje ne menja). Kljuc je sam cvor, jer su
+// zbog jedinstvene tabele jednake formule isti cvor, pa je poredjenje jedna pretraga u hes mapi.
+// Potformula u kojoj nista nije zamenjeno se ne pravi ponovo, vec se vraca isti cvor,
+// a zajednicke potformule se obradjuju jednom.
+using Substitution = std::unordered_map<const Formula*, FormulaPtr>;
+
+FormulaPtr substitute(const FormulaPtr& f, const Substitution& s) {
+    if(s.empty())
         return f;
-    if(is<Not>(f))
-        return ptr(Not{substitute(as<Not>(f).subformula, what, with)});
-    if(is<Binary>(f)) {
-        auto binaryF = as<Binary>(f);
-        return ptr(Binary{
-            binaryF.type,
-            substitute(binaryF.left, what, with),
-            substitute(binaryF.right, what, with)
-        });
-    }
-    return FormulaPtr{};
+    auto key = [](const FormulaPtr* g) { return reinterpret_cast<std::uintptr_t>(g->get()); };
+    auto child = [&](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(s.contains(g->get()))
+            return {};
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    auto combine = [&](const FormulaPtr* frame, FormulaPtr* args) -> FormulaPtr {
+        const FormulaPtr& g = *frame;
+        if(auto it = s.find(g.get()); it != s.end())
+            return it->second;
+        return match(g,
+            [&](const Not& n) { return args[0] == n.subformula ? g : ptr(Not{args[0]}); },
+            [&](const Binary& b) {
+                return args[0] == b.left && args[1] == b.right ? g : ptr(Binary{b.type, args[0], args[1]});
+            },
+            [&](const auto&) { return g; });
+    };
+    return foldShared<FormulaPtr>(&f, key, child, combine);
+}
+
+FormulaPtr substitute(const FormulaPtr& f, const FormulaPtr& what, const FormulaPtr& with) {
+    return substitute(f, Substitution{{what.get(), with}});
 }
 
 void getAtoms(const FormulaPtr& f, AtomSet& atoms) {
-    if(is<Atom>(f))
-        atoms.insert(as<Atom>(f).name);
-    else if(is<Not>(f))
-        getAtoms(as<Not>(f).subformula, atoms);
-    else if(is<Binary>(f)) {
-        getAtoms(as<Binary>(f).left, atoms);
-        getAtoms(as<Binary>(f).right, atoms);
-    }
+    walk(f, [&](const FormulaPtr& g, int) {
+        if(is<Atom>(g))
+            atoms.insert(std::get<Atom>(*g).name);
+    });
 }
 
 bool next(Valuation& v) {
@@ -155,73 +681,1425 @@ void print(Valuation& v) {
         std::cout << value << ' ';
 }
 
-void table(const FormulaPtr& f) {
+// Bitovski paralelna evaluacija
+// Vrednost cvora je 64-bitna maska, po jedan bit za svaku od 64 uzastopne valuacije, pa se
+// veznik racuna jednom bitovskom operacijom za 64 valuacije odjednom. Valuacija broj k
+// dodeljuje i-tom atomu (u azbucnom redu) i-ti bit broja k, kao i next().
+using Word = std::uint64_t;
+
+// Broj reci koje se obradjuju zajedno: petlje po njima kompajler vektorizuje (SSE/AVX)
+constexpr int Lanes = 4;
+using Block = std::array<Word, Lanes>;
+
+// Formula prevedena u niz instrukcija, svaka potformula (cvor DAG-a) se racuna tacno jednom
+struct CompiledFormula {
+    enum Op { Zero, One, Var, Neg, And, Or, Impl, Eq };
+    struct Instruction {
+        Op op;
+        int left, right;    // indeksi instrukcija argumenata, odnosno indeks atoma za Var
+    };
+    std::vector<Instruction> code;      // potformule pre formule, koren je poslednji
+    std::vector<std::string> atoms;     // azbucnim redom
+};
+
+CompiledFormula compile(const FormulaPtr& f) {
+    CompiledFormula c;
     AtomSet atoms;
     getAtoms(f, atoms);
+    c.atoms.assign(begin(atoms), end(atoms));
+    foldShared<int>(f, [&](const FormulaPtr& g, int* args) {
+        using Instruction = CompiledFormula::Instruction;
+        c.code.push_back(match(g,
+            [](const False&) -> Instruction { return {CompiledFormula::Zero, 0, 0}; },
+            [](const True&) -> Instruction { return {CompiledFormula::One, 0, 0}; },
+            [&](const Atom& a) -> Instruction {
+                auto it = std::lower_bound(begin(c.atoms), end(c.atoms), a.name);
+                return {CompiledFormula::Var, int(it - begin(c.atoms)), 0};
+            },
+            [&](const Not&) -> Instruction { return {CompiledFormula::Neg, args[0], 0}; },
+            [&](const Binary& b) -> Instruction {
+                return {CompiledFormula::Op(CompiledFormula::And + int(b.type)), args[0], args[1]};
+            }));
+        return int(c.code.size()) - 1;
+    });
+    return c;
+}
+
+// Broj reci tabele istinitosti za dati broj atoma
+std::uint64_t wordCount(std::size_t atomCount) {
+    return atomCount <= 6 ? 1 : std::uint64_t(1) << (atomCount - 6);
+}
 
+// Bitovi reci koji odgovaraju postojecim valuacijama (manje od 64 samo ako ima manje od 6 atoma)
+Word validBits(std::size_t atomCount) {
+    return atomCount >= 6 ? ~Word(0) : (Word(1) << (1 << atomCount)) - 1;
+}
+
+// Vrednosti atoma u reci broj word: prvih 6 atoma se menja unutar reci, ostali su u njoj konstantni
+Word atomWord(int atom, std::uint64_t word) {
+    static constexpr Word patterns[6] = {
+        0xAAAAAAAAAAAAAAAA, 0xCCCCCCCCCCCCCCCC, 0xF0F0F0F0F0F0F0F0,
+        0xFF00FF00FF00FF00, 0xFFFF0000FFFF0000, 0xFFFFFFFF00000000
+    };
+    if(atom < 6)
+        return patterns[atom];
+    return (word >> (atom - 6)) & 1 ? ~Word(0) : 0;
+}
+
+// Vrednosti formule za reci first, ..., first + Lanes - 1 (values je radni prostor)
+Block evaluateBlock(const CompiledFormula& c, std::uint64_t first, std::vector<Block>& values) {
+    values.resize(c.code.size());
+    for(std::size_t k = 0; k < c.code.size(); k++) {
+        const CompiledFormula::Instruction& instruction = c.code[k];
+        Block& r = values[k];
+        switch(instruction.op) {
+            case CompiledFormula::Zero:
+                r.fill(0);
+                break;
+            case CompiledFormula::One:
+                r.fill(~Word(0));
+                break;
+            case CompiledFormula::Var:
+                for(int j = 0; j < Lanes; j++)
+                    r[j] = atomWord(instruction.left, first + j);
+                break;
+            case CompiledFormula::Neg: {
+                const Block& a = values[instruction.left];
+                for(int j = 0; j < Lanes; j++)
+                    r[j] = ~a[j];
+                break;
+            }
+            default: {
+                const Block& a = values[instruction.left];
+                const Block& b = values[instruction.right];
+                for(int j = 0; j < Lanes; j++)
+                    switch(instruction.op) {
+                        case CompiledFormula::And:  r[j] = a[j] & b[j]; break;
+                        case CompiledFormula::Or:   r[j] = a[j] | b[j]; break;
+                        case CompiledFormula::Impl: r[j] = ~a[j] | b[j]; break;
+                        default:                    r[j] = ~(a[j] ^ b[j]); break;
+                    }
+            }
+        }
+    }
+    return values.back();
+}
+
+// Visenitno nabrajanje: prostor valuacija se deli na delove od ChunkWords reci, tj. na
+// delove sa fiksiranim vrednostima atoma viseg reda, koje niti uzimaju redom
+constexpr std::uint64_t ChunkWords = 1024;
+
+std::uint64_t chunkCount(std::uint64_t words) {
+    return (words + ChunkWords - 1) / ChunkWords;
+}
+
+unsigned defaultThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Poziva body(i, thread) za i = 0, ..., count - 1, u najvise threadCount niti
+// (thread je redni broj niti, npr. za izbor njenog radnog prostora)
+template<typename Body>
+void parallelFor(std::uint64_t count, unsigned threadCount, Body body) {
+    std::atomic<std::uint64_t> next = 0;
+    auto worker = [&](unsigned thread) {
+        for(std::uint64_t i = next++; i < count; i = next++)
+            body(i, thread);
+    };
+    threadCount = unsigned(std::min<std::uint64_t>(std::max(1u, threadCount), count));
+    std::vector<std::thread> threads;
+    for(unsigned t = 1; t < threadCount; t++)
+        threads.emplace_back(worker, t);
+    worker(0);
+    for(std::thread& t : threads)
+        t.join();
+}
+
+// Tabela istinitosti kao niz bitova: bit k je vrednost formule za valuaciju broj k
+std::vector<Word> truthTable(const CompiledFormula& c, unsigned threadCount = defaultThreads()) {
+    std::uint64_t words = wordCount(c.atoms.size());
+    std::vector<Word> result(words);
+    std::vector<std::vector<Block>> values(std::max(1u, threadCount));
+    parallelFor(chunkCount(words), threadCount, [&](std::uint64_t chunk, unsigned thread) {
+        std::uint64_t last = std::min(words, (chunk + 1) * ChunkWords);
+        for(std::uint64_t w = chunk * ChunkWords; w < last; w += Lanes) {
+            Block block = evaluateBlock(c, w, values[thread]);
+            for(std::uint64_t j = 0; j < Lanes && w + j < last; j++)
+                result[w + j] = block[j];
+        }
+    });
+    result[0] &= validBits(c.atoms.size());
+    return result;
+}
+
+// Valuacija broj k
+Valuation valuation(const CompiledFormula& c, std::uint64_t k) {
     Valuation v;
-    for(const std::string& atom : atoms) {
-        v[atom] = false;
-        std::cout << atom << ' ';
+    for(std::size_t i = 0; i < c.atoms.size(); i++)
+        v[c.atoms[i]] = (k >> i) & 1;
+    return v;
+}
+
+// Redovi tabele iz jednog dela prostora valuacija, u tekstualnom obliku
+void formatRows(const CompiledFormula& c, std::uint64_t chunk, std::vector<Block>& values, std::string& out) {
+    std::size_t n = c.atoms.size();
+    std::uint64_t rows = std::uint64_t(1) << n;
+    std::uint64_t last = std::min(wordCount(n), (chunk + 1) * ChunkWords);
+    for(std::uint64_t w = chunk * ChunkWords; w < last; w += Lanes) {
+        Block block = evaluateBlock(c, w, values);
+        for(std::uint64_t j = 0; j < Lanes && w + j < last; j++)
+            for(std::uint64_t k = (w + j) * 64; k < std::min(rows, (w + j + 1) * 64); k++) {
+                for(std::size_t i = 0; i < n; i++) {
+                    out += (k >> i) & 1 ? '1' : '0';
+                    out += ' ';
+                }
+                out += "| ";
+                out += (block[j] >> (k % 64)) & 1 ? '1' : '0';
+                out += '\n';
+            }
     }
-    std::cout << std::endl;
+}
 
-    do {
-        print(v);
-        std::cout << "| " << evaluate(f, v) << std::endl;
-    } while(next(v));
+// Niti se prave jednom i uzimaju delove tabele redom preko brojaca; svaki deo se formatira u
+// jedan od Window bafera, a glavna nit ispisuje bafere redom, pa je izlaz isti kao kod
+// nabrajanja u jednoj niti. Nit ceka samo ako bi njen deo bio vise od Window delova ispred ispisa.
+void table(const FormulaPtr& f, unsigned threadCount = defaultThreads()) {
+    CompiledFormula c = compile(f);
+
+    std::string header;
+    for(const std::string& atom : c.atoms)
+        header += atom + ' ';
+    std::cout << header << std::endl;
+
+    threadCount = std::max(1u, threadCount);
+    std::uint64_t chunks = chunkCount(wordCount(c.atoms.size()));
+    std::uint64_t window = 2 * std::uint64_t(threadCount);
+    std::vector<std::string> buffers(window);
+    std::vector<char> ready(window, false);
+    std::uint64_t printed = 0;
+    std::mutex mutex;
+    std::condition_variable readyChanged, printedChanged;
+    std::atomic<std::uint64_t> next = 0;
+
+    auto worker = [&]() {
+        std::vector<Block> values;
+        for(std::uint64_t i = next++; i < chunks; i = next++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                printedChanged.wait(lock, [&] { return i < printed + window; });
+            }
+            formatRows(c, i, values, buffers[i % window]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready[i % window] = true;
+            }
+            readyChanged.notify_one();
+        }
+    };
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < std::min<std::uint64_t>(threadCount, chunks); t++)
+        threads.emplace_back(worker);
+
+    for(std::uint64_t i = 0; i < chunks; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            readyChanged.wait(lock, [&] { return ready[i % window]; });
+        }
+        std::cout << buffers[i % window];
+        buffers[i % window].clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready[i % window] = false;
+            printed++;
+        }
+        printedChanged.notify_all();
+    }
+    for(std::thread& t : threads)
+        t.join();
+    std::cout << std::flush;
+}
+
+// Kada neka nit nadje zadovoljavajucu valuaciju, delovi iza nje se vise ne obradjuju. Delovi
+// ispred se zavrsavaju, pa je rezultat uvek prva zadovoljavajuca valuacija, kao u jednoj niti.
+std::optional<Valuation> isSatisfiable(const FormulaPtr& f, unsigned threadCount = defaultThreads()) {
+    CompiledFormula c = compile(f);
+    std::uint64_t words = wordCount(c.atoms.size());
+    std::atomic<std::uint64_t> found = UINT64_MAX;
+    std::vector<std::vector<Block>> values(std::max(1u, threadCount));
+    parallelFor(chunkCount(words), threadCount, [&](std::uint64_t chunk, unsigned thread) {
+        std::uint64_t last = std::min(words, (chunk + 1) * ChunkWords);
+        for(std::uint64_t w = chunk * ChunkWords; w < last && w * 64 < found; w += Lanes) {
+            Block block = evaluateBlock(c, w, values[thread]);
+            block[0] &= w == 0 ? validBits(c.atoms.size()) : ~Word(0);
+            for(std::uint64_t j = 0; j < Lanes && w + j < last; j++)
+                if(block[j]) {
+                    std::uint64_t k = (w + j) * 64 + std::countr_zero(block[j]);
+                    std::uint64_t current = found;
+                    while(k < current && !found.compare_exchange_weak(current, k)) {}
+                    return;
+                }
+        }
+    });
+    if(found == UINT64_MAX)
+        return {};
+    return valuation(c, found);
+}
+
+// Inkrementalna evaluacija: prevedena formula (DAG) u kojoj svaki cvor pamti svoju vrednost
+// i zna svoje roditelje. Kada atom promeni vrednost, ponovo se racunaju samo njegovi preci,
+// redom od potformula ka formuli, i to samo oni ciji se neki potomak zaista promenio.
+struct IncrementalFormula {
+    CompiledFormula c;
+    std::vector<std::uint8_t> values;       // trenutna vrednost svakog cvora
+    std::vector<int> parentStart, parents;  // roditelji cvora k: parents[parentStart[k]], ..., parents[parentStart[k + 1] - 1]
+    std::vector<int> atomNodes;             // cvor i-tog atoma
+    std::vector<std::uint8_t> queued;
+    std::vector<int> heap;                  // cvorovi koje treba ponovo izracunati, najmanji indeks prvi
+
+    bool value() const { return values.back(); }
+};
+
+std::uint8_t evaluateNode(const CompiledFormula::Instruction& instruction, const std::vector<std::uint8_t>& values) {
+    switch(instruction.op) {
+        case CompiledFormula::Zero: return 0;
+        case CompiledFormula::One:  return 1;
+        case CompiledFormula::Var:  return 0;
+        case CompiledFormula::Neg:  return !values[instruction.left];
+        case CompiledFormula::And:  return values[instruction.left] & values[instruction.right];
+        case CompiledFormula::Or:   return values[instruction.left] | values[instruction.right];
+        case CompiledFormula::Impl: return (!values[instruction.left]) | values[instruction.right];
+        case CompiledFormula::Eq:   return values[instruction.left] == values[instruction.right];
+    }
+    return 0;
 }
 
-std::optional<Valuation> isSatisfiable(const FormulaPtr& f) {
+// Svi atomi su na pocetku netacni
+IncrementalFormula incremental(const FormulaPtr& f) {
+    IncrementalFormula g;
+    g.c = compile(f);
+    std::size_t size = g.c.code.size();
+    g.values.resize(size);
+    g.queued.resize(size);
+    g.atomNodes.resize(g.c.atoms.size());
+
+    std::vector<std::pair<int, int>> edges;     // (potomak, roditelj)
+    for(std::size_t k = 0; k < size; k++) {
+        const CompiledFormula::Instruction& instruction = g.c.code[k];
+        if(instruction.op == CompiledFormula::Var)
+            g.atomNodes[instruction.left] = int(k);
+        if(instruction.op >= CompiledFormula::Neg)
+            edges.emplace_back(instruction.left, k);
+        if(instruction.op >= CompiledFormula::And && instruction.right != instruction.left)
+            edges.emplace_back(instruction.right, k);
+        g.values[k] = evaluateNode(instruction, g.values);
+    }
+    std::sort(begin(edges), end(edges));
+    g.parentStart.assign(size + 1, 0);
+    for(const auto& [child, parent] : edges) {
+        g.parentStart[child + 1]++;
+        g.parents.push_back(parent);
+    }
+    for(std::size_t k = 0; k < size; k++)
+        g.parentStart[k + 1] += g.parentStart[k];
+    return g;
+}
+
+// Menja vrednost i-tog atoma i azurira vrednosti njegovih predaka
+void flip(IncrementalFormula& g, int atom) {
+    auto schedule = [&](int node) {
+        for(int k = g.parentStart[node]; k < g.parentStart[node + 1]; k++) {
+            int parent = g.parents[k];
+            if(!g.queued[parent]) {
+                g.queued[parent] = 1;
+                g.heap.push_back(parent);
+                std::push_heap(begin(g.heap), end(g.heap), std::greater<>());
+            }
+        }
+    };
+    int node = g.atomNodes[atom];
+    g.values[node] ^= 1;
+    schedule(node);
+    while(!g.heap.empty()) {
+        std::pop_heap(begin(g.heap), end(g.heap), std::greater<>());
+        node = g.heap.back();
+        g.heap.pop_back();
+        g.queued[node] = 0;
+        std::uint8_t value = evaluateNode(g.c.code[node], g.values);
+        if(value != g.values[node]) {
+            g.values[node] = value;
+            schedule(node);
+        }
+    }
+}
+
+// Nabrajanje valuacija Grejovim kodom: u koraku k menja se samo atom sa indeksom
+// najnizeg postavljenog bita broja k, pa svaki korak kosta samo koliko i azuriranje predaka
+std::optional<Valuation> isSatisfiableGray(const FormulaPtr& f) {
+    IncrementalFormula g = incremental(f);
+    std::uint64_t count = std::uint64_t(1) << g.c.atoms.size();
+    std::uint64_t current = 0;
+    for(std::uint64_t k = 1; !g.value(); k++) {
+        if(k == count)
+            return {};
+        int atom = std::countr_zero(k);
+        current ^= std::uint64_t(1) << atom;
+        flip(g, atom);
+    }
+    return valuation(g.c, current);
+}
+
+// Postfiksni bajtkod: formula se prevodi u niz instrukcija koje se izvrsavaju nad stekom
+// vrednosti, a atomi su celobrojni indeksi u niz vrednosti umesto imena u mapi. Konjunkcija,
+// disjunkcija i implikacija skacu preko desnog operanda kada je rezultat poznat iz levog.
+// Zajednicke potformule se prevode svaki put kada se pojave (bajtkod prati stablo, ne DAG).
+struct Bytecode {
+    enum Op : std::uint8_t {
+        PushFalse, PushTrue, PushAtom, Negate, Equivalent,
+        AndJump,    // ako je na vrhu 0, skok (rezultat je 0), inace skidanje sa steka
+        OrJump,     // ako je na vrhu 1, skok (rezultat je 1), inace skidanje sa steka
+        ImplJump    // ako je na vrhu 0, skok sa rezultatom 1, inace skidanje sa steka
+    };
+    struct Instruction {
+        Op op;
+        std::uint32_t arg;  // indeks atoma za PushAtom, odrediste za skokove
+    };
+    std::vector<Instruction> code;
+    std::vector<std::string> atoms;     // azbucnim redom, i-ti atom ima indeks i
+    std::size_t maxDepth = 0;
+};
+
+Bytecode compileBytecode(const FormulaPtr& f) {
+    Bytecode b;
     AtomSet atoms;
     getAtoms(f, atoms);
+    b.atoms.assign(begin(atoms), end(atoms));
+
+    std::vector<std::size_t> jumps;     // skokovi cije odrediste jos nije poznato
+    std::size_t depth = 0;
+    auto emit = [&](Bytecode::Op op, std::uint32_t arg, int change) {
+        b.code.push_back({op, arg});
+        depth += change;
+        b.maxDepth = std::max(b.maxDepth, depth);
+    };
+    walk(f, [&](const FormulaPtr& g, int i) {
+        match(g,
+            [&](const False&) { emit(Bytecode::PushFalse, 0, 1); },
+            [&](const True&) { emit(Bytecode::PushTrue, 0, 1); },
+            [&](const Atom& a) {
+                auto it = std::lower_bound(begin(b.atoms), end(b.atoms), a.name);
+                emit(Bytecode::PushAtom, std::uint32_t(it - begin(b.atoms)), 1);
+            },
+            [&](const Not&) {
+                if(i == 1)
+                    emit(Bytecode::Negate, 0, 0);
+            },
+            [&](const Binary& binary) {
+                Binary::Type type = binary.type;
+                if(type == Binary::Eq) {
+                    if(i == 2)
+                        emit(Bytecode::Equivalent, 0, -1);
+                }
+                else if(i == 1) {
+                    jumps.push_back(b.code.size());
+                    Bytecode::Op op = type == Binary::And ? Bytecode::AndJump : type == Binary::Or ? Bytecode::OrJump : Bytecode::ImplJump;
+                    emit(op, 0, -1);
+                }
+                else if(i == 2) {
+                    b.code[jumps.back()].arg = std::uint32_t(b.code.size());
+                    jumps.pop_back();
+                }
+            });
+    });
+    return b;
+}
+
+// Vrednost formule za vrednosti atoma values (po indeksima iz b.atoms)
+// stack je radni prostor: posle prvog poziva se vise ne alocira memorija
+bool evaluate(const Bytecode& b, const std::vector<std::uint8_t>& values, std::vector<std::uint8_t>& stack) {
+    stack.resize(b.maxDepth);
+    std::uint8_t* top = stack.data() - 1;
+    const Bytecode::Instruction* code = b.code.data();
+    std::size_t size = b.code.size();
+    for(std::size_t pc = 0; pc < size; pc++) {
+        const Bytecode::Instruction& instruction = code[pc];
+        switch(instruction.op) {
+            case Bytecode::PushFalse:  *++top = 0; break;
+            case Bytecode::PushTrue:   *++top = 1; break;
+            case Bytecode::PushAtom:   *++top = values[instruction.arg]; break;
+            case Bytecode::Negate:     *top ^= 1; break;
+            case Bytecode::Equivalent:
+                top--;
+                *top = *top == top[1];
+                break;
+            case Bytecode::AndJump:
+                if(!*top)
+                    pc = instruction.arg - 1;
+                else
+                    top--;
+                break;
+            case Bytecode::OrJump:
+                if(*top)
+                    pc = instruction.arg - 1;
+                else
+                    top--;
+                break;
+            case Bytecode::ImplJump:
+                if(!*top) {
+                    *top = 1;
+                    pc = instruction.arg - 1;
+                }
+                else
+                    top--;
+                break;
+        }
+    }
+    return *top;
+}
+
+// Vrednosti atoma iz valuacije, po indeksima iz b.atoms (atomi kojih nema su netacni)
+std::vector<std::uint8_t> atomValues(const Bytecode& b, const Valuation& v) {
+    std::vector<std::uint8_t> values(b.atoms.size());
+    for(std::size_t i = 0; i < b.atoms.size(); i++) {
+        auto it = v.find(b.atoms[i]);
+        values[i] = it != v.end() && it->second;
+    }
+    return values;
+}
+
+// BDD formule f: i-ti atom iz atoms je promenljiva i, pa je redosled atoma pocetni redosled
+// promenljivih. Semanticki jednake formule imaju isti BDD.
+Bdd toBdd(BddManager& manager, const FormulaPtr& f, const std::vector<std::string>& atoms) {
+    return foldShared<Bdd>(f, [&](const FormulaPtr& g, Bdd* args) -> Bdd {
+        return match(g,
+            [&](const False&) { return manager.constant(false); },
+            [&](const True&) { return manager.constant(true); },
+            [&](const Atom& a) {
+                auto it = std::lower_bound(begin(atoms), end(atoms), a.name);
+                return manager.var(std::uint32_t(it - begin(atoms)));
+            },
+            [&](const Not&) { return !args[0]; },
+            [&](const Binary& b) {
+                switch(b.type) {
+                    case Binary::And:  return args[0] & args[1];
+                    case Binary::Or:   return args[0] | args[1];
+                    case Binary::Impl: return (!args[0]) | args[1];
+                    case Binary::Eq:   return !(args[0] ^ args[1]);
+                }
+                return Bdd{};
+            });
+    });
+}
+
+// Parsiranje formula u sintaksi koju ispisuje print(): ~, &, |, ->, <->, T, F, zagrade i atomi
+// (imena od slova, cifara i _). Prioriteti su, od najjaceg: ~, &, |, ->, <->; implikacija je
+// desno asocijativna, ostali veznici levo. Parser ne koristi rekurziju (operatori i operandi
+// se cuvaju na svojim stekovima), pa radi i za formule ugnjezdene milion puta.
+struct ParseError {
+    std::size_t offset = 0;
+    std::string message;
+};
+
+struct FormulaParser {
+    enum Operator { Paren, Neg, And, Or, Impl, Eq };
+
+    // Formule se parsiraju u paketima, bez brave: cvor paketa je samo veznik i indeksi potformula
+    // u paketu, a isti cvorovi se spajaju u maloj tabeli paketa (u kesu). Pun paket se pod bravom
+    // povezuje sa jedinstvenom tabelom (merge), nivo po nivo. Cvor cija je potformula nova i sam
+    // je nov, pa se u jedinstvenoj tabeli traze samo cvorovi cije potformule vec postoje, i to svi
+    // cvorovi jednog nivoa zajedno, uz unapred zatrazena mesta (prefetch). Isto vazi za upis novih.
+    static constexpr std::uint32_t None = std::uint32_t(-1);
+    // Cvorovi i tabela paketa od BatchNodes cvorova staju u L2 kes (vece pakete sporije parsira)
+    static constexpr std::size_t BatchNodes = 1 << 13;
+    // Vrsta cvora paketa: Binary::Type za veznike, Negation, i Leaf za atome i konstante
+    static constexpr std::uint8_t Negation = 4, Leaf = 5;
+
+    struct Node {
+        std::uint8_t kind;
+        // Potformule (indeksi u paketu, right je None za negaciju), a za list indeks u atoms
+        std::uint32_t left, right;
+        // 0 za listove, inace 1 + najveci nivo potformule
+        std::uint32_t level;
+        // Broj roditelja i formula paketa koji koriste cvor: poslednji premesta formulu cvora
+        std::uint32_t uses;
+        // Mesto u tabeli paketa
+        std::uint32_t slot;
+    };
+
+    struct AtomEntry {
+        std::string name;
+        std::size_t hash;
+        FormulaPtr node;
+        // List za atom u paketu broj batch
+        std::size_t batch = 0;
+        std::uint32_t id = None;
+    };
+
+    UniqueTable& table = uniqueTable();
+    // Atomi (i konstante T, F) po imenu, u tabeli sa otvorenim adresiranjem
+    std::vector<AtomEntry> atoms;
+    std::vector<std::uint32_t> atomSlots = std::vector<std::uint32_t>(1024, None);
+
+    // Paket: cvorovi, njihove formule (listovi odmah, ostali u merge) i koreni formula
+    std::size_t batch = 1;
+    std::vector<Node> nodes;
+    std::vector<FormulaPtr> resolved;
+    std::vector<std::uint32_t> roots;
+    std::vector<std::uint32_t> slots = std::vector<std::uint32_t>(4 * BatchNodes, None);
+    // Radni prostor, cuva se izmedju poziva
+    std::vector<std::uint32_t> operands;
+    std::vector<std::pair<Operator, std::size_t>> operators;
+    std::vector<std::uint32_t> order, levelEnd;
+    std::vector<std::uint8_t> created;
+    std::vector<std::size_t> hashes;
+    std::vector<std::weak_ptr<Formula>> createdNodes;
+
+    FormulaParser() {
+        addAtom("T", mixHash(nameStep(0, 'T')), ptr(True{}));
+        addAtom("F", mixHash(nameStep(0, 'F')), ptr(False{}));
+    }
+
+    // Hes imena se racuna dok se ime cita: h = h * 31 + c za svaki znak, pa mixHash
+    static std::size_t nameStep(std::size_t h, char c) { return h * 31 + static_cast<unsigned char>(c); }
+
+    void placeAtom(std::uint32_t index) {
+        std::size_t mask = atomSlots.size() - 1;
+        std::size_t i = atoms[index].hash & mask;
+        while(atomSlots[i] != None)
+            i = (i + 1) & mask;
+        atomSlots[i] = index;
+    }
+
+    std::uint32_t addAtom(std::string_view name, std::size_t hash, FormulaPtr node) {
+        if(2 * (atoms.size() + 1) > atomSlots.size()) {
+            atomSlots.assign(2 * atomSlots.size(), None);
+            for(std::uint32_t index = 0; index < atoms.size(); index++)
+                placeAtom(index);
+        }
+        atoms.push_back({std::string(name), hash, std::move(node)});
+        placeAtom(std::uint32_t(atoms.size() - 1));
+        return std::uint32_t(atoms.size() - 1);
+    }
+
+    // List paketa za atom (jedan po paketu)
+    std::uint32_t leaf(std::uint32_t index) {
+        AtomEntry& a = atoms[index];
+        if(a.batch != batch) {
+            a.batch = batch;
+            a.id = std::uint32_t(nodes.size());
+            nodes.push_back({Leaf, index, None, 0, 0, None});
+            resolved.push_back(a.node);
+        }
+        return a.id;
+    }
+
+    std::uint32_t atom(std::string_view name, std::size_t hash) {
+        std::size_t mask = atomSlots.size() - 1;
+        for(std::size_t i = hash & mask; atomSlots[i] != None; i = (i + 1) & mask)
+            if(const AtomEntry& a = atoms[atomSlots[i]]; a.hash == hash && a.name == name)
+                return leaf(atomSlots[i]);
+        return leaf(addAtom(name, hash, ptr(Atom{std::string(name)})));
+    }
+
+    static std::size_t slotHash(std::uint8_t kind, std::uint32_t left, std::uint32_t right) {
+        return mixHash(mixHash(left + (std::size_t(kind) << 32)) ^ right);
+    }
+
+    void growSlots() {
+        slots.assign(2 * slots.size(), None);
+        std::size_t mask = slots.size() - 1;
+        for(std::uint32_t id = 0; id < nodes.size(); id++) {
+            Node& n = nodes[id];
+            if(n.kind == Leaf)
+                continue;
+            std::size_t i = slotHash(n.kind, n.left, n.right) & mask;
+            while(slots[i] != None)
+                i = (i + 1) & mask;
+            slots[i] = id;
+            n.slot = std::uint32_t(i);
+        }
+    }
+
+    // Cvor paketa sa datim veznikom i potformulama (isti cvor se pravi samo jednom u paketu)
+    std::uint32_t node(std::uint8_t kind, std::uint32_t left, std::uint32_t right) {
+        std::size_t mask = slots.size() - 1;
+        std::size_t i = slotHash(kind, left, right) & mask;
+        for(; slots[i] != None; i = (i + 1) & mask) {
+            const Node& other = nodes[slots[i]];
+            if(other.kind == kind && other.left == left && other.right == right)
+                return slots[i];
+        }
+        std::uint32_t level = nodes[left].level;
+        nodes[left].uses++;
+        if(right != None) {
+            level = std::max(level, nodes[right].level);
+            nodes[right].uses++;
+        }
+        std::uint32_t id = std::uint32_t(nodes.size());
+        slots[i] = id;
+        nodes.push_back({kind, left, right, level + 1, 0, std::uint32_t(i)});
+        resolved.emplace_back();
+        if(2 * nodes.size() > slots.size())
+            growSlots();
+        return id;
+    }
+
+    // Uklanja cvorove od indeksa mark (formulu sa greskom), redom obrnutim od dodavanja, pa tabela
+    // paketa ostaje ista kao pre njih
+    void truncate(std::size_t mark) {
+        for(std::size_t id = nodes.size(); id-- > mark;) {
+            const Node& n = nodes[id];
+            if(n.kind == Leaf) {
+                atoms[n.left].batch = 0;
+                continue;
+            }
+            slots[n.slot] = None;
+            nodes[n.left].uses--;
+            if(n.right != None)
+                nodes[n.right].uses--;
+        }
+        nodes.resize(mark);
+        resolved.resize(mark);
+    }
+
+    // Formula cvora id za jos jednog korisnika: poslednji korisnik je premesta
+    FormulaPtr take(std::uint32_t id) {
+        if(--nodes[id].uses == 0)
+            return std::move(resolved[id]);
+        return resolved[id];
+    }
+
+    void release(std::uint32_t id) {
+        if(--nodes[id].uses == 0)
+            resolved[id].reset();
+    }
+
+    // Povezuje paket sa jedinstvenom tabelom, dodaje formule paketa u formulas i prazni paket
+    void merge(std::vector<FormulaPtr>& formulas) {
+        constexpr std::size_t Ahead = 16;
+        // Cvorovi poredjani po nivou (prebrojavanjem); nivo k su order[levelEnd[k - 1], levelEnd[k])
+        std::uint32_t levels = 0;
+        for(const Node& n : nodes)
+            levels = std::max(levels, n.level);
+        levelEnd.assign(levels + 2, 0);
+        for(const Node& n : nodes)
+            levelEnd[n.level + 1]++;
+        for(std::uint32_t level = 1; level <= levels + 1; level++)
+            levelEnd[level] += levelEnd[level - 1];
+        order.resize(nodes.size());
+        for(std::uint32_t id = 0; id < nodes.size(); id++)
+            order[levelEnd[nodes[id].level]++] = id;
+        hashes.resize(nodes.size());
+        created.assign(nodes.size(), 0);
+        createdNodes.clear();
+
+        std::lock_guard<std::mutex> lock(table.mutex);
+        for(std::uint32_t level = 1; level <= levels; level++) {
+            std::size_t begin = levelEnd[level - 1], end = levelEnd[level];
+            // Hes cvora ciji veznik sa istim potformulama mozda vec postoji, a 0 za nove cvorove
+            for(std::size_t k = begin; k < end; k++) {
+                const Node& n = nodes[order[k]];
+                bool young = created[n.left] || (n.right != None && created[n.right]);
+                hashes[order[k]] = young ? 0 : hashOf(n);
+            }
+            for(std::size_t k = begin; k < std::min(begin + Ahead, end); k++)
+                if(hashes[order[k]])
+                    table.prefetch(hashes[order[k]]);
+            for(std::size_t k = begin; k < end; k++) {
+                if(k + Ahead < end && hashes[order[k + Ahead]])
+                    table.prefetch(hashes[order[k + Ahead]]);
+                std::uint32_t id = order[k];
+                const Node& n = nodes[id];
+                const Formula* left = resolved[n.left].get();
+                const Formula* right = n.right != None ? resolved[n.right].get() : nullptr;
+                if(hashes[id]) {
+                    FormulaPtr old = table.find(hashes[id], [&](const Formula& g) {
+                        if(n.kind == Negation) {
+                            const Not* m = std::get_if<Not>(&g);
+                            return m && m->subformula.get() == left;
+                        }
+                        const Binary* b = std::get_if<Binary>(&g);
+                        return b && b->type == Binary::Type(n.kind) && b->left.get() == left && b->right.get() == right;
+                    });
+                    if(old) {
+                        resolved[id] = std::move(old);
+                        release(n.left);
+                        if(n.right != None)
+                            release(n.right);
+                        continue;
+                    }
+                }
+                else
+                    hashes[id] = hashOf(n);
+                FormulaPtr l = take(n.left);
+                Formula f = n.kind == Negation
+                    ? Formula(std::in_place_type<Not>, std::move(l))
+                    : Formula(std::in_place_type<Binary>, Binary::Type(n.kind), std::move(l), take(n.right));
+                resolved[id] = table.allocate(f);
+                created[id] = 1;
+                order[createdNodes.size()] = id;
+                createdNodes.push_back(resolved[id]);
+            }
+        }
+        // Upis novih cvorova; njihovi indeksi su na pocetku order (obradjeni deo)
+        table.reserve(createdNodes.size());
+        for(std::size_t k = 0; k < std::min(Ahead, createdNodes.size()); k++)
+            table.prefetch(hashes[order[k]]);
+        for(std::size_t k = 0; k < createdNodes.size(); k++) {
+            if(k + Ahead < createdNodes.size())
+                table.prefetch(hashes[order[k + Ahead]]);
+            table.place(hashes[order[k]], std::move(createdNodes[k]));
+        }
+
+        for(std::uint32_t root : roots)
+            formulas.push_back(take(root));
+        for(const Node& n : nodes)
+            if(n.kind != Leaf)
+                slots[n.slot] = None;
+        nodes.clear();
+        resolved.clear();
+        roots.clear();
+        batch++;
+    }
+
+    // Hes u jedinstvenoj tabeli za cvor paketa cije su potformule vec napravljene
+    std::size_t hashOf(const Node& n) const {
+        if(n.kind == Negation)
+            return notHash(resolved[n.left].get());
+        return binaryHash(Binary::Type(n.kind), resolved[n.left].get(), resolved[n.right].get());
+    }
+
+    static int precedence(Operator op) {
+        static constexpr int precedences[] = {0, 5, 4, 3, 2, 1};
+        return precedences[op];
+    }
+
+    void reduce() {
+        Operator op = operators.back().first;
+        operators.pop_back();
+        if(op == Neg) {
+            operands.back() = node(Negation, operands.back(), None);
+            return;
+        }
+        std::uint32_t right = operands.back();
+        operands.pop_back();
+        static constexpr Binary::Type types[] = {Binary::And, Binary::And, Binary::And, Binary::Or, Binary::Impl, Binary::Eq};
+        operands.back() = node(types[op], operands.back(), right);
+    }
+
+    bool fail(ParseError& error, std::size_t mark, std::size_t offset, const char* message) {
+        truncate(mark);
+        error = {offset, message};
+        return false;
+    }
+
+    static bool isNameChar(char c) {
+        static constexpr auto nameChars = [] {
+            std::array<bool, 256> chars{};
+            for(int c = 0; c < 256; c++)
+                chars[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+            return chars;
+        }();
+        return nameChars[static_cast<unsigned char>(c)];
+    }
+
+    // Parsira jednu formulu od pozicije pos do kraja reda (ili teksta) i pomera pos iza nje
+    // U slucaju greske vraca nullptr, a error sadrzi poziciju (u bajtovima od pocetka teksta)
+    FormulaPtr parse(std::string_view text, std::size_t& pos, ParseError& error) {
+        std::vector<FormulaPtr> formulas;
+        bool parsed = parseFormula(text, pos, error);
+        merge(formulas);
+        return parsed ? std::move(formulas.back()) : nullptr;
+    }
+
+    // Kao parse, ali formulu samo dodaje u paket (bez brave); paket ostaje isti ako je greska
+    bool parseFormula(std::string_view text, std::size_t& pos, ParseError& error) {
+        std::size_t mark = nodes.size();
+        operands.clear();
+        operators.clear();
+
+        bool operand = true;
+        std::size_t n = text.size();
+        while(true) {
+            while(pos < n && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r'))
+                pos++;
+            if(pos == n || text[pos] == '\n')
+                break;
+            std::size_t start = pos;
+            char c = text[pos];
+
+            if(operand) {
+                if(c == '~') {
+                    operators.push_back({Neg, start});
+                    pos++;
+                }
+                else if(c == '(') {
+                    operators.push_back({Paren, start});
+                    pos++;
+                }
+                else if(isNameChar(c)) {
+                    std::size_t hash = 0;
+                    while(pos < n && isNameChar(text[pos]))
+                        hash = nameStep(hash, text[pos++]);
+                    operands.push_back(atom(text.substr(start, pos - start), mixHash(hash)));
+                    operand = false;
+                }
+                else
+                    return fail(error, mark, start, "expected formula");
+                continue;
+            }
+
+            if(c == ')') {
+                while(!operators.empty() && operators.back().first != Paren)
+                    reduce();
+                if(operators.empty())
+                    return fail(error, mark, start, "unmatched )");
+                operators.pop_back();
+                pos++;
+                continue;
+            }
+
+            Operator op = Paren;
+            std::size_t length = 1;
+            if(c == '&')
+                op = And;
+            else if(c == '|')
+                op = Or;
+            else if(text.substr(pos, 2) == "->")
+                op = Impl, length = 2;
+            else if(text.substr(pos, 3) == "<->")
+                op = Eq, length = 3;
+            else
+                return fail(error, mark, start, "expected operator");
+            pos += length;
+            while(!operators.empty() && (precedence(operators.back().first) > precedence(op) ||
+                                         (precedence(operators.back().first) == precedence(op) && op != Impl)))
+                reduce();
+            operators.push_back({op, start});
+            operand = true;
+        }
+
+        if(operand)
+            return fail(error, mark, pos, "expected formula");
+        while(!operators.empty()) {
+            if(operators.back().first == Paren)
+                return fail(error, mark, operators.back().second, "missing )");
+            reduce();
+        }
+        if(pos < n)
+            pos++;
+        nodes[operands.back()].uses++;
+        roots.push_back(operands.back());
+        return true;
+    }
+
+    // Cela niska je jedna formula (iza nje mogu biti samo beline)
+    FormulaPtr parse(std::string_view text, ParseError& error) {
+        std::size_t pos = 0;
+        FormulaPtr f = parse(text, pos, error);
+        while(f && pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n'))
+            pos++;
+        if(f && pos < text.size()) {
+            error = {pos, "expected end of input"};
+            return nullptr;
+        }
+        return f;
+    }
+
+    // Po jedna formula u svakom redu, prazni redovi se preskacu. U slucaju greske formulas sadrzi
+    // formule pre reda sa greskom.
+    bool parseLines(std::string_view text, std::vector<FormulaPtr>& formulas, ParseError& error) {
+        std::size_t pos = 0;
+        bool parsed = true;
+        while(pos < text.size()) {
+            std::size_t line = pos;
+            while(line < text.size() && (text[line] == ' ' || text[line] == '\t' || text[line] == '\r'))
+                line++;
+            if(line < text.size() && text[line] == '\n') {
+                pos = line + 1;
+                continue;
+            }
+            if(line == text.size())
+                break;
+            if(!parseFormula(text, pos, error)) {
+                parsed = false;
+                break;
+            }
+            if(nodes.size() >= BatchNodes)
+                merge(formulas);
+        }
+        merge(formulas);
+        return parsed;
+    }
+};
+
+// Fajl mapiran u memoriju: sadrzaj se ne kopira u bafer, vec ga operativni sistem ucitava
+// po potrebi, pa se i veliki fajlovi parsiraju bez dodatne memorije
+struct MappedFile {
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return;
+        struct stat info;
+        if(fstat(fd, &info) == 0) {
+            size = std::size_t(info.st_size);
+            void* p = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+            if(size == 0)
+                data = "";
+            else if(p != MAP_FAILED) {
+                madvise(p, size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(p);
+            }
+            else
+                size = 0;
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if(size > 0)
+            munmap(const_cast<char*>(data), size);
+    }
 
+    bool isOpen() const { return data != nullptr; }
+    std::string_view text() const { return {data, size}; }
+};
+
+// Ucitava sve formule iz fajla (po jednu u redu)
+bool parseFile(const std::string& path, FormulaParser& parser, std::vector<FormulaPtr>& formulas, ParseError& error) {
+    MappedFile file(path);
+    if(!file.isOpen()) {
+        error = {0, "cannot open " + path};
+        return false;
+    }
+    return parser.parseLines(file.text(), formulas, error);
+}
+
+// Nasumicna formula u sintaksi print() sa depth nivoa veznika, za merenje parsiranja
+void randomFormulaText(int depth, std::mt19937& rng, std::string& out) {
+    int kind = depth == 0 ? 0 : int(rng() % 6);
+    if(kind == 0)
+        out += "p" + std::to_string(rng() % 1000);
+    else if(kind == 1) {
+        out += '~';
+        randomFormulaText(depth - 1, rng, out);
+    }
+    else {
+        out += '(';
+        randomFormulaText(depth - 1, rng, out);
+        out += " " + sign(Binary::Type(kind - 2)) + " ";
+        randomFormulaText(depth - 1, rng, out);
+        out += ')';
+    }
+}
+
+// Brzina parsiranja fajla sa nasumicnim formulama (po jedna u redu). Fajl se pravi na putanji
+// path, a ako je ona prazna, kao jedinstven privremeni fajl (u TMPDIR ili /tmp)
+void benchmarkParsing(std::size_t megabytes, std::string path) {
+    std::mt19937 rng(42);
+    std::string text;
+    while(text.size() < (megabytes << 20)) {
+        randomFormulaText(5, rng, text);
+        text += '\n';
+    }
+    if(path.empty()) {
+        const char* dir = std::getenv("TMPDIR");
+        path = std::string(dir && *dir ? dir : "/tmp") + "/formulas-XXXXXX";
+        int fd = mkstemp(path.data());
+        if(fd == -1) {
+            std::cout << "Cannot create a temporary file in " << path << std::endl;
+            return;
+        }
+        close(fd);
+    }
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+        if(!out) {
+            std::cout << "Cannot write " << path << std::endl;
+            std::remove(path.c_str());
+            return;
+        }
+    }
+
+    FormulaParser parser;
+    std::vector<FormulaPtr> formulas;
+    ParseError error;
+    std::clock_t cpuStart = std::clock();
+    auto start = std::chrono::steady_clock::now();
+    bool parsed = parseFile(path, parser, formulas, error);
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpuTime = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    std::remove(path.c_str());
+    if(!parsed) {
+        std::cout << "Parse error at byte " << error.offset << ": " << error.message << std::endl;
+        return;
+    }
+    std::cout << "Parsed " << formulas.size() << " formulas (" << text.size() / 1e6 << " MB) in "
+              << time << "s, " << text.size() / 1e6 / time << " MB/s (CPU time " << cpuTime << "s, "
+              << text.size() / 1e6 / cpuTime << " MB/s)" << std::endl;
+}
+
+// Nezadovoljiv lanac ekvivalencija p0 <-> p1 <-> ... <-> p(n-1) uz ~p0 i p(n-1):
+// provera zadovoljivosti mora da prodje kroz svih 2^n valuacija
+FormulaPtr equivalenceChain(int n) {
+    FormulaPtr chain = ptr(Binary{Binary::And, ptr(Not{ptr(Atom{"p0"})}), ptr(Atom{"p" + std::to_string(n - 1)})});
+    for(int i = 0; i < n - 1; i++)
+        chain = ptr(Binary{Binary::And, ptr(Binary{Binary::Eq, ptr(Atom{"p" + std::to_string(i)}),
+                                                    ptr(Atom{"p" + std::to_string(i + 1)})}), chain});
+    return chain;
+}
+
+// Ubrzanje i efikasnost (ubrzanje / broj niti, i ubrzanje / broj zauzetih jezgara) za razlicit
+// broj niti i lance od first do last atoma (korak 2); niti ima bar do 4, i kada jezgara ima
+// manje, da se vidi i cena deljenja posla i preopterecenja
+void benchmarkThreads(int first, int last) {
+    unsigned maxThreads = std::max(4u, 2 * defaultThreads());
+    std::cout << "hardware threads: " << defaultThreads() << std::endl;
+    for(int atomCount = first; atomCount <= last; atomCount += 2) {
+        FormulaPtr chain = equivalenceChain(atomCount);
+        double single = 0;
+        for(unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+            auto start = std::chrono::steady_clock::now();
+            bool sat = isSatisfiable(chain, threads).has_value();
+            double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if(threads == 1)
+                single = time;
+            std::cout << atomCount << " atoms, " << threads << " threads: " << time << "s, speedup " << single / time
+                      << ", efficiency " << single / time / threads
+                      << ", per core " << single / time / std::min(threads, defaultThreads())
+                      << (sat ? " (SAT)" : "") << std::endl;
+        }
+    }
+}
+
+// Evaluacija iste formule za sve valuacije: obilazak stabla sa mapom, bajtkod i Grejov kod
+void benchmarkEvaluation(int atomCount) {
+    FormulaPtr f = ptr(Binary{Binary::Or, equivalenceChain(atomCount), ptr(Atom{"p1"})});
+
+    AtomSet atoms;
+    getAtoms(f, atoms);
     Valuation v;
-    for(const auto& atom : atoms)
+    for(const std::string& atom : atoms)
         v[atom] = false;
-
+    long long treeCount = 0;
+    auto start = std::chrono::steady_clock::now();
     do {
-        if(evaluate(f, v))
-            return v;
+        treeCount += evaluate(f, v);
     } while(next(v));
-    return {};
+    double treeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Bytecode b = compileBytecode(f);
+    std::vector<std::uint8_t> values(b.atoms.size()), stack;
+    long long bytecodeCount = 0;
+    start = std::chrono::steady_clock::now();
+    do {
+        bytecodeCount += evaluate(b, values, stack);
+        std::size_t i = 0;
+        while(i < values.size() && values[i])
+            values[i++] = 0;
+        if(i == values.size())
+            break;
+        values[i] = 1;
+    } while(true);
+    double bytecodeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    IncrementalFormula g = incremental(f);
+    long long grayCount = g.value();
+    start = std::chrono::steady_clock::now();
+    for(std::uint64_t k = 1; k < (std::uint64_t(1) << g.c.atoms.size()); k++) {
+        flip(g, std::countr_zero(k));
+        grayCount += g.value();
+    }
+    double grayTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Tree walk: " << treeTime << "s, " << treeCount << " true" << std::endl;
+    std::cout << "Bytecode: " << bytecodeTime << "s, " << bytecodeCount << " true, "
+              << b.code.size() << " instructions" << std::endl;
+    std::cout << "Gray code, incremental: " << grayTime << "s, " << grayCount << " true, "
+              << g.c.code.size() << " nodes" << std::endl;
 }
 
-FormulaPtr simplify(const FormulaPtr& f) {
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return f;
-    if(is<Not>(f)) {
-        FormulaPtr s = simplify(as<Not>(f).subformula);
-        if(is<True>(s))
-            return ptr(False{});
-        if(is<False>(s))
-            return ptr(True{});
-        return ptr(Not{s});
+// Broj izvrsenih instrukcija grananja u korisnickom kodu ove niti (hardverski brojac preko
+// perf_event_open); bez brojaca (npr. u virtuelnoj masini) vrednost je prazna
+struct BranchCounter {
+    int fd = -1;
+
+    BranchCounter() {
+#ifdef __linux__
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
     }
-    auto b = as<Binary>(f);
-    FormulaPtr ls = simplify(b.left);
-    FormulaPtr rs = simplify(b.right);
-    if(b.type == Binary::And) {
-        if(is<False>(ls) || is<False>(rs))
-            return ptr(False{});
-        if(is<True>(ls))
-            return rs;
-        if(is<True>(rs))
-            return ls;
-        return ptr(Binary{Binary::And, ls, rs});
+    BranchCounter(const BranchCounter&) = delete;
+    BranchCounter& operator=(const BranchCounter&) = delete;
+    ~BranchCounter() {
+        if(fd != -1)
+            close(fd);
     }
-    if(b.type == Binary::Or) {
 
+    void start() {
+#ifdef __linux__
+        if(fd != -1) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    std::optional<std::uint64_t> stop() {
+        std::uint64_t count = 0;
+#ifdef __linux__
+        if(fd != -1) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if(read(fd, &count, sizeof(count)) == sizeof(count))
+                return count;
+        }
+#endif
+        return {};
+    }
+};
+
+// Brojanje za benchmarkDispatch: provere vrste cvora pri izboru grane i kopije alternative
+// (vrednost je kopija ako joj adresa nije adresa alternative u cvoru stabla)
+struct DispatchCount {
+    std::size_t tests = 0, copies = 0;
+
+    template<typename T>
+    bool is(const FormulaPtr& f) {
+        tests++;
+        return ::is<T>(f);
     }
-    if(b.type == Binary::Impl) {
 
+    template<typename T>
+    void value(const T& value, const FormulaPtr& f) { copies += &value != std::get_if<T>(f.get()); }
+};
+
+// Isto bez brojanja, za merenje vremena
+struct NoCount {
+    template<typename T>
+    bool is(const FormulaPtr& f) { return ::is<T>(f); }
+
+    template<typename T>
+    void value(const T&, const FormulaPtr&) {}
+};
+
+// Grananje nizom provera is<T> i kopija alternative (kao pre uvodjenja match), naspram match:
+// complexity i evaluate nad istim velikim stablom. Vreme je najbolje od Repeats merenja, posle
+// jednog zagrevanja, a nacini se smenjuju, pa nijedan ne placa hladan kes ili spor procesor.
+// Provere vrste i kopije broji poseban prolaz (DispatchCount), van merenja vremena; kopija
+// Not/Binary kopira i shared_ptr potomaka, tj. menja brojace referenci. Broj grananja meri
+// hardverski brojac (BranchCounter), ako je dostupan.
+void benchmarkDispatch(int formulaCount) {
+    std::mt19937 rng(42);
+    FormulaParser parser;
+    ParseError error;
+    std::vector<FormulaPtr> formulas;
+    for(int i = 0; i < formulaCount; i++) {
+        std::string text;
+        randomFormulaText(8, rng, text);
+        formulas.push_back(parser.parse(text, error));
     }
-    if(b.type == Binary::Eq) {
+    while(formulas.size() > 1) {
+        std::vector<FormulaPtr> next;
+        for(std::size_t i = 0; i + 1 < formulas.size(); i += 2)
+            next.push_back(ptr(Binary{Binary::Or, formulas[i], formulas[i + 1]}));
+        if(formulas.size() % 2)
+            next.push_back(formulas.back());
+        formulas.swap(next);
+    }
+    FormulaPtr f = formulas[0];
+    AtomSet atoms;
+    getAtoms(f, atoms);
+    Valuation v;
+    for(const std::string& atom : atoms)
+        v[atom] = rng() % 2;
+
+    auto complexityChain = [](auto& count) {
+        return [&count](const FormulaPtr& g, int* args) {
+            if(count.template is<False>(g) || count.template is<True>(g) || count.template is<Atom>(g))
+                return 0;
+            if(count.template is<Not>(g)) {
+                Not n = std::get<Not>(*g);
+                count.value(n, g);
+                return 1 + args[0];
+            }
+            Binary b = std::get<Binary>(*g);
+            count.value(b, g);
+            return 1 + args[0] + args[1];
+        };
+    };
+    auto evaluateChain = [&v](auto& count) {
+        return [&count, &v](const FormulaPtr& g, bool* args) -> bool {
+            if(count.template is<False>(g))
+                return false;
+            if(count.template is<True>(g))
+                return true;
+            if(count.template is<Atom>(g)) {
+                Atom a = std::get<Atom>(*g);
+                count.value(a, g);
+                return v[a.name];
+            }
+            if(count.template is<Not>(g)) {
+                Not n = std::get<Not>(*g);
+                count.value(n, g);
+                return !args[0];
+            }
+            Binary b = std::get<Binary>(*g);
+            count.value(b, g);
+            switch(b.type) {
+                case Binary::And:  return args[0] && args[1];
+                case Binary::Or:   return args[0] || args[1];
+                case Binary::Impl: return !args[0] || args[1];
+                case Binary::Eq:   return args[0] == args[1];
+            }
+            return false;
+        };
+    };
+    // complexity i evaluate biraju granu jednim match po cvoru, a grana dobija referencu
+    auto matchCounted = [](DispatchCount& count) {
+        return [&count](const FormulaPtr& g, int*) {
+            return match(g, [&](const auto& value) {
+                count.tests++;
+                count.value(value, g);
+                return 0;
+            });
+        };
+    };
 
+    struct Measurement {
+        double time = 0;
+        std::optional<std::uint64_t> branches;
+    };
+    constexpr int Repeats = 5;
+    BranchCounter branchCounter;
+    NoCount noCount;
+    auto measure = [&](auto run, auto& result, Measurement& best, int repeat) {
+        auto start = std::chrono::steady_clock::now();
+        branchCounter.start();
+        result = run();
+        std::optional<std::uint64_t> branches = branchCounter.stop();
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(repeat > 0 && (best.time == 0 || time < best.time))
+            best = {time, branches};
+    };
+    int chainComplexity = 0, matchComplexity = 0;
+    bool chainValue = false, matchValue = false;
+    Measurement complexityChainRun, complexityMatchRun, evaluateChainRun, evaluateMatchRun;
+    for(int repeat = 0; repeat <= Repeats; repeat++) {
+        measure([&] { return fold<int>(f, complexityChain(noCount)); }, chainComplexity, complexityChainRun, repeat);
+        measure([&] { return complexity(f); }, matchComplexity, complexityMatchRun, repeat);
+        measure([&] { return fold<bool>(f, evaluateChain(noCount)); }, chainValue, evaluateChainRun, repeat);
+        measure([&] { return evaluate(f, v); }, matchValue, evaluateMatchRun, repeat);
     }
+
+    DispatchCount complexityChainCount, evaluateChainCount, matchCount;
+    fold<int>(f, complexityChain(complexityChainCount));
+    fold<bool>(f, evaluateChain(evaluateChainCount));
+    fold<int>(f, matchCounted(matchCount));
+
+    auto report = [](const char* name, const Measurement& m, const DispatchCount& count, bool same) {
+        std::cout << name << ": " << m.time << "s, " << count.tests << " kind tests, " << count.copies << " copies";
+        if(m.branches)
+            std::cout << ", " << *m.branches << " branches";
+        std::cout << (same ? "" : " (MISMATCH)") << std::endl;
+    };
+    std::cout << "Formula: " << matchComplexity << " connectives, " << atoms.size() << " atoms; best of "
+              << Repeats << " runs" << (complexityChainRun.branches ? "" : ", no hardware branch counter") << std::endl;
+    report("complexity, is<T> chain + fold", complexityChainRun, complexityChainCount, chainComplexity == matchComplexity);
+    report("complexity, match + stack", complexityMatchRun, matchCount, true);
+    report("evaluate, is<T> chain", evaluateChainRun, evaluateChainCount, chainValue == matchValue);
+    report("evaluate, match", evaluateMatchRun, matchCount, true);
+}
+
+FormulaPtr simplify(const FormulaPtr& f) {
+    return foldShared<FormulaPtr>(f, [](const FormulaPtr& g, FormulaPtr* args) -> FormulaPtr {
+        return match(g,
+            [&](const Not&) {
+                const FormulaPtr& s = args[0];
+                if(is<True>(s))
+                    return ptr(False{});
+                if(is<False>(s))
+                    return ptr(True{});
+                return ptr(Not{s});
+            },
+            [&](const Binary& b) {
+                auto type = b.type;
+                const FormulaPtr& ls = args[0];
+                const FormulaPtr& rs = args[1];
+                if(type == Binary::And) {
+                    if(is<False>(ls) || is<False>(rs))
+                        return ptr(False{});
+                    if(is<True>(ls))
+                        return rs;
+                    if(is<True>(rs))
+                        return ls;
+                    return ptr(Binary{Binary::And, ls, rs});
+                }
+                if(type == Binary::Or) {
+                    if(is<True>(ls) || is<True>(rs))
+                        return ptr(True{});
+                    if(is<False>(ls))
+                        return rs;
+                    if(is<False>(rs))
+                        return ls;
+                    return ptr(Binary{Binary::Or, ls, rs});
+                }
+                if(type == Binary::Impl) {
+                    if(is<False>(ls) || is<True>(rs))
+                        return ptr(True{});
+                    if(is<True>(ls))
+                        return rs;
+                    if(is<False>(rs))
+                        return ptr(Not{ls});
+                    return ptr(Binary{Binary::Impl, ls, rs});
+                }
+                if(is<True>(ls))
+                    return rs;
+                if(is<True>(rs))
+                    return ls;
+                if(is<False>(ls) && is<False>(rs))
+                    return ptr(True{});
+                if(is<False>(ls))
+                    return ptr(Not{rs});
+                if(is<False>(rs))
+                    return ptr(Not{ls});
+                return ptr(Binary{Binary::Eq, ls, rs});
+            },
+            [&](const auto&) { return g; });
+    });
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if(argc > 1 && std::string(argv[1]) == "--bench") {
+        int first = argc > 2 ? std::stoi(argv[2]) : 24;
+        benchmarkThreads(first, argc > 3 ? std::stoi(argv[3]) : std::max(first, 32));
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--bench-eval") {
+        benchmarkEvaluation(argc > 2 ? std::stoi(argv[2]) : 18);
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--bench-dispatch") {
+        benchmarkDispatch(argc > 2 ? std::stoi(argv[2]) : 20000);
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--bench-parse") {
+        benchmarkParsing(argc > 2 ? std::stoul(argv[2]) : 20, argc > 3 ? argv[3] : "");
+        return 0;
+    }
+
     FormulaPtr p = ptr(Atom{"p"});
     FormulaPtr q = ptr(Atom{"q"});
     FormulaPtr pAndq = ptr(Binary{Binary::And, p, q});
@@ -231,6 +2109,10 @@ int main() {
     Valuation v = {{"p", true}, {"q", false}};
     std::cout << (evaluate(pAndq, v) ? "True" : "False") << std::endl;
 
+    // Strukturno jednake formule su isti cvor
+    FormulaPtr pAndq2 = ptr(Binary{Binary::And, ptr(Atom{"p"}), ptr(Atom{"q"})});
+    std::cout << "Same node: " << (pAndq == pAndq2) << std::endl;
+
     table(pAndq);
 
     auto satV = isSatisfiable(pAndq);
@@ -252,6 +2134,56 @@ int main() {
     else
         std::cout << "UNSAT" << std::endl;
 
+    // BDD: implikacija i disjunkcija su razlicite formule, ali isti dijagram
+    BddManager manager;
+    std::vector<std::string> pq = {"p", "q"};
+    Bdd implication = toBdd(manager, ptr(Binary{Binary::Impl, p, q}), pq);
+    Bdd disjunction = toBdd(manager, ptr(Binary{Binary::Or, ptr(Not{p}), q}), pq);
+    std::cout << "BDD equivalent: " << (implication == disjunction)
+              << ", models: " << satCount(implication, 2) << std::endl;
+
+    // (a0 & b0) | (a1 & b1) | ... je eksponencijalno velik ako su svi a ispred svih b,
+    // a prosejavanje nalazi redosled a0 b0 a1 b1 ... sa linearnim dijagramom
+    FormulaPtr pairs = ptr(False{});
+    std::vector<std::string> pairAtoms;
+    for(int i = 0; i < 10; i++) {
+        pairs = ptr(Binary{Binary::Or, ptr(Binary{Binary::And, ptr(Atom{"a" + std::to_string(i)}),
+                                                  ptr(Atom{"b" + std::to_string(i)})}), pairs});
+        pairAtoms.push_back("a" + std::to_string(i));
+        pairAtoms.push_back("b" + std::to_string(i));
+    }
+    std::sort(begin(pairAtoms), end(pairAtoms));
+    Bdd pairsBdd = toBdd(manager, pairs, pairAtoms);
+    std::size_t before = manager.nodeCount(pairsBdd.edge);
+    manager.reorder();
+    std::cout << "BDD nodes: " << before << ", after sifting " << manager.nodeCount(pairsBdd.edge)
+              << ", models " << satCount(pairsBdd, 20) << std::endl;
+
+    FormulaPtr chain = equivalenceChain(24);
+    std::cout << "Chain formula: " << (isSatisfiable(chain) ? "SAT" : "UNSAT") << std::endl;
+
+    // Duboka formula: p0 & (p1 & (p2 & ...)) sa milion atoma
+    FormulaPtr deep = ptr(True{});
+    for(int i = 0; i < 1000000; i++)
+        deep = ptr(Binary{Binary::And, ptr(Atom{"p" + std::to_string(i % 100)}), deep});
+    Valuation deepV;
+    std::cout << "Deep formula: " << complexity(deep) << " connectives, "
+              << print(deep).size() << " characters, value " << evaluate(deep, deepV) << std::endl;
+
+    // Smena bez pogodaka vraca isti cvor, a p0 <-> p1 zamenjeni dva puta daju polaznu formulu
+    FormulaPtr p0 = ptr(Atom{"p0"}), p1 = ptr(Atom{"p1"});
+    Substitution swap = {{p0.get(), p1}, {p1.get(), p0}};
+    std::cout << "Substitution: unchanged " << (substitute(deep, q, p) == deep) << ", swapped twice "
+              << (substitute(substitute(deep, swap), swap) == deep) << std::endl;
+
+    // Ispis formule se parsira nazad u isti cvor, bez obzira na dubinu
+    FormulaParser parser;
+    ParseError error;
+    std::cout << "Parsed deep formula, same node: " << (parser.parse(print(deep), error) == deep) << std::endl;
+    std::cout << "Parsed: " << print(parser.parse("~p | q & r -> s -> T", error)) << std::endl;
+    if(!parser.parse("(p & q) -> ~(r", error))
+        std::cout << "Parse error at byte " << error.offset << ": " << error.message << std::endl;
+
     return 0;
 }
 
@@ -2,9 +2,21 @@
 #include <variant>
 #include <optional>
 #include <memory>
+#include <utility>
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <cstdint>
+#include <array>
+#include <string>
 
 // Structures for defining a Formula
 struct False;
@@ -19,19 +31,386 @@ using FormulaPtr = std::shared_ptr<Formula>;
 struct False {};
 struct True {};
 struct Atom { std::string name; };
-struct Not { FormulaPtr subformula; };
+struct Not {
+    FormulaPtr subformula;
+    ~Not();
+};
 struct Binary {
     enum Type { And, Or, Impl, Eq } type;
     FormulaPtr left, right;
+    ~Binary();
+};
+
+// Grananje po vrsti cvora: match(f, lambde...) poziva lambdu za alternativu koju cvor sadrzi,
+// i to po referenci, bez kopiranja. std::visit bira lambdu jednim skokom po indeksu alternative
+// umesto niza provera is<T>, a lambda sa auto parametrom pokriva sve preostale vrste.
+template<typename... Cases>
+struct Overloaded : Cases... { using Cases::operator()...; };
+
+template<typename... Cases>
+decltype(auto) match(const Formula& f, Cases... cases) { return std::visit(Overloaded{cases...}, f); }
+
+template<typename... Cases>
+decltype(auto) match(const FormulaPtr& f, Cases... cases) { return std::visit(Overloaded{cases...}, *f); }
+
+// Jedinstvena tabela (hash-consing): cvor se pravi samo ako strukturno jednak cvor
+// vec ne postoji, pa su jednake formule uvek isti pokazivac. Cvor odredjuju vrsta cvora
+// i pokazivaci na potformule (koje su i same jedinstvene), odnosno ime atoma.
+std::size_t mixHash(std::size_t h) {
+    h *= 0x9E3779B97F4A7C15;
+    return h ^ (h >> 29);
+}
+
+// Hes cvora ~sub, odnosno (left type right), samo od pokazivaca na potformule
+// 0 oznacava prazno mesto u tabeli, pa hes nikad nije 0
+std::size_t notHash(const Formula* sub) {
+    std::size_t h = mixHash(std::size_t(sub) ^ 3);
+    return h ? h : 1;
+}
+
+std::size_t binaryHash(Binary::Type type, const Formula* left, const Formula* right) {
+    std::size_t h = mixHash(mixHash(std::size_t(left) ^ (4 + 8 * type)) ^ std::size_t(right));
+    return h ? h : 1;
+}
+
+std::size_t nodeHash(const Formula& f) {
+    std::size_t h = match(f,
+        [&](const Atom& a) { return mixHash(std::hash<std::string>()(a.name) ^ f.index()); },
+        [&](const Not& n) { return notHash(n.subformula.get()); },
+        [&](const Binary& b) { return binaryHash(b.type, b.left.get(), b.right.get()); },
+        [&](const auto&) { return mixHash(f.index() + 1); });
+    return h ? h : 1;
+}
+
+bool sameNode(const Formula& f, const Formula& g) {
+    if(f.index() != g.index())
+        return false;
+    return match(f,
+        [&](const Atom& a) { return a.name == std::get<Atom>(g).name; },
+        [&](const Not& n) { return n.subformula == std::get<Not>(g).subformula; },
+        [&](const Binary& b) {
+            const Binary& c = std::get<Binary>(g);
+            return b.type == c.type && b.left == c.left && b.right == c.right;
+        },
+        [&](const auto&) { return true; });
+}
+
+// Arena za cvorove formula: memorija se uzima od sistema u velikim blokovima, pa je pravljenje
+// cvora obicno samo pomeranje pokazivaca. Memorija unistenog cvora se vraca u listu slobodnih
+// mesta njegove velicine i koristi za sledeci cvor te velicine, pa arena ne raste dok ne raste
+// broj zivih cvorova. Blokovi se vracaju sistemu odjednom (clear) kada u areni nema zivih cvorova.
+struct NodeArena {
+    static constexpr std::size_t BlockSize = 1 << 16;
+    // Mesta su poravnata na Granule bajtova; mesta do SizeClasses * Granule bajtova se ponovo koriste
+    static constexpr std::size_t Granule = 16;
+    static constexpr std::size_t SizeClasses = 16;
+
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::size_t used = BlockSize;
+    std::size_t allocated = 0;
+    std::atomic<std::size_t> live = 0;
+    // Broj unistenih cvorova; njihova memorija ostaje zauzeta dok postoje slabi pokazivaci na njih
+    std::atomic<std::size_t> destroyed = 0;
+    // Arena iz ArenaScope koji je zavrsen: oslobadja se cim u njoj vise nema zivih cvorova
+    bool retired = false;
+    // Slobodna mesta po velicini. Cvor moze da se unisti u bilo kojoj niti, pa se njegovo mesto
+    // atomicno dodaje u returned; allocate (pod bravom pozivaoca) preuzima celu tu listu odjednom
+    // kada mu ponestane mesta u free, pa mesto iz liste skida samo jedna nit u svakom trenutku.
+    std::array<FreeSlot*, SizeClasses> free{};
+    std::array<std::atomic<FreeSlot*>, SizeClasses> returned{};
+
+    static std::size_t sizeClass(std::size_t size, std::size_t align) {
+        return align <= Granule ? (size + Granule - 1) / Granule - 1 : SizeClasses;
+    }
+
+    void* allocate(std::size_t size, std::size_t align) {
+        allocated++;
+        live++;
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            if(!free[c] && returned[c].load(std::memory_order_relaxed))
+                free[c] = returned[c].exchange(nullptr, std::memory_order_acquire);
+            if(FreeSlot* slot = free[c]) {
+                free[c] = slot->next;
+                return slot;
+            }
+            size = (c + 1) * Granule;
+            align = Granule;
+        }
+        used = (used + align - 1) / align * align;
+        if(used + size > BlockSize) {
+            blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(BlockSize));
+            used = 0;
+        }
+        void* p = blocks.back().get() + used;
+        used += size;
+        return p;
+    }
+
+    void deallocate(void* p, std::size_t size, std::size_t align) {
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            FreeSlot* slot = new(p) FreeSlot{returned[c].load(std::memory_order_relaxed)};
+            while(!returned[c].compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {}
+        }
+        live--;
+    }
+
+    bool clear() {
+        if(live > 0)
+            return false;
+        blocks.clear();
+        used = BlockSize;
+        free.fill(nullptr);
+        for(auto& list : returned)
+            list.store(nullptr, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+// Arena u koju ova nit smesta nove cvorove (vidi ArenaScope); nullptr je zajednicka arena
+thread_local NodeArena* scopeArena = nullptr;
+
+// Alokator preko kog std::allocate_shared smesta cvor zajedno sa brojacem referenci u arenu
+template<typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    NodeArena* arena;
+
+    explicit ArenaAllocator(NodeArena* arena) : arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, std::size_t n) { arena->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    template<typename U>
+    void destroy(U* p) {
+        p->~U();
+        arena->destroyed++;
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+};
+
+// Tabela cuva slabe pokazivace, pa ne odrzava cvorove u zivotu: kada se formula unisti,
+// njen unos istekne, a istekli unosi se uklanjaju kada se tabela prosiruje. Tabela je niz sa
+// otvorenim adresiranjem (linearno trazenje) koji pamti i hes svakog cvora, pa se pri trazenju
+// ne pravi kljuc, a cvor se cita (zakljucava i poredi) samo kada mu je hes jednak trazenom.
+struct UniqueTable {
+    struct Entry {
+        std::size_t hash = 0;
+        std::weak_ptr<Formula> node;
+    };
+
+    std::mutex mutex;
+    NodeArena arena;
+    // Arene iz ArenaScope, i zavrsene dok u njima jos ima zivih cvorova
+    std::vector<std::unique_ptr<NodeArena>> scopes;
+    std::vector<Entry> entries = std::vector<Entry>(1024);
+    // Zauzeta mesta, ukljucujuci istekle unose
+    std::size_t used = 0;
+    // destroyedNodes() pri poslednjem izbacivanju isteklih unosa
+    std::size_t destroyedAtSweep = 0;
+
+    std::size_t size() const { return used; }
+
+    std::size_t destroyedNodes() const {
+        std::size_t count = arena.destroyed;
+        for(const auto& scope : scopes)
+            count += scope->destroyed;
+        return count;
+    }
+
+    // Not i Binary imaju destruktor, pa nemaju implicitni konstruktor premestanja: std::move bi
+    // ih kopirao, uz atomicne promene brojaca referenci potformula. Cvor se zato pravi od delova
+    // iz f, koji se premestaju.
+    FormulaPtr allocate(Formula& f) {
+        ArenaAllocator<Formula> allocator(scopeArena ? scopeArena : &arena);
+        return std::visit(Overloaded{
+            [&](Not& n) {
+                return std::allocate_shared<Formula>(allocator, std::in_place_type<Not>, std::move(n.subformula));
+            },
+            [&](Binary& b) {
+                return std::allocate_shared<Formula>(allocator, std::in_place_type<Binary>, b.type,
+                                                     std::move(b.left), std::move(b.right));
+            },
+            [&](auto& g) { return std::allocate_shared<Formula>(allocator, std::move(g)); }}, f);
+    }
+
+    // Premesta unose u tabelu sa capacity mesta
+    void rebuild(std::size_t capacity) {
+        std::vector<Entry> old = std::exchange(entries, std::vector<Entry>(capacity));
+        used = 0;
+        for(Entry& entry : old)
+            if(entry.hash != 0)
+                place(entry.hash, std::move(entry.node));
+    }
+
+    // Izbacuje istekle unose (zivi unosi su posle toga najvise cetvrtina mesta) i oslobadja
+    // arene zavrsenih ArenaScope u kojima vise nema zivih cvorova
+    void sweep() {
+        destroyedAtSweep = destroyedNodes();
+        std::vector<Entry> live;
+        for(Entry& entry : entries)
+            if(entry.hash != 0 && !entry.node.expired())
+                live.push_back(std::move(entry));
+        std::size_t capacity = 1024;
+        while(capacity < 4 * live.size())
+            capacity *= 2;
+        entries.assign(capacity, Entry{});
+        used = 0;
+        for(Entry& entry : live)
+            place(entry.hash, std::move(entry.node));
+        std::erase_if(scopes, [](const auto& scope) { return scope->retired && scope->live == 0; });
+    }
+
+    // Kada su tri cetvrtine tabele zauzete, istekli unosi se izbacuju ako ih je bar polovina
+    // (arena broji unistene cvorove), a inace se tabela samo udvostrucuje. Hes je u unosu, pa duze
+    // trazenje pri vecoj popunjenosti ne cita cvorove, a tabela zauzima upola manje memorije.
+    void reserve(std::size_t count) {
+        if(4 * (used + count) <= 3 * entries.size())
+            return;
+        if(2 * (destroyedNodes() - destroyedAtSweep) >= used)
+            sweep();
+        while(4 * (used + count) > 3 * entries.size())
+            rebuild(2 * entries.size());
+    }
+
+    // Upisuje unos za cvor za koji se zna da nije u tabeli (mesto mora postojati, vidi reserve)
+    void place(std::size_t hash, std::weak_ptr<Formula> node) {
+        std::size_t mask = entries.size() - 1;
+        std::size_t i = hash & mask;
+        while(entries[i].hash != 0)
+            i = (i + 1) & mask;
+        entries[i] = {hash, std::move(node)};
+        used++;
+    }
+
+    void prefetch(std::size_t hash) const {
+        __builtin_prefetch(&entries[hash & (entries.size() - 1)]);
+    }
+
+    // Trazi cvor sa hesom hash za koji same vraca true, bez upisivanja (poziva se pod bravom)
+    template<typename Same>
+    FormulaPtr find(std::size_t hash, Same same) const {
+        std::size_t mask = entries.size() - 1;
+        for(std::size_t i = hash & mask; entries[i].hash != 0; i = (i + 1) & mask)
+            if(entries[i].hash == hash)
+                if(FormulaPtr node = entries[i].node.lock(); node && same(*node))
+                    return node;
+        return nullptr;
+    }
+
+    // Poziva se pod bravom (mutex). Istekli unosi ostaju do sledeceg sweep(): provera da li je
+    // unos istekao bi citala sam cvor, pa se cvorovi citaju samo kada im je hes jednak trazenom.
+    FormulaPtr intern(Formula f, std::size_t hash) {
+        reserve(1);
+        std::size_t mask = entries.size() - 1;
+        std::size_t i = hash & mask;
+        for(; entries[i].hash != 0; i = (i + 1) & mask)
+            if(entries[i].hash == hash)
+                if(FormulaPtr node = entries[i].node.lock(); node && sameNode(*node, f))
+                    return node;
+        FormulaPtr node = allocate(f);
+        entries[i] = {hash, node};
+        used++;
+        return node;
+    }
+
+    FormulaPtr intern(Formula f) {
+        std::size_t hash = nodeHash(f);
+        return intern(std::move(f), hash);
+    }
+};
+
+UniqueTable& uniqueTable() {
+    static UniqueTable table;
+    return table;
+}
+
+FormulaPtr ptr(Formula f) {
+    UniqueTable& table = uniqueTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.intern(std::move(f));
+}
+
+// Vraca svu memoriju cvorova odjednom, npr. posle obrade jednog problema
+// Uspeva samo ako nijedna formula vise nije ziva
+bool releaseFormulas() {
+    UniqueTable& table = uniqueTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    table.sweep();
+    return table.size() == 0 && table.arena.clear();
+}
+
+// Arena jednog problema: dok je ArenaScope ziv, nove cvorove ova nit smesta u njegovu arenu.
+// Kada se zavrsi, arena se vraca sistemu cim u njoj vise nema zivih cvorova, i kada su cvorovi
+// drugih problema (u zajednickoj ili drugim arenama) jos zivi, sto releaseFormulas ne moze.
+// Cvor iz arene problema moze da se deli i sa kasnijim formulama (jedinstvena tabela); tada
+// arena ostaje dok i takve formule ne nestanu.
+struct ArenaScope {
+    NodeArena* arena;
+    NodeArena* previous;
+
+    ArenaScope() {
+        UniqueTable& table = uniqueTable();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        arena = table.scopes.emplace_back(std::make_unique<NodeArena>()).get();
+        previous = std::exchange(scopeArena, arena);
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ~ArenaScope() {
+        scopeArena = previous;
+        UniqueTable& table = uniqueTable();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        arena->retired = true;
+        table.sweep();
+    }
 };
 
-FormulaPtr ptr(const Formula& f) { return std::make_shared<Formula>(f); }
+// Unistavanje formule bez rekurzije: potformule cvora koji se unistava se ne unistavaju
+// odmah (sto bi kod dubokih formula prepunilo stek), vec se odlazu na stek i unistavaju redom
+void release(FormulaPtr& f) {
+    static thread_local std::vector<FormulaPtr>* pending = nullptr;
+    if(!f)
+        return;
+    if(pending) {
+        pending->push_back(std::move(f));
+        return;
+    }
+    // Cvor koji jos neko koristi se ne unistava, pa stek nije potreban
+    if(f.use_count() > 1) {
+        f.reset();
+        return;
+    }
+    std::vector<FormulaPtr> stack;
+    pending = &stack;
+    stack.push_back(std::move(f));
+    while(!stack.empty()) {
+        FormulaPtr g = std::move(stack.back());
+        stack.pop_back();
+    }
+    pending = nullptr;
+}
+
+Not::~Not() { release(subformula); }
+Binary::~Binary() {
+    release(left);
+    release(right);
+}
 
 template<typename T>
 bool is(const FormulaPtr& f) { return std::holds_alternative<T>(*f);}
 
 template<typename T>
-T as(const FormulaPtr& f) { return std::get<T>(*f); }
+const T& as(const FormulaPtr& f) { return std::get<T>(*f); }
 
 // Valuation
 using Valuation = std::map<std::string, bool>;
@@ -39,101 +418,236 @@ using Valuation = std::map<std::string, bool>;
 // AtomSet
 using AtomSet = std::set<std::string>;
 
-int complexity(const FormulaPtr& f) {
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return 0;
-    if(is<Not>(f))
-        return 1 + complexity(as<Not>(f).subformula);
-    if(is<Binary>(f))
-        return 1 + complexity(as<Binary>(f).left) + complexity(as<Binary>(f).right);
-    return 0;
+// Obilazak formule bez rekurzije
+// Duboke formule (npr. konjunkcija milion atoma) bi rekurzijom prepunile stek programa,
+// zato funkcije nad formulama koriste eksplicitni stek
+
+// i-ta potformula formule f, ili nullptr ako je nema
+const FormulaPtr* subformula(const FormulaPtr& f, int i) {
+    return match(f,
+        [&](const Not& n) -> const FormulaPtr* { return i == 0 ? &n.subformula : nullptr; },
+        [&](const Binary& b) -> const FormulaPtr* { return i == 0 ? &b.left : i == 1 ? &b.right : nullptr; },
+        [](const auto&) -> const FormulaPtr* { return nullptr; });
 }
 
-std::string print(const FormulaPtr& f) {
-    if(is<False>(f)) return "F";
-    if(is<True>(f))  return "T";
-    if(is<Atom>(f))  return as<Atom>(f).name;
-    if(is<Not>(f))   return "~" + print(as<Not>(f).subformula);
-    if(is<Binary>(f)) {
-        std::string sign;
-        switch(as<Binary>(f).type) {
-            case Binary::And:  sign = "&";   break;
-            case Binary::Or:   sign = "|";   break;
-            case Binary::Impl: sign = "->";  break;
-            case Binary::Eq:   sign = "<->"; break;
+// walk poziva visit(g, i) za cvor g pre obilaska njegove i-te potformule i jos jednom posle
+// poslednje, pa se isti obilazak koristi za prefiksni, infiksni i postfiksni redosled
+template<typename Visit>
+void walk(const FormulaPtr& f, Visit visit) {
+    std::vector<std::pair<const FormulaPtr*, int>> stack = {{&f, 0}};
+    while(!stack.empty()) {
+        auto [g, i] = stack.back();
+        visit(*g, i);
+        if(const FormulaPtr* sub = subformula(*g, i)) {
+            stack.back().second++;
+            stack.emplace_back(sub, 0);
+        } else
+            stack.pop_back();
+    }
+}
+
+// fold racuna rezultat u postfiksnom redosledu: child(frame, i) vraca stanje i-tog potomka
+// (stanje pored cvora moze da nosi i dodatne podatke, npr. da li je cvor pod negacijom),
+// a combine(frame, args) pravi rezultat cvora od rezultata potomaka
+template<typename Result, typename Frame, typename Child, typename Combine>
+Result fold(Frame root, Child child, Combine combine) {
+    std::vector<std::pair<Frame, int>> stack = {{root, 0}};
+    std::vector<Result> results;
+    Result args[4];
+    while(!stack.empty()) {
+        auto& [frame, i] = stack.back();
+        std::optional<Frame> next = child(frame, i);
+        if(next) {
+            i++;
+            stack.emplace_back(*next, 0);
+            continue;
         }
-        return "(" + print(as<Binary>(f).left) + " " + sign + " " + print(as<Binary>(f).right) + ")";
+        for(int k = i - 1; k >= 0; k--) {
+            args[k] = std::move(results.back());
+            results.pop_back();
+        }
+        results.push_back(combine(std::as_const(frame), args));
+        stack.pop_back();
+    }
+    return std::move(results.back());
+}
+
+// Najcesci slucaj: stanje je sam cvor, a potomci su njegove potformule
+template<typename Result, typename Combine>
+Result fold(const FormulaPtr& f, Combine combine) {
+    auto child = [](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    return fold<Result>(&f, child, [&](const FormulaPtr* g, Result* args) { return combine(*g, args); });
+}
+
+// Kao fold, ali se rezultat racuna jednom za svaki kljuc stanja (npr. cvor i polaritet).
+// Kako su iste potformule isti cvor, formula se obradjuje kao DAG: zajednicke potformule
+// se ne obilaze ponovo, a rezultat je DAG velicine linearne u velicini ulaza.
+template<typename Result, typename Frame, typename Key, typename Child, typename Combine>
+Result foldShared(Frame root, Key key, Child child, Combine combine) {
+    std::unordered_map<std::uintptr_t, Result> memo;
+    auto memoChild = [&](const Frame& frame, int i) -> std::optional<Frame> {
+        if(memo.contains(key(frame)))
+            return {};
+        return child(frame, i);
+    };
+    return fold<Result>(root, memoChild, [&](const Frame& frame, Result* args) -> Result {
+        auto it = memo.find(key(frame));
+        if(it != memo.end())
+            return it->second;
+        Result result = combine(frame, args);
+        memo.emplace(key(frame), result);
+        return result;
+    });
+}
+
+// Najcesci slucaj: kljuc je sam cvor
+template<typename Result, typename Combine>
+Result foldShared(const FormulaPtr& f, Combine combine) {
+    auto key = [](const FormulaPtr* g) { return reinterpret_cast<std::uintptr_t>(g->get()); };
+    auto child = [](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    return foldShared<Result>(&f, key, child, [&](const FormulaPtr* g, Result* args) { return combine(*g, args); });
+}
+
+// Broj razlicitih cvorova formule (velicina DAG-a)
+std::size_t dagSize(const FormulaPtr& f) {
+    std::size_t count = 0;
+    foldShared<int>(f, [&](const FormulaPtr&, int*) {
+        count++;
+        return 0;
+    });
+    return count;
+}
+
+// Broj veznika u stablu formule. Ne treba rezultat po cvoru, pa umesto fold (koji za svaki cvor
+// posebno trazi i-tu potformulu i slaze rezultate potomaka) cvorovi idu kroz stek, uz jedan
+// match po cvoru.
+int complexity(const FormulaPtr& f) {
+    int count = 0;
+    std::vector<const Formula*> stack = {f.get()};
+    while(!stack.empty()) {
+        const Formula* g = stack.back();
+        stack.pop_back();
+        match(*g,
+            [&](const Not& n) {
+                count++;
+                stack.push_back(n.subformula.get());
+            },
+            [&](const Binary& b) {
+                count++;
+                stack.push_back(b.right.get());
+                stack.push_back(b.left.get());
+            },
+            [](const auto&) {});
+    }
+    return count;
+}
+
+std::string sign(Binary::Type type) {
+    switch(type) {
+        case Binary::And:  return "&";
+        case Binary::Or:   return "|";
+        case Binary::Impl: return "->";
+        case Binary::Eq:   return "<->";
     }
     return "";
 }
 
+std::string print(const FormulaPtr& f) {
+    std::string result;
+    walk(f, [&](const FormulaPtr& g, int i) {
+        match(g,
+            [&](const False&) { result += "F"; },
+            [&](const True&) { result += "T"; },
+            [&](const Atom& a) { result += a.name; },
+            [&](const Not&) {
+                if(i == 0)
+                    result += "~";
+            },
+            [&](const Binary& b) {
+                if(i == 0)
+                    result += "(";
+                else if(i == 1)
+                    result += " " + sign(b.type) + " ";
+                else
+                    result += ")";
+            });
+    });
+    return result;
+}
+
 bool evaluate(const FormulaPtr& f, Valuation& v) {
-    if(is<False>(f))
-        return false;
-    if(is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return v[as<Atom>(f).name];
-    if(is<Not>(f))
-        return !evaluate(as<Not>(f).subformula, v);
-    if(is<Binary>(f)) {
-        bool evalL = evaluate(as<Binary>(f).left, v);
-        bool evalR = evaluate(as<Binary>(f).right, v);
-        switch(as<Binary>(f).type) {
-            case Binary::And:  return evalL && evalR;
-            case Binary::Or:   return evalL || evalR;
-            case Binary::Impl: return !evalL || evalR;
-            case Binary::Eq:   return evalL == evalR;
-        }
-    }
-    return false;
+    return fold<bool>(f, [&](const FormulaPtr& g, bool* args) {
+        return match(g,
+            [](const False&) { return false; },
+            [](const True&) { return true; },
+            [&](const Atom& a) -> bool { return v[a.name]; },
+            [&](const Not&) { return !args[0]; },
+            [&](const Binary& b) {
+                switch(b.type) {
+                    case Binary::And:  return args[0] && args[1];
+                    case Binary::Or:   return args[0] || args[1];
+                    case Binary::Impl: return !args[0] || args[1];
+                    case Binary::Eq:   return args[0] == args[1];
+                }
+                return false;
+            });
+    });
 }
 
+// Zbog jedinstvene tabele strukturno jednake formule su isti cvor
 bool equal(const FormulaPtr& f, const FormulaPtr& g) {
-    if(f->index() != g->index())
-        return false;
+    return f == g;
+}
 
-    if(is<False>(f) || is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return as<Atom>(f).name == as<Atom>(g).name;
-    if(is<Not>(f))
-        return equal(as<Not>(f).subformula, as<Not>(g).subformula);
-    if(is<Binary>(f)) {
-        return as<Binary>(f).type == as<Binary>(g).type &&
-               equal(as<Binary>(f).left, as<Binary>(g).left) &&
-               equal(as<Binary>(f).right, as<Binary>(g).right);
-    }
-    return false;
+// Smena potformula: svako pojavljivanje kljuca iz s zamenjuje se odgovarajucom formulom, i to
+// sve smene odjednom (u umetnutim formulama se nista dalje ne menja). Kljuc je sam cvor, jer su
+// zbog jedinstvene tabele jednake formule isti cvor, pa je poredjenje jedna pretraga u hes mapi.
+// Potformula u kojoj nista nije zamenjeno se ne pravi ponovo, vec se vraca isti cvor,
+// a zajednicke potformule se obradjuju jednom.
+using Substitution = std::unordered_map<const Formula*, FormulaPtr>;
+
+FormulaPtr substitute(const FormulaPtr& f, const Substitution& s) {
+    if(s.empty())
+        return f;
+    auto key = [](const FormulaPtr* g) { return reinterpret_cast<std::uintptr_t>(g->get()); };
+    auto child = [&](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(s.contains(g->get()))
+            return {};
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    auto combine = [&](const FormulaPtr* frame, FormulaPtr* args) -> FormulaPtr {
+        const FormulaPtr& g = *frame;
+        if(auto it = s.find(g.get()); it != s.end())
+            return it->second;
+        return match(g,
+            [&](const Not& n) { return args[0] == n.subformula ? g : ptr(Not{args[0]}); },
+            [&](const Binary& b) {
+                return args[0] == b.left && args[1] == b.right ? g : ptr(Binary{b.type, args[0], args[1]});
+            },
+            [&](const auto&) { return g; });
+    };
+    return foldShared<FormulaPtr>(&f, key, child, combine);
 }
 
 FormulaPtr substitute(const FormulaPtr& f, const FormulaPtr& what, const FormulaPtr& with) {
-    if(equal(f, what))
-        return with;
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return f;
-    if(is<Not>(f))
-        return ptr(Not{substitute(as<Not>(f).subformula, what, with)});
-    if(is<Binary>(f)) {
-        auto binaryF = as<Binary>(f);
-        return ptr(Binary{
-            binaryF.type,
-            substitute(binaryF.left, what, with),
-            substitute(binaryF.right, what, with)
-        });
-    }
-    return FormulaPtr{};
+    return substitute(f, Substitution{{what.get(), with}});
 }
 
 void getAtoms(const FormulaPtr& f, AtomSet& atoms) {
-    if(is<Atom>(f))
-        atoms.insert(as<Atom>(f).name);
-    else if(is<Not>(f))
-        getAtoms(as<Not>(f).subformula, atoms);
-    else if(is<Binary>(f)) {
-        getAtoms(as<Binary>(f).left, atoms);
-        getAtoms(as<Binary>(f).right, atoms);
-    }
+    walk(f, [&](const FormulaPtr& g, int) {
+        if(is<Atom>(g))
+            atoms.insert(std::get<Atom>(*g).name);
+    });
 }
 
 bool next(Valuation& v) {
@@ -189,102 +703,131 @@ std::optional<Valuation> isSatisfiable(const FormulaPtr& f) {
 // Treci cas
 
 FormulaPtr simplify(const FormulaPtr& f) {
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return f;
-    if(is<Not>(f)) {
-        FormulaPtr s = simplify(as<Not>(f).subformula);
-        if(is<True>(s))
-            return ptr(False{});
-        if(is<False>(s))
-            return ptr(True{});
-        return ptr(Not{s});
-    }
-    auto b = as<Binary>(f);
-    FormulaPtr ls = simplify(b.left);
-    FormulaPtr rs = simplify(b.right);
-    if(b.type == Binary::And) {
-        if(is<False>(ls) || is<False>(rs))
-            return ptr(False{});
-        if(is<True>(ls))
-            return rs;
-        if(is<True>(rs))
-            return ls;
-        return ptr(Binary{Binary::And, ls, rs});
-    }
-    if(b.type == Binary::Or) {
-        if(is<True>(ls) || is<True>(rs))
-            return ptr(True{});
-        if(is<False>(ls))
-            return rs;
-        if(is<False>(rs))
-            return ls;
-        return ptr(Binary{Binary::Or, ls, rs});
-    }
-    if(b.type == Binary::Impl) {
-        if(is<False>(ls) || is<True>(rs))
-            return ptr(True{});
-        if(is<True>(ls))
-            return rs;
-        if(is<False>(rs))
-            return ptr(Not{ls});
-        return ptr(Binary{Binary::Impl, ls, rs});
-    }
-    if(b.type == Binary::Eq) {
-        if(is<True>(ls))
-            return rs;
-        if(is<True>(rs))
-            return ls;
-        if(is<False>(ls) && is<False>(rs))
-            return ptr(True{});
-        if(is<False>(ls))
-            return ptr(Not{rs});
-        if(is<False>(rs))
-            return ptr(Not{ls});
-        return ptr(Binary{Binary::Eq, ls, rs});
-    }
-    return FormulaPtr{};
-}
-
-FormulaPtr nnf(const FormulaPtr& f);
+    return foldShared<FormulaPtr>(f, [](const FormulaPtr& g, FormulaPtr* args) -> FormulaPtr {
+        return match(g,
+            [&](const Not&) {
+                const FormulaPtr& s = args[0];
+                if(is<True>(s))
+                    return ptr(False{});
+                if(is<False>(s))
+                    return ptr(True{});
+                return ptr(Not{s});
+            },
+            [&](const Binary& b) {
+                auto type = b.type;
+                const FormulaPtr& ls = args[0];
+                const FormulaPtr& rs = args[1];
+                if(type == Binary::And) {
+                    if(is<False>(ls) || is<False>(rs))
+                        return ptr(False{});
+                    if(is<True>(ls))
+                        return rs;
+                    if(is<True>(rs))
+                        return ls;
+                    return ptr(Binary{Binary::And, ls, rs});
+                }
+                if(type == Binary::Or) {
+                    if(is<True>(ls) || is<True>(rs))
+                        return ptr(True{});
+                    if(is<False>(ls))
+                        return rs;
+                    if(is<False>(rs))
+                        return ls;
+                    return ptr(Binary{Binary::Or, ls, rs});
+                }
+                if(type == Binary::Impl) {
+                    if(is<False>(ls) || is<True>(rs))
+                        return ptr(True{});
+                    if(is<True>(ls))
+                        return rs;
+                    if(is<False>(rs))
+                        return ptr(Not{ls});
+                    return ptr(Binary{Binary::Impl, ls, rs});
+                }
+                if(is<True>(ls))
+                    return rs;
+                if(is<True>(rs))
+                    return ls;
+                if(is<False>(ls) && is<False>(rs))
+                    return ptr(True{});
+                if(is<False>(ls))
+                    return ptr(Not{rs});
+                if(is<False>(rs))
+                    return ptr(Not{ls});
+                return ptr(Binary{Binary::Eq, ls, rs});
+            },
+            [&](const auto&) { return g; });
+    });
+}
+
+// Stanje obilaska za NNF: cvor i da li se nalazi pod negacijom
+// Svaki cvor se prevodi najvise jednom za svaki polaritet, pa ugnjezdene ekvivalencije
+// (cije se potformule javljaju u oba polariteta) ne dovode do eksponencijalnog rada
+struct NnfFrame {
+    const FormulaPtr* f;
+    bool negated;
+};
+
+FormulaPtr nnf(const FormulaPtr& f, bool negated) {
+    auto child = [](const NnfFrame& frame, int i) -> std::optional<NnfFrame> {
+        const FormulaPtr& g = *frame.f;
+        bool neg = frame.negated;
+        if(is<Not>(g) && i == 0)
+            return NnfFrame{subformula(g, 0), !neg};
+        if(!is<Binary>(g) || i >= 4)
+            return {};
+        switch(as<Binary>(g).type) {
+            case Binary::And:
+            case Binary::Or:
+                if(i < 2)
+                    return NnfFrame{subformula(g, i), neg};
+                break;
+            case Binary::Impl:
+                if(i < 2)
+                    return NnfFrame{subformula(g, i), i == 0 ? !neg : neg};
+                break;
+            case Binary::Eq:
+                // (~A | B) & (A | ~B), odnosno (A & ~B) | (~A & B) pod negacijom
+                return NnfFrame{subformula(g, i % 2), (i == 0 || i == 3) != neg};
+        }
+        return {};
+    };
+    auto combine = [](const NnfFrame& frame, FormulaPtr* args) -> FormulaPtr {
+        const FormulaPtr& g = *frame.f;
+        bool neg = frame.negated;
+        return match(g,
+            [&](const False&) { return neg ? ptr(True{}) : g; },
+            [&](const True&) { return neg ? ptr(False{}) : g; },
+            [&](const Atom&) { return neg ? ptr(Not{g}) : g; },
+            [&](const Not&) { return args[0]; },
+            [&](const Binary& b) {
+                switch(b.type) {
+                    case Binary::And:
+                        return ptr(Binary{neg ? Binary::Or : Binary::And, args[0], args[1]});
+                    case Binary::Or:
+                        return ptr(Binary{neg ? Binary::And : Binary::Or, args[0], args[1]});
+                    case Binary::Impl:
+                        return ptr(Binary{neg ? Binary::And : Binary::Or, args[0], args[1]});
+                    case Binary::Eq:
+                        return ptr(Binary{neg ? Binary::Or : Binary::And,
+                                          ptr(Binary{neg ? Binary::And : Binary::Or, args[0], args[1]}),
+                                          ptr(Binary{neg ? Binary::And : Binary::Or, args[2], args[3]})});
+                }
+                return FormulaPtr{};
+            });
+    };
+    auto key = [](const NnfFrame& frame) {
+        return reinterpret_cast<std::uintptr_t>(frame.f->get()) | frame.negated;
+    };
+    return foldShared<FormulaPtr>(NnfFrame{&f, negated}, key, child, combine);
+}
 
 FormulaPtr nnfNot(const FormulaPtr& f) {
-    if(is<Atom>(f))
-        return ptr(Not{f});
-    if(is<Not>(f))
-        return nnf(as<Not>(f).subformula);
-    auto b = as<Binary>(f);
-    if(b.type == Binary::And)
-        return ptr(Binary{Binary::Or, nnfNot(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Or)
-        return ptr(Binary{Binary::And, nnfNot(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Impl)
-        return ptr(Binary{Binary::And, nnf(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Eq)
-        return ptr(Binary{
-            Binary::Or,
-            ptr(Binary{Binary::And, nnf(b.left), nnfNot(b.right)}),
-            ptr(Binary{Binary::And, nnfNot(b.left), nnf(b.right)})
-        });
+    return nnf(f, true);
 }
 
 FormulaPtr nnf(const FormulaPtr& f) {
-   if(is<False>(f) || is<True>(f) || is<Atom>(f))
-       return f;
-   if(is<Not>(f))
-       return nnfNot(as<Not>(f).subformula);
-   auto b = as<Binary>(f);
-   if(b.type == Binary::And)
-       return ptr(Binary{Binary::And, nnf(b.left), nnf(b.right)});
-   if(b.type == Binary::Or)
-       return ptr(Binary{Binary::Or, nnf(b.left), nnf(b.right)});
-   if(b.type == Binary::Impl)
-       return ptr(Binary{Binary::Or, nnfNot(b.left), nnf(b.right)});
-   if(b.type == Binary::Eq)
-       return ptr(Binary{Binary::And,
-                         ptr(Binary{Binary::Or, nnfNot(b.left), nnf(b.right)}),
-                         ptr(Binary{Binary::Or, nnf(b.left), nnfNot(b.right)})
-                  });
-   return FormulaPtr{};
+    return nnf(f, false);
 }
 
 struct Literal {
@@ -295,37 +838,290 @@ struct Literal {
 using Clause = std::vector<Literal>;
 using NormalForm = std::vector<Clause>;
 
-template<typename List>
-List concat(const List& l, const List& r) {
-    List result;
-    std::copy(begin(l), end(l), std::back_inserter(result));
-    std::copy(begin(r), end(r), std::back_inserter(result));
-    return result;
+// Tokom pravljenja KNF klauza je sortiran skup celobrojnih literala: atom broj i je literal i,
+// a njegova negacija -i. Literali su sortirani po atomu, pa su ponovljeni i komplementarni
+// literali susedni: ponovljeni se izbacuju, a klauza sa komplementarnim (tautologija) odmah odbacuje.
+using IntClause = std::vector<int>;
+
+bool literalLess(int a, int b) {
+    return std::abs(a) < std::abs(b) || (std::abs(a) == std::abs(b) && a < b);
+}
+
+// Vraca false ako je klauza tautologija
+bool normalize(IntClause& c) {
+    std::sort(begin(c), end(c), literalLess);
+    c.erase(std::unique(begin(c), end(c)), end(c));
+    for(std::size_t i = 1; i < c.size(); i++)
+        if(c[i] == -c[i - 1])
+            return false;
+    return true;
+}
+
+// 64-bitni potpis klauze (Blumov filter njenih literala): D moze biti podskup od C
+// samo ako je svaki bit potpisa od D postavljen i u potpisu od C
+std::uint64_t clauseSignature(const IntClause& c) {
+    std::uint64_t signature = 0;
+    for(int literal : c)
+        signature |= std::uint64_t(1) << ((2 * std::abs(literal) + (literal < 0)) % 64);
+    return signature;
+}
+
+// Skup klauza bez tautologija i bez klauza koje sadrze neku drugu klauzu (podsumpcija):
+// nova klauza se odbacuje ako je neka postojeca njen podskup (unapred), a postojece klauze
+// koje su nadskup nove se uklanjaju (unazad)
+struct ClauseSet {
+    std::vector<IntClause> clauses;
+    std::vector<std::uint64_t> signatures;
+    std::vector<bool> removed;
+    std::size_t live = 0;
+    // Klauze po literalima koje sadrze, i po svom prvom literalu (0 za praznu klauzu)
+    std::unordered_map<int, std::vector<std::size_t>> occurrences, first;
+
+    std::size_t size() const { return live; }
+
+    // Da li je klauza sub podskup klauze super
+    static bool subsumes(const IntClause& sub, std::uint64_t subSignature, const IntClause& super, std::uint64_t superSignature) {
+        return (subSignature & ~superSignature) == 0 &&
+               std::includes(begin(super), end(super), begin(sub), end(sub), literalLess);
+    }
+
+    void add(IntClause c) {
+        if(!normalize(c))
+            return;
+        std::uint64_t signature = clauseSignature(c);
+
+        // Podskup od c pocinje nekim literalom iz c, ili je prazan
+        for(int key : c)
+            if(auto it = first.find(key); it != first.end())
+                for(std::size_t d : it->second)
+                    if(!removed[d] && subsumes(clauses[d], signatures[d], c, signature))
+                        return;
+        if(auto it = first.find(0); it != first.end() && !it->second.empty())
+            return;
+
+        // Nadskup od c sadrzi svaki literal iz c, pa je dovoljno pregledati najkracu listu
+        if(c.empty()) {
+            std::fill(begin(removed), end(removed), true);
+            live = 0;
+        }
+        else {
+            int rarest = *std::min_element(begin(c), end(c), [&](int a, int b) {
+                return occurrences[a].size() < occurrences[b].size();
+            });
+            for(std::size_t e : occurrences[rarest])
+                if(!removed[e] && subsumes(c, signature, clauses[e], signatures[e])) {
+                    removed[e] = true;
+                    live--;
+                }
+        }
+
+        std::size_t index = clauses.size();
+        for(int literal : c)
+            occurrences[literal].push_back(index);
+        first[c.empty() ? 0 : c[0]].push_back(index);
+        clauses.push_back(std::move(c));
+        signatures.push_back(signature);
+        removed.push_back(false);
+        live++;
+    }
+
+    template<typename Visit>
+    void forEach(Visit visit) const {
+        for(std::size_t i = 0; i < clauses.size(); i++)
+            if(!removed[i])
+                visit(clauses[i]);
+    }
+};
+
+// Konjunkcija: klauze manjeg skupa se dodaju u veci
+ClauseSet conjoin(ClauseSet& l, ClauseSet& r) {
+    if(l.size() < r.size())
+        std::swap(l, r);
+    r.forEach([&](const IntClause& c) { l.add(c); });
+    return std::move(l);
 }
 
-NormalForm cross(const NormalForm& l, const NormalForm& r) {
-    NormalForm result;
-    for(const auto& lc : l)
-        for(const auto& rc : r)
-            result.push_back(concat(lc, rc));
+// Disjunkcija: unija svake klauze levog i svake klauze desnog skupa (distributivnost)
+ClauseSet disjoin(const ClauseSet& l, const ClauseSet& r) {
+    ClauseSet result;
+    l.forEach([&](const IntClause& lc) {
+        r.forEach([&](const IntClause& rc) {
+            IntClause c = lc;
+            c.insert(end(c), begin(rc), end(rc));
+            result.add(std::move(c));
+        });
+    });
     return result;
 }
 
+// Numeracija atoma; atomi formule se numerisu azbucnim redom, pa novi (Tseitinovi) atomi
+struct AtomNumbering {
+    std::unordered_map<std::string, int> index;
+    std::vector<std::string> names = {""};
+
+    int literal(const std::string& name, bool pos) {
+        auto [it, inserted] = index.try_emplace(name, int(names.size()));
+        if(inserted)
+            names.push_back(name);
+        return pos ? it->second : -it->second;
+    }
+
+    // Novi atomi su t1, t2, ...; brojac se pamti, pa k novih atoma kosta O(k)
+    int freshCount = 0;
+
+    int fresh() {
+        std::string name;
+        do
+            name = "t" + std::to_string(++freshCount);
+        while(index.contains(name));
+        return literal(name, true);
+    }
+
+    NormalForm toNormalForm(const ClauseSet& set) const {
+        NormalForm result;
+        set.forEach([&](const IntClause& c) {
+            Clause clause;
+            for(int literal : c)
+                clause.push_back(Literal{literal > 0, names[std::abs(literal)]});
+            result.push_back(std::move(clause));
+        });
+        return result;
+    }
+};
+
+// Zbir i proizvod koji se zasicuju na SIZE_MAX, za procene velicine KNF
+std::size_t saturatingAdd(std::size_t a, std::size_t b) {
+    return a > std::numeric_limits<std::size_t>::max() - b ? std::numeric_limits<std::size_t>::max() : a + b;
+}
+
+std::size_t saturatingMultiply(std::size_t a, std::size_t b) {
+    return a != 0 && b > std::numeric_limits<std::size_t>::max() / a ? std::numeric_limits<std::size_t>::max() : a * b;
+}
+
+// Procena broja klauza KNF dobijene distributivnoscu, bez pravljenja klauza
+// Racuna se nad DAG-om, pa i za ogromne rezultate traje linearno; zasicuje se na SIZE_MAX
+std::size_t cnfSize(const FormulaPtr& f) {
+    return foldShared<std::size_t>(f, [](const FormulaPtr& g, std::size_t* args) -> std::size_t {
+        return match(g,
+            [](const True&) -> std::size_t { return 0; },
+            [&](const Binary& b) -> std::size_t {
+                if(b.type == Binary::And)
+                    return saturatingAdd(args[0], args[1]);
+                return saturatingMultiply(args[0], args[1]);
+            },
+            [](const auto&) -> std::size_t { return 1; });
+    });
+}
+
+// Nacin na koji se disjunkcija prevodi: distributivnoscu, ili tako sto se leva, desna ili obe
+// strane zamenjuju novim atomom x, uz klauzu ~x | C za svaku klauzu C te strane
+enum class CnfChoice { Distribute, NameLeft, NameRight, NameBoth };
+
+using CnfPlan = std::unordered_map<const Formula*, CnfChoice>;
+
+// Plan prevodjenja, pre pravljenja ijedne klauze. Za disjunkciju strana sa l i r klauza (po
+// proceni, posle odluka u potformulama) opcije daju redom l * r, l + r, l + r i 1 + l + r klauza,
+// a skup klauza same disjunkcije ima l * r, r, l i 1 klauzu. Bira se opcija sa najmanje klauza
+// medju onima ciji skup ima najvise budget klauza (ako takve nema, imenuju se obe strane); kod
+// jednakog broja klauza prednost ima opcija sa manje novih atoma, pa ona sa manjim skupom.
+// U planu su samo disjunkcije koje se ne razvijaju distributivnoscu.
+CnfPlan cnfPlan(const FormulaPtr& f, std::size_t budget) {
+    CnfPlan plan;
+    foldShared<std::size_t>(f, [&](const FormulaPtr& g, std::size_t* args) -> std::size_t {
+        return match(g,
+            [](const True&) -> std::size_t { return 0; },
+            [&](const Binary& b) -> std::size_t {
+                std::size_t l = args[0], r = args[1];
+                if(b.type == Binary::And)
+                    return saturatingAdd(l, r);
+                struct Option {
+                    CnfChoice choice;
+                    std::size_t clauses;
+                    int fresh;
+                    std::size_t size;
+                };
+                std::size_t named = saturatingAdd(l, r);
+                Option options[] = {{CnfChoice::Distribute, saturatingMultiply(l, r), 0, saturatingMultiply(l, r)},
+                                    {CnfChoice::NameLeft, named, 1, r},
+                                    {CnfChoice::NameRight, named, 1, l},
+                                    {CnfChoice::NameBoth, saturatingAdd(named, 1), 2, 1}};
+                auto key = [](const Option& o) { return std::tuple(o.clauses, o.fresh, o.size); };
+                const Option* best = &options[3];
+                for(const Option& option : options)
+                    if(option.size <= budget && (best->size > budget || key(option) < key(*best)))
+                        best = &option;
+                if(best->choice != CnfChoice::Distribute)
+                    plan[g.get()] = best->choice;
+                return best->size;
+            },
+            [](const auto&) -> std::size_t { return 1; });
+    });
+    return plan;
+}
+
+// KNF formule u NNF, uz imenovanje strana disjunkcija po planu (prazan plan daje cistu
+// distributivnost). Potformule NNF formule se javljaju samo pozitivno, pa je jedan smer
+// definicije dovoljan i rezultat je ekvizadovoljiv sa formulom.
+ClauseSet cnfClauses(const FormulaPtr& f, AtomNumbering& atoms, const CnfPlan& plan) {
+    AtomSet names;
+    getAtoms(f, names);
+    for(const std::string& name : names)
+        atoms.literal(name, true);
+
+    ClauseSet definitions;
+    auto define = [&](ClauseSet& set) {
+        int x = atoms.fresh();
+        set.forEach([&](const IntClause& c) {
+            IntClause definition = c;
+            definition.push_back(-x);
+            definitions.add(std::move(definition));
+        });
+        set = ClauseSet{};
+        set.add({x});
+    };
+
+    ClauseSet result = fold<ClauseSet>(f, [&](const FormulaPtr& g, ClauseSet* args) -> ClauseSet {
+        ClauseSet set;
+        return match(g,
+            [&](const False&) {
+                set.add({});
+                return set;
+            },
+            [&](const True&) { return set; },
+            [&](const Atom& a) {
+                set.add({atoms.literal(a.name, true)});
+                return set;
+            },
+            [&](const Not& n) {
+                set.add({atoms.literal(as<Atom>(n.subformula).name, false)});
+                return set;
+            },
+            [&](const Binary& b) {
+                if(b.type == Binary::And)
+                    return conjoin(args[0], args[1]);
+                auto it = plan.find(g.get());
+                CnfChoice choice = it == plan.end() ? CnfChoice::Distribute : it->second;
+                if(choice == CnfChoice::NameLeft || choice == CnfChoice::NameBoth)
+                    define(args[0]);
+                if(choice == CnfChoice::NameRight || choice == CnfChoice::NameBoth)
+                    define(args[1]);
+                if(args[0].size() < args[1].size())
+                    std::swap(args[0], args[1]);
+                return disjoin(args[0], args[1]);
+            });
+    });
+    return conjoin(result, definitions);
+}
+
 NormalForm cnf(const FormulaPtr& f) {
-    if(is<True>(f))
-        return {};
-    if(is<False>(f))
-        return {{}};
-    if(is<Atom>(f))
-        return {{Literal{true, as<Atom>(f).name}}};
-    if(is<Not>(f))
-        return {{Literal{false, as<Atom>(as<Not>(f).subformula).name}}};
-    auto b = as<Binary>(f);
-    if(b.type == Binary::And)
-        return concat(cnf(b.left), cnf(b.right));
-    if(b.type == Binary::Or)
-        return cross(cnf(b.left), cnf(b.right));
-    return NormalForm{};
+    AtomNumbering atoms;
+    return atoms.toNormalForm(cnfClauses(f, atoms, CnfPlan{}));
+}
+
+// KNF u kojoj skup klauza nijedne potformule po proceni nema vise od budget klauza
+NormalForm cnf(const FormulaPtr& f, std::size_t budget) {
+    AtomNumbering atoms;
+    return atoms.toNormalForm(cnfClauses(f, atoms, cnfPlan(f, budget)));
 }
 
 void print(const NormalForm& f) {
@@ -348,6 +1144,10 @@ int main() {
     Valuation v = {{"p", true}, {"q", false}};
     std::cout << (evaluate(pAndq, v) ? "True" : "False") << std::endl;
 
+    // Strukturno jednake formule su isti cvor
+    FormulaPtr pAndq2 = ptr(Binary{Binary::And, ptr(Atom{"p"}), ptr(Atom{"q"})});
+    std::cout << "Same node: " << (pAndq == pAndq2) << std::endl;
+
     table(pAndq);
 
     auto satV = isSatisfiable(pAndq);
@@ -388,6 +1188,29 @@ int main() {
     std::cout << "CNF: ";
     print(cnfFormula);
 
+    // (a1 & b1) | (a2 & b2) | ... | (a40 & b40) ima 2^40 klauza u distributivnoj KNF
+    FormulaPtr pairs = ptr(False{});
+    for(int i = 1; i <= 40; i++)
+        pairs = ptr(Binary{Binary::Or, ptr(Binary{Binary::And, ptr(Atom{"a" + std::to_string(i)}),
+                                                  ptr(Atom{"b" + std::to_string(i)})}), pairs});
+    std::cout << "Distributive CNF: " << cnfSize(pairs) << " clauses, with budget 64: "
+              << cnf(pairs, 64).size() << " clauses" << std::endl;
+
+    // Duboka formula: p0 & (p1 & (p2 & ...)) sa milion atoma
+    FormulaPtr deep = ptr(True{});
+    for(int i = 0; i < 1000000; i++)
+        deep = ptr(Binary{Binary::And, ptr(Atom{"p" + std::to_string(i % 100)}), deep});
+    std::cout << "Deep formula: " << complexity(deep) << " connectives, "
+              << print(simplify(deep)).size() << " characters, "
+              << cnf(nnf(deep)).size() << " clauses" << std::endl;
+
+    // Ugnjezdene ekvivalencije: p1 <=> (p2 <=> (... <=> p1000)), NNF kao stablo bi bio eksponencijalan
+    FormulaPtr nested = ptr(Atom{"p1000"});
+    for(int i = 999; i >= 1; i--)
+        nested = ptr(Binary{Binary::Eq, ptr(Atom{"p" + std::to_string(i)}), nested});
+    std::cout << "Nested equivalence: " << dagSize(nested) << " nodes, NNF "
+              << dagSize(nnf(nested)) << " nodes" << std::endl;
+
     return 0;
 }
 
@@ -0,0 +1,456 @@
+#ifndef AIG_H
+#define AIG_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "stats.h"
+
+// And-Inverter graf (AIG): jedini veznik je konjunkcija dva literala, a negacija je oznaka na grani.
+// Literal je 2 * cvor + komplement; cvor 0 je konstanta, pa je literal 0 netacno, a literal 1 tacno.
+// Cvorovi se prave samo kroz mkAnd, koji uklanja konstante i trivijalne slucajeve i strukturno
+// hesira, pa su deca uvek cvorovi sa manjim indeksom (niz cvorova je topoloski uredjen).
+// Ulazi su cvorovi bez dece (left == right == 0), sto kapija ne moze da bude.
+struct Aig {
+    static constexpr std::uint32_t FalseLiteral = 0, TrueLiteral = 1;
+
+    struct Node {
+        std::uint32_t left = 0, right = 0;
+    };
+
+    std::vector<Node> nodes = {Node{}};
+    std::vector<std::uint32_t> levels = {0};
+    std::vector<std::uint32_t> inputs;
+    std::vector<std::uint32_t> outputs;
+    std::unordered_map<std::uint64_t, std::uint32_t> table;
+
+    static std::uint32_t node(std::uint32_t literal) { return literal >> 1; }
+    static bool isComplemented(std::uint32_t literal) { return literal & 1; }
+    static std::uint32_t literal(std::uint32_t node, bool complemented = false) { return 2 * node + complemented; }
+
+    bool isAnd(std::uint32_t n) const { return nodes[n].left != 0; }
+
+    std::uint32_t input() {
+        inputs.push_back(std::uint32_t(nodes.size()));
+        nodes.push_back(Node{});
+        levels.push_back(0);
+        return literal(inputs.back());
+    }
+
+    std::uint32_t mkAnd(std::uint32_t a, std::uint32_t b) {
+        if(a > b)
+            std::swap(a, b);
+        if(a == FalseLiteral || a == (b ^ 1))
+            return FalseLiteral;
+        if(a == TrueLiteral || a == b)
+            return b;
+        auto [it, inserted] = table.try_emplace(std::uint64_t(a) << 32 | b, std::uint32_t(nodes.size()));
+        if(inserted) {
+            STATS_ADD(allocated, 1);
+            nodes.push_back(Node{a, b});
+            levels.push_back(1 + std::max(levels[node(a)], levels[node(b)]));
+        }
+        return literal(it->second);
+    }
+
+    std::uint32_t mkOr(std::uint32_t a, std::uint32_t b) { return mkAnd(a ^ 1, b ^ 1) ^ 1; }
+
+    std::uint32_t mkEq(std::uint32_t a, std::uint32_t b) { return mkAnd(mkAnd(a, b ^ 1) ^ 1, mkAnd(a ^ 1, b) ^ 1); }
+
+    // Cvorovi dostizni iz izlaza
+    std::vector<bool> reachable() const {
+        std::vector<bool> needed(nodes.size());
+        for(std::uint32_t output : outputs)
+            needed[node(output)] = true;
+        for(std::size_t n = nodes.size(); n-- > 1;)
+            if(needed[n] && isAnd(std::uint32_t(n)))
+                needed[node(nodes[n].left)] = needed[node(nodes[n].right)] = true;
+        return needed;
+    }
+
+    std::size_t andCount() const {
+        std::vector<bool> needed = reachable();
+        std::size_t count = 0;
+        for(std::uint32_t n = 1; n < nodes.size(); n++)
+            count += needed[n] && isAnd(n);
+        return count;
+    }
+
+    std::uint32_t depth() const {
+        std::uint32_t result = 0;
+        for(std::uint32_t output : outputs)
+            result = std::max(result, levels[node(output)]);
+        return result;
+    }
+
+    // Vrednosti izlaza za 64 valuacije odjednom (bit k reci inputValues[i] je vrednost ulaza i u valuaciji k)
+    std::vector<std::uint64_t> simulate(const std::vector<std::uint64_t>& inputValues) const {
+        std::vector<std::uint64_t> values(nodes.size());
+        for(std::size_t i = 0; i < inputs.size(); i++)
+            values[inputs[i]] = inputValues[i];
+        auto value = [&](std::uint32_t l) { return isComplemented(l) ? ~values[node(l)] : values[node(l)]; };
+        for(std::uint32_t n = 1; n < nodes.size(); n++)
+            if(isAnd(n))
+                values[n] = value(nodes[n].left) & value(nodes[n].right);
+        std::vector<std::uint64_t> result;
+        for(std::uint32_t output : outputs)
+            result.push_back(value(output));
+        return result;
+    }
+};
+
+// Novi graf sa istim ulazima (istim redom), u koji se cvorovi starog prenose po potrebi
+Aig withInputsOf(const Aig& aig, std::vector<std::uint32_t>& map) {
+    Aig result;
+    map.assign(aig.nodes.size(), Aig::FalseLiteral);
+    for(std::uint32_t n : aig.inputs)
+        map[n] = result.input();
+    return result;
+}
+
+std::uint32_t mapLiteral(const std::vector<std::uint32_t>& map, std::uint32_t l) {
+    return map[Aig::node(l)] ^ (l & 1);
+}
+
+// Balansiranje: maksimalna konjunkcija (kapije spojene nekomplementiranim granama, koje
+// nemaju drugih roditelja) se ponovo gradi kao stablo najmanje dubine, tako sto se uvek
+// spajaju dva operanda sa najmanjim nivoom. Broj kapija se ne povecava, a dubina opada
+// (npr. lanac p0 & (p1 & (p2 & ...)) postaje stablo logaritamske dubine).
+Aig balance(const Aig& aig) {
+    std::vector<std::uint32_t> refs(aig.nodes.size());
+    std::vector<bool> root(aig.nodes.size()), needed = aig.reachable();
+    for(std::uint32_t output : aig.outputs)
+        root[Aig::node(output)] = true;
+    for(std::uint32_t n = 1; n < aig.nodes.size(); n++)
+        if(needed[n] && aig.isAnd(n))
+            for(std::uint32_t l : {aig.nodes[n].left, aig.nodes[n].right}) {
+                refs[Aig::node(l)]++;
+                if(Aig::isComplemented(l))
+                    root[Aig::node(l)] = true;
+            }
+
+    std::vector<std::uint32_t> map;
+    Aig result = withInputsOf(aig, map);
+    std::vector<std::uint32_t> leaves, stack;
+    for(std::uint32_t n = 1; n < aig.nodes.size(); n++) {
+        if(!needed[n] || !aig.isAnd(n) || (!root[n] && refs[n] == 1))
+            continue;
+        STATS_ADD(visited, 1);
+        leaves.clear();
+        stack = {aig.nodes[n].left, aig.nodes[n].right};
+        while(!stack.empty()) {
+            std::uint32_t l = stack.back();
+            stack.pop_back();
+            std::uint32_t m = Aig::node(l);
+            if(!Aig::isComplemented(l) && aig.isAnd(m) && !root[m] && refs[m] == 1) {
+                stack.push_back(aig.nodes[m].left);
+                stack.push_back(aig.nodes[m].right);
+            } else
+                leaves.push_back(mapLiteral(map, l));
+        }
+        // Ponovljeni operand je suvisan, a operand i njegova negacija daju netacno
+        std::sort(leaves.begin(), leaves.end());
+        leaves.erase(std::unique(leaves.begin(), leaves.end()), leaves.end());
+        bool contradiction = false;
+        for(std::size_t i = 1; i < leaves.size(); i++)
+            contradiction |= leaves[i] == (leaves[i - 1] ^ 1);
+        if(contradiction) {
+            map[n] = Aig::FalseLiteral;
+            continue;
+        }
+        auto deeper = [&](std::uint32_t a, std::uint32_t b) {
+            return result.levels[Aig::node(a)] > result.levels[Aig::node(b)];
+        };
+        std::priority_queue<std::uint32_t, std::vector<std::uint32_t>, decltype(deeper)> queue(deeper, leaves);
+        while(queue.size() > 1) {
+            std::uint32_t a = queue.top();
+            queue.pop();
+            std::uint32_t b = queue.top();
+            queue.pop();
+            queue.push(result.mkAnd(a, b));
+        }
+        map[n] = queue.top();
+    }
+    for(std::uint32_t output : aig.outputs)
+        result.outputs.push_back(mapLiteral(map, output));
+    return result;
+}
+
+// Najmanje AND-inverter formule za sve funkcije 4 promenljive (tablice istinitosti od 16 bita).
+// Racunaju se jednom, po broju kapija: funkcije cene s su konjunkcije (uz komplemente) funkcija
+// cena i i s - 1 - i. Cena je invarijantna na permutacije i negacije ulaza i izlaza (NPN), pa
+// tabela pokriva sve NPN klase; racuna se do MaxCost kapija (oko 86% funkcija, ostale se ne prepisuju).
+struct AigLibrary {
+    static constexpr std::uint8_t MaxCost = 10, Unknown = 255;
+    static constexpr std::uint16_t Variables[4] = {0xAAAA, 0xCCCC, 0xF0F0, 0xFF00};
+
+    enum Kind : std::uint8_t { Constant, Variable, And };
+    struct Entry {
+        std::uint8_t cost = Unknown;
+        Kind kind = Constant;
+        bool complement = false, leftComplement = false, rightComplement = false;
+        std::uint16_t left = 0, right = 0;
+    };
+
+    std::vector<Entry> entries = std::vector<Entry>(1 << 16);
+
+    AigLibrary() {
+        std::vector<std::vector<std::uint16_t>> byCost(1);
+        auto add = [&](std::uint16_t truth, Entry e) {
+            entries[truth] = e;
+            e.complement = !e.complement;
+            entries[std::uint16_t(~truth)] = e;
+            byCost[e.cost].push_back(truth);
+        };
+        add(0, Entry{0, Constant});
+        for(std::uint16_t i = 0; i < 4; i++)
+            add(Variables[i], Entry{0, Variable, false, false, false, i});
+        for(std::uint8_t s = 1; s <= MaxCost; s++) {
+            byCost.emplace_back();
+            for(int i = 0; i <= (s - 1) / 2; i++) {
+                int j = s - 1 - i;
+                for(std::size_t a = 0; a < byCost[i].size(); a++)
+                    for(std::size_t b = i == j ? a : 0; b < byCost[j].size(); b++)
+                        for(int c = 0; c < 4; c++) {
+                            std::uint16_t f = byCost[i][a], g = byCost[j][b];
+                            std::uint16_t truth = std::uint16_t((c & 1 ? ~f : f) & (c & 2 ? ~g : g));
+                            if(entries[truth].cost == Unknown)
+                                add(truth, Entry{s, And, false, bool(c & 1), bool(c & 2), f, g});
+                        }
+            }
+        }
+    }
+
+    std::uint8_t cost(std::uint16_t truth) const { return entries[truth].cost; }
+
+    // Gradi funkciju nad literalima leaves[0..3] i vraca njen literal
+    std::uint32_t build(Aig& aig, std::uint16_t truth, const std::uint32_t* leaves) const {
+        const Entry& e = entries[truth];
+        std::uint32_t result = Aig::FalseLiteral;
+        if(e.kind == Variable)
+            result = leaves[e.left];
+        else if(e.kind == And)
+            result = aig.mkAnd(build(aig, e.left, leaves) ^ e.leftComplement, build(aig, e.right, leaves) ^ e.rightComplement);
+        return result ^ e.complement;
+    }
+};
+
+const AigLibrary& aigLibrary() {
+    static const AigLibrary library;
+    return library;
+}
+
+// Presek cvora: do 4 cvora (listova) kroz koje prolazi svaki put od cvora do ulaza,
+// i funkcija cvora nad listovima (bit m je vrednost za valuaciju listova m)
+struct AigCut {
+    std::uint8_t size = 0;
+    std::uint32_t leaves[4] = {};
+    std::uint16_t truth = 0;
+};
+
+// Tablica funkcije nad listovima from, prevedena na listove to (from je podskup od to)
+std::uint16_t stretch(std::uint16_t truth, const AigCut& from, const AigCut& to) {
+    int position[4] = {};
+    for(int k = 0; k < from.size; k++)
+        position[k] = int(std::find(to.leaves, to.leaves + to.size, from.leaves[k]) - to.leaves);
+    std::uint16_t result = 0;
+    for(int m = 0; m < 16; m++) {
+        int source = 0;
+        for(int k = 0; k < from.size; k++)
+            source |= ((m >> position[k]) & 1) << k;
+        result |= std::uint16_t(((truth >> source) & 1) << m);
+    }
+    return result;
+}
+
+// Preseci svih cvorova, najvise MaxCuts po cvoru (manji preseci imaju prednost);
+// cuts[offsets[n]..offsets[n + 1]) su preseci cvora n, a prvi je uvek trivijalni {n}
+struct AigCuts {
+    static constexpr std::size_t MaxCuts = 8;
+
+    std::vector<AigCut> cuts;
+    std::vector<std::size_t> offsets = {0, 0};
+
+    explicit AigCuts(const Aig& aig) {
+        std::vector<AigCut> candidates;
+        for(std::uint32_t n = 1; n < aig.nodes.size(); n++) {
+            AigCut trivial;
+            trivial.size = 1;
+            trivial.leaves[0] = n;
+            trivial.truth = AigLibrary::Variables[0];
+            candidates.clear();
+            if(aig.isAnd(n)) {
+                std::uint32_t a = aig.nodes[n].left, b = aig.nodes[n].right;
+                for(std::size_t i = offsets[Aig::node(a)]; i < offsets[Aig::node(a) + 1]; i++)
+                    for(std::size_t j = offsets[Aig::node(b)]; j < offsets[Aig::node(b) + 1]; j++) {
+                        AigCut cut;
+                        if(!merge(cuts[i], cuts[j], cut))
+                            continue;
+                        std::uint16_t l = stretch(cuts[i].truth, cuts[i], cut);
+                        std::uint16_t r = stretch(cuts[j].truth, cuts[j], cut);
+                        cut.truth = std::uint16_t((Aig::isComplemented(a) ? ~l : l) & (Aig::isComplemented(b) ? ~r : r));
+                        addCandidate(candidates, cut);
+                    }
+                std::stable_sort(candidates.begin(), candidates.end(),
+                                 [](const AigCut& x, const AigCut& y) { return x.size < y.size; });
+                if(candidates.size() > MaxCuts - 1)
+                    candidates.resize(MaxCuts - 1);
+            }
+            cuts.push_back(trivial);
+            cuts.insert(cuts.end(), candidates.begin(), candidates.end());
+            offsets.push_back(cuts.size());
+        }
+    }
+
+    // Unija sortiranih listova, ako ih nema vise od 4
+    static bool merge(const AigCut& x, const AigCut& y, AigCut& result) {
+        int i = 0, j = 0;
+        result.size = 0;
+        while(i < x.size || j < y.size) {
+            if(result.size == 4)
+                return false;
+            std::uint32_t next;
+            if(j == y.size || (i < x.size && x.leaves[i] < y.leaves[j]))
+                next = x.leaves[i++];
+            else if(i == x.size || y.leaves[j] < x.leaves[i])
+                next = y.leaves[j++];
+            else {
+                next = x.leaves[i++];
+                j++;
+            }
+            result.leaves[result.size++] = next;
+        }
+        return true;
+    }
+
+    static bool subset(const AigCut& x, const AigCut& y) {
+        return std::includes(y.leaves, y.leaves + y.size, x.leaves, x.leaves + x.size);
+    }
+
+    // Presek koji sadrzi neki drugi presek je suvisan
+    static void addCandidate(std::vector<AigCut>& candidates, const AigCut& cut) {
+        for(const AigCut& other : candidates)
+            if(subset(other, cut))
+                return;
+        std::erase_if(candidates, [&](const AigCut& other) { return subset(cut, other); });
+        candidates.push_back(cut);
+    }
+};
+
+// Lokalno prepisivanje: za svaku kapiju se trazi presek ciju funkciju najmanja formula iz
+// AigLibrary gradi sa manje kapija nego sto ih ima u delu grafa koji bi zamena oslobodila
+// (kapije izmedju cvora i listova koje ne koristi nista van tog dela, MFFC). Odluke se donose
+// od izlaza ka ulazima, a novi graf se gradi od ulaza, pa kapije ispod zamenjenih cvorova
+// nastaju samo ako su potrebne nekom drugom. Strukturno hesiranje u novom grafu dodatno deli
+// iste potformule. Ako rezultat nije manji, vraca se polazni graf.
+Aig rewrite(const Aig& aig) {
+    const AigLibrary& library = aigLibrary();
+    AigCuts cuts(aig);
+    std::vector<bool> live = aig.reachable();
+    std::vector<std::uint32_t> refs(aig.nodes.size());
+    for(std::uint32_t n = 1; n < aig.nodes.size(); n++)
+        if(live[n] && aig.isAnd(n)) {
+            refs[Aig::node(aig.nodes[n].left)]++;
+            refs[Aig::node(aig.nodes[n].right)]++;
+        }
+    for(std::uint32_t output : aig.outputs)
+        refs[Aig::node(output)]++;
+
+    // Broj kapija koje bi se oslobodile kad cvor n ne bi bio potreban (do listova preseka)
+    std::vector<std::uint32_t> stack, released;
+    auto mffcSize = [&](std::uint32_t n, const AigCut& cut) {
+        std::size_t count = 0;
+        stack = {n};
+        released.clear();
+        while(!stack.empty()) {
+            std::uint32_t m = stack.back();
+            stack.pop_back();
+            count++;
+            for(std::uint32_t l : {aig.nodes[m].left, aig.nodes[m].right}) {
+                std::uint32_t c = Aig::node(l);
+                if(!aig.isAnd(c) || std::find(cut.leaves, cut.leaves + cut.size, c) != cut.leaves + cut.size)
+                    continue;
+                released.push_back(c);
+                if(--refs[c] == 0)
+                    stack.push_back(c);
+            }
+        }
+        for(std::uint32_t c : released)
+            refs[c]++;
+        return count;
+    };
+
+    std::vector<const AigCut*> choice(aig.nodes.size(), nullptr);
+    std::vector<bool> needed(aig.nodes.size());
+    for(std::uint32_t output : aig.outputs)
+        needed[Aig::node(output)] = true;
+    for(std::size_t n = aig.nodes.size(); n-- > 1;) {
+        if(!needed[n] || !aig.isAnd(std::uint32_t(n)))
+            continue;
+        STATS_ADD(visited, 1);
+        int bestGain = 0;
+        for(std::size_t i = cuts.offsets[n] + 1; i < cuts.offsets[n + 1]; i++) {
+            std::uint8_t cost = library.cost(cuts.cuts[i].truth);
+            if(cost == AigLibrary::Unknown)
+                continue;
+            int gain = int(mffcSize(std::uint32_t(n), cuts.cuts[i])) - cost;
+            if(gain > bestGain) {
+                bestGain = gain;
+                choice[n] = &cuts.cuts[i];
+            }
+        }
+        if(choice[n])
+            for(int k = 0; k < choice[n]->size; k++)
+                needed[choice[n]->leaves[k]] = true;
+        else
+            needed[Aig::node(aig.nodes[n].left)] = needed[Aig::node(aig.nodes[n].right)] = true;
+    }
+
+    std::vector<std::uint32_t> map;
+    Aig result = withInputsOf(aig, map);
+    for(std::uint32_t n = 1; n < aig.nodes.size(); n++) {
+        if(!needed[n] || !aig.isAnd(n))
+            continue;
+        if(const AigCut* cut = choice[n]) {
+            std::uint32_t leaves[4] = {Aig::FalseLiteral, Aig::FalseLiteral, Aig::FalseLiteral, Aig::FalseLiteral};
+            for(int k = 0; k < cut->size; k++)
+                leaves[k] = map[cut->leaves[k]];
+            map[n] = library.build(result, cut->truth, leaves);
+        } else
+            map[n] = result.mkAnd(mapLiteral(map, aig.nodes[n].left), mapLiteral(map, aig.nodes[n].right));
+    }
+    for(std::uint32_t output : aig.outputs)
+        result.outputs.push_back(mapLiteral(map, output));
+    return result.andCount() < aig.andCount() ? result : aig;
+}
+
+// Jedan korak optimizacije: naziv prolaza, broj kapija i dubina posle njega
+struct AigStep {
+    std::string pass;
+    std::size_t ands;
+    std::uint32_t depth;
+};
+
+// Naizmenicno balansiranje i prepisivanje dok se broj kapija smanjuje (najvise rounds krugova)
+Aig optimize(const Aig& aig, std::vector<AigStep>* steps = nullptr, int rounds = 4) {
+    Aig current = balance(aig);
+    if(steps)
+        steps->push_back({"balance", current.andCount(), current.depth()});
+    for(int i = 0; i < rounds; i++) {
+        std::size_t before = current.andCount();
+        current = balance(rewrite(current));
+        if(steps)
+            steps->push_back({"rewrite + balance", current.andCount(), current.depth()});
+        if(current.andCount() >= before)
+            break;
+    }
+    return current;
+}
+
+#endif //AIG_H
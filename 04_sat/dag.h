@@ -0,0 +1,249 @@
+#ifndef DAG_H
+#define DAG_H
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binarni zapis DAG-a formula (npr. rezultata nnf), koji se posle ucitava bez parsiranja i
+// bez ponovnog racunanja. Cvorovi su u topoloskom redosledu (deca pre roditelja), pa se dete
+// zapisuje kao razlika indeksa roditelja i deteta, sto je obicno mali broj (varint).
+// Imena atoma, simbola i promenljivih su u zajednickoj tabeli niski.
+//
+// Raspored fajla (brojevi fiksne sirine su 32-bitni, little-endian):
+//   zaglavlje: oznaka formata (4 bajta), verzija, broj cvorova, broj korena, broj niski,
+//              duzina niski u bajtovima, duzina zapisa cvorova u bajtovima
+//   pomeraji niski (broj niski + 1), pomeraji zapisa cvorova, indeksi korena
+//   niske (jedna za drugom, bez terminatora), zapisi cvorova
+// Zapis cvora: vrsta (bajt), simbol (varint: 0 ako ga nema, inace indeks niske + 1),
+// broj dece (varint) i za svako dete razlika indeksa (varint, najmanje 1).
+// Pomeraji su fiksne sirine, pa se svakom cvoru pristupa direktno u mapiranom fajlu.
+
+static_assert(std::endian::native == std::endian::little, "DAG format je little-endian");
+
+constexpr std::uint32_t DagVersion = 1;
+constexpr std::size_t DagHeaderWords = 7;
+
+void writeVarint(std::string& out, std::uint32_t value) {
+    while(value >= 0x80) {
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+// Cita varint i pomera p, ne prelazeci end; vraca false ako zapis nije ispravan
+bool readVarint(const unsigned char*& p, const unsigned char* end, std::uint32_t& value) {
+    value = 0;
+    for(int shift = 0; shift < 35 && p < end; shift += 7) {
+        unsigned char byte = *p++;
+        value |= std::uint32_t(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return shift < 28 || byte < 0x10;
+    }
+    return false;
+}
+
+// Varint iz vec proverenog zapisa
+std::uint32_t readVarint(const unsigned char*& p) {
+    std::uint32_t value = 0;
+    for(int shift = 0;; shift += 7) {
+        unsigned char byte = *p++;
+        value |= std::uint32_t(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return value;
+    }
+}
+
+std::uint32_t readWord(const unsigned char* p) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Pravi zapis: cvorovi se dodaju redom (deca pre roditelja), a add vraca indeks cvora
+struct DagWriter {
+    char magic[4];
+    std::string strings;
+    std::vector<std::uint32_t> stringOffsets = {0};
+    std::unordered_map<std::string, std::uint32_t> stringIndex;
+    std::string records;
+    std::vector<std::uint32_t> nodeOffsets;
+    std::vector<std::uint32_t> roots;
+
+    explicit DagWriter(const char (&format)[5]) { std::memcpy(magic, format, 4); }
+
+    // Indeks niske u tabeli (svaka niska se cuva jednom)
+    std::uint32_t string(std::string_view s) {
+        auto [it, inserted] = stringIndex.try_emplace(std::string(s), std::uint32_t(stringOffsets.size() - 1));
+        if(inserted) {
+            strings += s;
+            stringOffsets.push_back(std::uint32_t(strings.size()));
+        }
+        return it->second;
+    }
+
+    // Prazan simbol znaci da ga cvor nema
+    std::uint32_t add(std::uint8_t kind, std::string_view symbol, std::span<const std::uint32_t> children) {
+        std::uint32_t index = std::uint32_t(nodeOffsets.size());
+        nodeOffsets.push_back(std::uint32_t(records.size()));
+        records += char(kind);
+        writeVarint(records, symbol.empty() ? 0 : string(symbol) + 1);
+        writeVarint(records, std::uint32_t(children.size()));
+        for(std::uint32_t child : children)
+            writeVarint(records, index - child);
+        return index;
+    }
+
+    std::uint32_t add(std::uint8_t kind, std::string_view symbol, std::initializer_list<std::uint32_t> children) {
+        return add(kind, symbol, std::span<const std::uint32_t>(children.begin(), children.size()));
+    }
+
+    void root(std::uint32_t index) { roots.push_back(index); }
+
+    void write(std::ostream& out) const {
+        std::uint32_t header[DagHeaderWords - 1] = {DagVersion, std::uint32_t(nodeOffsets.size()),
+                                                    std::uint32_t(roots.size()), std::uint32_t(stringOffsets.size() - 1),
+                                                    std::uint32_t(strings.size()), std::uint32_t(records.size())};
+        out.write(magic, 4);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        auto words = [&](const std::vector<std::uint32_t>& v) {
+            out.write(reinterpret_cast<const char*>(v.data()), std::streamsize(v.size() * sizeof(std::uint32_t)));
+        };
+        words(stringOffsets);
+        words(nodeOffsets);
+        words(roots);
+        out.write(strings.data(), std::streamsize(strings.size()));
+        out.write(records.data(), std::streamsize(records.size()));
+    }
+};
+
+// Cvor procitan iz zapisa; deca se citaju redom pozivima child()
+struct DagNode {
+    std::uint8_t kind;
+    std::uint32_t index;
+    std::string_view symbol;
+    std::uint32_t childCount;
+    const unsigned char* next;
+
+    std::uint32_t child() { return index - readVarint(next); }
+};
+
+// Pogled na zapis u memoriji (npr. mapiran fajl): nista se ne kopira niti alocira
+struct DagImage {
+    const unsigned char* data = nullptr;
+    std::uint32_t nodeCount = 0, rootCount = 0, stringCount = 0;
+    const unsigned char* stringOffsets = nullptr;
+    const unsigned char* nodeOffsets = nullptr;
+    const unsigned char* roots = nullptr;
+    const unsigned char* strings = nullptr;
+    const unsigned char* records = nullptr;
+    const unsigned char* end = nullptr;
+
+    // Proverava zaglavlje i sve zapise jednim prolazom, pa dalji pristup ne proverava granice
+    bool open(std::string_view bytes, const char (&format)[5]) {
+        data = reinterpret_cast<const unsigned char*>(bytes.data());
+        if(bytes.size() < DagHeaderWords * 4 || std::memcmp(data, format, 4) != 0 || readWord(data + 4) != DagVersion)
+            return false;
+        nodeCount = readWord(data + 8);
+        rootCount = readWord(data + 12);
+        stringCount = readWord(data + 16);
+        std::uint64_t stringBytes = readWord(data + 20), recordBytes = readWord(data + 24);
+        std::uint64_t words = DagHeaderWords + std::uint64_t(stringCount) + 1 + nodeCount + rootCount;
+        if(words * 4 + stringBytes + recordBytes != bytes.size())
+            return false;
+        stringOffsets = data + DagHeaderWords * 4;
+        nodeOffsets = stringOffsets + (std::size_t(stringCount) + 1) * 4;
+        roots = nodeOffsets + std::size_t(nodeCount) * 4;
+        strings = roots + std::size_t(rootCount) * 4;
+        records = strings + stringBytes;
+        end = records + recordBytes;
+
+        if(readWord(stringOffsets) != 0 || readWord(stringOffsets + std::size_t(stringCount) * 4) != stringBytes)
+            return false;
+        for(std::uint32_t i = 0; i < stringCount; i++)
+            if(readWord(stringOffsets + std::size_t(i) * 4) > readWord(stringOffsets + std::size_t(i + 1) * 4))
+                return false;
+        for(std::uint32_t i = 0; i < nodeCount; i++) {
+            std::uint32_t offset = readWord(nodeOffsets + std::size_t(i) * 4), symbol, count, delta;
+            if(offset >= recordBytes)
+                return false;
+            const unsigned char* p = records + offset + 1;
+            if(!readVarint(p, end, symbol) || symbol > stringCount || !readVarint(p, end, count))
+                return false;
+            for(std::uint32_t k = 0; k < count; k++)
+                if(!readVarint(p, end, delta) || delta == 0 || delta > i)
+                    return false;
+        }
+        for(std::uint32_t i = 0; i < rootCount; i++)
+            if(readWord(roots + std::size_t(i) * 4) >= nodeCount)
+                return false;
+        return true;
+    }
+
+    std::uint32_t root(std::uint32_t i) const { return readWord(roots + std::size_t(i) * 4); }
+
+    std::string_view string(std::uint32_t i) const {
+        std::uint32_t begin = readWord(stringOffsets + std::size_t(i) * 4);
+        return {reinterpret_cast<const char*>(strings) + begin, readWord(stringOffsets + std::size_t(i + 1) * 4) - begin};
+    }
+
+    DagNode node(std::uint32_t i) const {
+        const unsigned char* p = records + readWord(nodeOffsets + std::size_t(i) * 4);
+        DagNode result{*p++, i, {}, 0, nullptr};
+        if(std::uint32_t symbol = readVarint(p))
+            result.symbol = string(symbol - 1);
+        result.childCount = readVarint(p);
+        result.next = p;
+        return result;
+    }
+};
+
+// Fajl mapiran u memoriju (samo za citanje): zapis se koristi direktno, bez ucitavanja u bafer
+struct MappedFile {
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return;
+        struct stat info;
+        if(fstat(fd, &info) == 0) {
+            size = std::size_t(info.st_size);
+            void* p = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+            if(size == 0)
+                data = "";
+            else if(p != MAP_FAILED)
+                data = static_cast<const char*>(p);
+            else
+                size = 0;
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if(size > 0)
+            munmap(const_cast<char*>(data), size);
+    }
+
+    bool isOpen() const { return data != nullptr; }
+    std::string_view text() const { return {data, size}; }
+};
+
+#endif //DAG_H
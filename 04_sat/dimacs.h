@@ -0,0 +1,137 @@
+#ifndef DIMACS_H
+#define DIMACS_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Odrediste za klauze koje generise neki koder (Tseitin, brojac, ...)
+// Koder ne mora da zna da li se klauze cuvaju u memoriji, upisuju u fajl ili samo broje,
+// pa ne mora ni da cuva celu formulu pre ispisa
+struct ClauseSink {
+    int atomCount = 0;
+    std::size_t clauseCount = 0;
+
+    virtual ~ClauseSink() = default;
+
+    void add(const int* literals, std::size_t size) {
+        for(std::size_t i = 0; i < size; i++)
+            atomCount = std::max(atomCount, std::abs(literals[i]));
+        clauseCount++;
+        write(literals, size);
+    }
+    void add(std::initializer_list<int> clause) { add(clause.begin(), clause.size()); }
+    void add(const std::vector<int>& clause) { add(clause.data(), clause.size()); }
+
+protected:
+    virtual void write(const int* literals, std::size_t size) = 0;
+};
+
+// Samo broji promenljive i klauze, npr. za prvi prolaz pre ispisa zaglavlja
+struct CountingSink : ClauseSink {
+protected:
+    void write(const int*, std::size_t) override {}
+};
+
+// Cuva klauze u memoriji, u obliku koji SAT resavac ocekuje
+struct NormalFormSink : ClauseSink {
+    std::vector<std::vector<int>>& cnf;
+
+    explicit NormalFormSink(std::vector<std::vector<int>>& cnf) : cnf(cnf) {}
+
+protected:
+    void write(const int* literals, std::size_t size) override {
+        cnf.emplace_back(literals, literals + size);
+    }
+};
+
+// Upisuje klauze u DIMACS formatu cim stignu
+// Ako broj promenljivih i klauza nije unapred poznat, na pocetku se ostavlja prazno
+// zaglavlje koje se popunjava u close(). Ako izlaz ne moze da se premotava (npr. standardni
+// izlaz preusmeren u pipe), klauze se upisuju u privremeni fajl (std::tmpfile), pa se u
+// close() ispisuje zaglavlje i za njim sadrzaj tog fajla; memorija tako ne raste sa brojem
+// klauza. Tek ako ni privremeni fajl ne moze da se napravi, klauze se cuvaju u memoriji.
+struct DimacsWriter : ClauseSink {
+    static constexpr std::size_t HeaderWidth = 48;
+    static constexpr std::size_t BufferSize = 1 << 16;
+
+    std::ostream& out;
+    std::streampos header = -1;
+    bool deferred = false;
+    std::FILE* spool = nullptr;
+    std::string buffer;
+
+    explicit DimacsWriter(std::ostream& out) : out(out), header(out.tellp()) {
+        if(header == std::streampos(-1)) {
+            deferred = true;
+            spool = std::tmpfile();
+        }
+        else
+            out << std::string(HeaderWidth, ' ') << '\n';
+    }
+
+    DimacsWriter(std::ostream& out, int atoms, std::size_t clauses) : out(out) {
+        out << "p cnf " << atoms << ' ' << clauses << '\n';
+    }
+
+    DimacsWriter(const DimacsWriter&) = delete;
+    DimacsWriter& operator=(const DimacsWriter&) = delete;
+
+    ~DimacsWriter() override { close(); }
+
+    void close() {
+        if(deferred) {
+            out << "p cnf " << atomCount << ' ' << clauseCount << '\n';
+            deferred = false;
+            if(spool) {
+                flush();
+                std::rewind(spool);
+                buffer.resize(BufferSize);
+                while(std::size_t size = std::fread(buffer.data(), 1, buffer.size(), spool))
+                    out.write(buffer.data(), std::streamsize(size));
+                buffer.clear();
+                std::fclose(spool);
+                spool = nullptr;
+            }
+        }
+        flush();
+        if(header == std::streampos(-1)) {
+            out.flush();
+            return;
+        }
+        std::streampos end = out.tellp();
+        out.seekp(header);
+        out << "p cnf " << atomCount << ' ' << clauseCount;
+        out.seekp(end);
+        out.flush();
+        header = -1;
+    }
+
+protected:
+    void write(const int* literals, std::size_t size) override {
+        char number[16];
+        for(std::size_t i = 0; i < size; i++) {
+            auto [end, error] = std::to_chars(number, number + sizeof(number), literals[i]);
+            buffer.append(number, end);
+            buffer += ' ';
+        }
+        buffer += "0\n";
+        if((!deferred || spool) && buffer.size() >= BufferSize)
+            flush();
+    }
+
+    void flush() {
+        if(spool)
+            std::fwrite(buffer.data(), 1, buffer.size(), spool);
+        else
+            out.write(buffer.data(), (std::streamsize)buffer.size());
+        buffer.clear();
+    }
+};
+
+#endif //DIMACS_H
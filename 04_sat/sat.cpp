@@ -1,162 +1,242 @@
 #include <iostream>
 #include <vector>
-#include <map>
-#include <optional>
 #include <fstream>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <functional>
+#include <filesystem>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+
+#include "sat.h"
+
+using namespace sat;
+
+void printStatistics(const Statistics& stats) {
+    std::cerr << "c decisions " << stats.decisions
+              << " conflicts " << stats.conflicts
+              << " props/s " << (long long)stats.propagationsPerSecond()
+              << " trail " << stats.trailSize
+              << " learned " << stats.learnedClauses
+              << " rss " << stats.residentMB << "MB" << std::endl;
+}
 
-using Atom = int;
-using Literal = int;
-using Clause = std::vector<Literal>;
-using NormalForm = std::vector<Clause>;
-
-struct PartialValuation {
-    int atomCount;
-    std::vector<Literal> stack;
-    std::map<Atom, bool> value;
-
-    Literal backtrack() {
-        Literal last = 0;
-        while(!stack.empty() && stack.back() != 0) {
-            last = stack.back();
-            value.erase(std::abs(last));
-            stack.pop_back();
-        }
-
-        if(stack.empty())
-            return 0;
-
-        stack.pop_back();
-        return last;
-    }
-
-    void push(Literal l, bool decide) {
-        if(decide)
-            stack.push_back(0);
-        stack.push_back(l);
-        value[std::abs(l)] = l > 0;
-    }
-
-    bool isConflict(const Clause& clause) {
-        for(const auto& literal : clause) {
-            Atom atom = std::abs(literal);
-            if(value.find(atom) == value.end())
-                return false;
-            if(value[atom] == (literal > 0))
-                return false;
-        }
-        return true;
+std::string resultName(Result result) {
+    switch(result) {
+        case Sat:     return "SAT";
+        case Unsat:   return "UNSAT";
+        case Unknown: return "UNKNOWN";
     }
+    return "";
+}
 
-    bool hasConflict(const NormalForm& cnf) {
-        for(const auto& clause : cnf)
-            if(isConflict(clause))
-                return true;
-        return false;
-    }
+// Paketno resavanje: svaki fajl iz direktorijuma (ili iz spiska u manifestu)
+// se resava na jednoj od niti, a rezultati se ispisuju kao JSON linije ili CSV
+struct Instance {
+    std::string path;
+    std::uintmax_t size;
+};
 
-    Literal isUnitClause(const Clause& clause) {
-        Literal unit = 0;
-        for(const auto& literal : clause) {
-            Atom atom = std::abs(literal);
-            if(value.find(atom) == value.end()) {
-                if(unit != 0)
-                    return 0;
-                unit = literal;
+std::vector<Instance> collectInstances(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::vector<Instance> instances;
+    std::error_code error;
+    // Velicina koja ne moze da se procita se racuna kao 0: instanca ide na kraj rasporeda,
+    // a greska pri citanju se prijavljuje u njenom redu rezultata
+    auto sizeOf = [](std::uintmax_t size, const std::error_code& error) -> std::uintmax_t {
+        return error ? 0 : size;
+    };
+    if(fs::is_directory(path, error)) {
+        auto options = fs::directory_options::skip_permission_denied;
+        for(fs::recursive_directory_iterator it(path, options, error), end; !error && it != end; it.increment(error)) {
+            std::error_code entryError;
+            if(it->is_regular_file(entryError) && it->path().extension() == ".cnf") {
+                std::uintmax_t size = it->file_size(entryError);
+                instances.push_back({it->path().string(), sizeOf(size, entryError)});
             }
-            else if(value[atom] == (literal > 0))
-                return 0;
         }
-        return unit;
+        if(error)
+            std::cerr << "c cannot list " << path << ": " << error.message() << std::endl;
+    } else {
+        // Manifest sadrzi po jednu putanju u svakom redu, relativno u odnosu na sam manifest
+        std::ifstream manifest(path);
+        fs::path base = fs::path(path).parent_path();
+        std::string line;
+        while(std::getline(manifest, line)) {
+            if(line.empty() || line[0] == '#')
+                continue;
+            fs::path file = fs::path(line).is_absolute() ? fs::path(line) : base / line;
+            std::uintmax_t size = fs::file_size(file, error);
+            instances.push_back({file.string(), sizeOf(size, error)});
+        }
     }
+    // Najvece instance rasporedjujemo prve, da ne bi ostale same na kraju
+    std::stable_sort(begin(instances), end(instances), [](const auto& a, const auto& b) {
+        return a.size > b.size;
+    });
+    return instances;
+}
 
-    Literal unitClause(const NormalForm& cnf) {
-        Literal literal;
-        for(const auto& clause : cnf) {
-            if((literal = isUnitClause(clause)) != 0)
-                return literal;
+std::string jsonString(const std::string& s) {
+    std::string res = "\"";
+    for(char c : s) {
+        if(c == '"' || c == '\\') {
+            res += '\\';
+            res += c;
+        } else if((unsigned char)c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof escaped, "\\u%04x", (unsigned char)c);
+            res += escaped;
+        } else {
+            res += c;
         }
-        return 0;
     }
+    return res + '"';
+}
 
-    Literal nextLiteral() {
-        for(int atom = 1; atom <= atomCount; atom++)
-            if(value.find(atom) == end(value))
-                return atom;
-        return 0;
+std::string csvField(const std::string& s) {
+    if(s.find_first_of(",\"\n") == std::string::npos)
+        return s;
+    std::string res = "\"";
+    for(char c : s) {
+        if(c == '"')
+            res += '"';
+        res += c;
     }
+    return res + '"';
+}
 
-    void print() {
-        for(int i = 0; i < stack.size(); i++)
-            if(stack[i] == 0)
-                std::cout << "| ";
+void batch(const std::string& path, unsigned threadCount, bool json, const Limits& limits, std::ostream& out) {
+    std::vector<Instance> instances = collectInstances(path);
+    std::atomic<std::size_t> next{0};
+    std::mutex outMutex;
+
+    if(!json)
+        out << "file,result,seconds,atoms,clauses,decisions,conflicts,propagations" << std::endl;
+
+    auto worker = [&]() {
+        // Resavac i bafer formule su vezani za nit i koriste se za sve njene instance
+        Solver solver;
+        solver.limits = limits;
+        NormalForm cnf;
+        std::ostringstream line;
+
+        std::size_t i;
+        while(!interrupted && (i = next++) < instances.size()) {
+            std::ifstream input(instances[i].path);
+            int atomCount = 0;
+            bool parsed = parse(input, atomCount, cnf);
+            std::string result = "ERROR";
+            if(parsed)
+                result = resultName(solver.solve(cnf, atomCount));
             else
-                std::cout << stack[i] << ' ';
-        std::cout << std::endl;
-    }
-};
+                solver.stats = Statistics{};
+            const Statistics& stats = solver.stats;
+
+            line.str("");
+            if(json)
+                line << "{\"file\": " << jsonString(instances[i].path)
+                     << ", \"result\": \"" << result << '"'
+                     << ", \"seconds\": " << stats.seconds
+                     << ", \"atoms\": " << atomCount
+                     << ", \"clauses\": " << (parsed ? cnf.size() : 0)
+                     << ", \"decisions\": " << stats.decisions
+                     << ", \"conflicts\": " << stats.conflicts
+                     << ", \"propagations\": " << stats.propagations << "}";
+            else
+                line << csvField(instances[i].path) << ',' << result << ',' << stats.seconds << ','
+                     << atomCount << ',' << (parsed ? cnf.size() : 0) << ',' << stats.decisions << ','
+                     << stats.conflicts << ',' << stats.propagations;
 
-std::optional<PartialValuation> solve(NormalForm& cnf, int atomCount) {
-    PartialValuation valuation;
-    valuation.atomCount = atomCount;
-
-    Literal l;
-    while(true) {
-        valuation.print();
-        if(valuation.hasConflict(cnf)) {
-            l = valuation.backtrack();
-            if(l == 0)
-                break;
-            valuation.push(-l, false);
-        } else if((l = valuation.unitClause(cnf)) != 0) {
-            valuation.push(l, false);
-        } else if((l = valuation.nextLiteral()) != 0) {
-            valuation.push(l, true);
-        } else {
-            return valuation;
+            std::lock_guard<std::mutex> lock(outMutex);
+            out << line.str() << std::endl;
         }
-    }
-    return {};
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < threadCount; t++)
+        threads.emplace_back(worker);
+    for(auto& thread : threads)
+        thread.join();
 }
 
-NormalForm parse(std::istream& input, int& atomCount) {
-    std::string buffer;
-    do {
-        input >> buffer;
-        if(buffer == "c")
-            input.ignore(1000, '\n');
-    } while(buffer != "p");
-    // procitaj "cnf"
-    input >> buffer;
-
-    int clauseCount;
-    input >> atomCount >> clauseCount;
-
-    NormalForm res;
-    for(int i = 0; i < clauseCount; i++) {
-        Clause clause;
-        Literal literal;
-        input >> literal;
-        while(literal != 0) {
-            clause.push_back(literal);
-            input >> literal;
-        }
-        res.push_back(clause);
-    }
-    return res;
+void onSignal(int) {
+    interrupted = true;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     std::string filename = "/Users/idrecun/matf/ar/sat/formula.cnf";
+    std::string batchPath, outputPath;
+    unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+    bool json = true;
+    Solver solver;
+    solver.report = printStatistics;
+
+    // Neispravan broj (npr. "--threads x") prekida ucitavanje opcija porukom o upotrebi
+    try {
+        for(int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if(arg == "--time" && i + 1 < argc)
+                solver.limits.seconds = std::stod(argv[++i]);
+            else if(arg == "--conflicts" && i + 1 < argc)
+                solver.limits.conflicts = std::stoll(argv[++i]);
+            else if(arg == "--propagations" && i + 1 < argc)
+                solver.limits.propagations = std::stoll(argv[++i]);
+            else if(arg == "--memory" && i + 1 < argc)
+                solver.limits.memoryMB = std::stoull(argv[++i]);
+            else if(arg == "--trace")
+                solver.trace = true;
+            else if(arg == "--batch" && i + 1 < argc)
+                batchPath = argv[++i];
+            else if(arg == "--threads" && i + 1 < argc)
+                threadCount = std::max(1, std::stoi(argv[++i]));
+            else if(arg == "--csv")
+                json = false;
+            else if(arg == "--output" && i + 1 < argc)
+                outputPath = argv[++i];
+            else
+                filename = arg;
+        }
+    } catch(const std::logic_error&) {
+        std::cerr << "Usage: sat [--time s] [--conflicts n] [--propagations n] [--memory MB] [--trace]\n"
+                     "           [--batch path] [--threads n] [--csv] [--output file] [file.cnf]" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, onSignal);
+
+    if(!batchPath.empty()) {
+        if(outputPath.empty()) {
+            batch(batchPath, threadCount, json, solver.limits, std::cout);
+        } else {
+            std::ofstream output(outputPath);
+            batch(batchPath, threadCount, json, solver.limits, output);
+        }
+        return 0;
+    }
+
     std::ifstream inputFile(filename);
 
     int atomCount;
-    auto formula = parse(inputFile, atomCount);
-    auto valuation = solve(formula, atomCount);
-    if(valuation.has_value()) {
+    NormalForm formula;
+    if(!parse(inputFile, atomCount, formula)) {
+        std::cerr << "Cannot read " << filename << std::endl;
+        return 1;
+    }
+    Result result = solver.solve(formula, atomCount);
+    printStatistics(solver.stats);
+    if(result == Sat) {
         std::cout << "SAT" << std::endl;
-        valuation.value().print();
-    } else {
+        solver.valuation.print();
+    } else if(result == Unsat) {
         std::cout << "UNSAT" << std::endl;
+    } else {
+        std::cout << "UNKNOWN" << std::endl;
     }
     return 0;
 }
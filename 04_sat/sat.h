@@ -0,0 +1,288 @@
+#ifndef SAT_H
+#define SAT_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// DPLL resavac; u posebnom prostoru imena da se tipovi Atom, Literal, Clause i NormalForm
+// ne bi sukobili sa istoimenim tipovima za formule kada se koristi zajedno sa njima
+namespace sat {
+
+using Atom = int;
+using Literal = int;
+using Clause = std::vector<Literal>;
+using NormalForm = std::vector<Clause>;
+
+struct PartialValuation {
+    int atomCount;
+    std::vector<Literal> stack;
+    // 0 - nije dodeljena vrednost, 1 - tacno, -1 - netacno
+    std::vector<signed char> value;
+
+    void reset(int count) {
+        atomCount = count;
+        stack.clear();
+        value.assign(count + 1, 0);
+    }
+
+    Literal backtrack() {
+        Literal last = 0;
+        while(!stack.empty() && stack.back() != 0) {
+            last = stack.back();
+            value[std::abs(last)] = 0;
+            stack.pop_back();
+        }
+
+        if(stack.empty())
+            return 0;
+
+        stack.pop_back();
+        return last;
+    }
+
+    void push(Literal l, bool decide) {
+        if(decide)
+            stack.push_back(0);
+        stack.push_back(l);
+        value[std::abs(l)] = l > 0 ? 1 : -1;
+    }
+
+    bool isConflict(const Clause& clause) {
+        for(const auto& literal : clause) {
+            Atom atom = std::abs(literal);
+            if(value[atom] == 0)
+                return false;
+            if((value[atom] > 0) == (literal > 0))
+                return false;
+        }
+        return true;
+    }
+
+    bool hasConflict(const NormalForm& cnf) {
+        for(const auto& clause : cnf)
+            if(isConflict(clause))
+                return true;
+        return false;
+    }
+
+    Literal isUnitClause(const Clause& clause) {
+        Literal unit = 0;
+        for(const auto& literal : clause) {
+            Atom atom = std::abs(literal);
+            if(value[atom] == 0) {
+                if(unit != 0)
+                    return 0;
+                unit = literal;
+            }
+            else if((value[atom] > 0) == (literal > 0))
+                return 0;
+        }
+        return unit;
+    }
+
+    Literal unitClause(const NormalForm& cnf) {
+        Literal literal;
+        for(const auto& clause : cnf) {
+            if((literal = isUnitClause(clause)) != 0)
+                return literal;
+        }
+        return 0;
+    }
+
+    Literal nextLiteral() {
+        for(int atom = 1; atom <= atomCount; atom++)
+            if(value[atom] == 0)
+                return atom;
+        return 0;
+    }
+
+    void print() {
+        for(std::size_t i = 0; i < stack.size(); i++)
+            if(stack[i] == 0)
+                std::cout << "| ";
+            else
+                std::cout << stack[i] << ' ';
+        std::cout << std::endl;
+    }
+};
+
+// Ogranicenja resavaca, vrednost 0 znaci da ogranicenje ne postoji
+struct Limits {
+    double seconds = 0;
+    long long conflicts = 0;
+    long long propagations = 0;
+    std::size_t memoryMB = 0;
+};
+
+struct Statistics {
+    long long decisions = 0;
+    long long conflicts = 0;
+    long long propagations = 0;
+    double seconds = 0;
+    std::size_t trailSize = 0;
+    // DPLL ne uci klauze, ali brojac ostavljamo zbog formata izvestaja
+    std::size_t learnedClauses = 0;
+    std::size_t residentMB = 0;
+
+    double propagationsPerSecond() const {
+        return seconds > 0 ? propagations / seconds : 0;
+    }
+};
+
+enum Result { Sat, Unsat, Unknown };
+
+// Prekid iz druge niti ili iz obradjivaca signala, proverava se u svakom koraku pretrage
+inline std::atomic<bool> interrupted{false};
+
+inline std::size_t residentMemory() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    std::size_t pages = 0, resident = 0;
+    if(statm >> pages >> resident)
+        return resident * sysconf(_SC_PAGESIZE);
+    return 0;
+#else
+    // Na ostalim sistemima imamo samo maksimalnu zauzetu memoriju (u bajtovima na macOS-u)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+struct Solver {
+    Limits limits;
+    std::function<void(const Statistics&)> report;
+    double reportInterval = 1.0;
+    bool trace = false;
+
+    Statistics stats;
+    PartialValuation valuation;
+
+    Result solve(NormalForm& cnf, int atomCount) {
+        using Clock = std::chrono::steady_clock;
+        auto start = Clock::now();
+        double lastReport = 0;
+
+        stats = Statistics{};
+        valuation.reset(atomCount);
+
+        Literal l;
+        for(long long step = 0; ; step++) {
+            if(trace)
+                valuation.print();
+            if(interrupted.load(std::memory_order_relaxed) || limitReached())
+                return finish(start, Unknown);
+            // Sat i memoriju proveravamo redje jer su te provere skuplje od brojaca
+            if(step % 1024 == 0) {
+                updateTime(start);
+                if(limits.seconds > 0 && stats.seconds >= limits.seconds)
+                    return finish(start, Unknown);
+                if(limits.memoryMB > 0 || report) {
+                    stats.residentMB = residentMemory() >> 20;
+                    if(limits.memoryMB > 0 && stats.residentMB >= limits.memoryMB)
+                        return finish(start, Unknown);
+                }
+                if(report && stats.seconds - lastReport >= reportInterval) {
+                    lastReport = stats.seconds;
+                    report(stats);
+                }
+            }
+
+            if(valuation.hasConflict(cnf)) {
+                stats.conflicts++;
+                l = valuation.backtrack();
+                if(l == 0)
+                    return finish(start, Unsat);
+                valuation.push(-l, false);
+            } else if((l = valuation.unitClause(cnf)) != 0) {
+                stats.propagations++;
+                valuation.push(l, false);
+            } else if((l = valuation.nextLiteral()) != 0) {
+                stats.decisions++;
+                valuation.push(l, true);
+            } else {
+                return finish(start, Sat);
+            }
+        }
+    }
+
+private:
+    bool limitReached() const {
+        return (limits.conflicts > 0 && stats.conflicts >= limits.conflicts) ||
+               (limits.propagations > 0 && stats.propagations >= limits.propagations);
+    }
+
+    void updateTime(std::chrono::steady_clock::time_point start) {
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.trailSize = valuation.stack.size();
+    }
+
+    Result finish(std::chrono::steady_clock::time_point start, Result result) {
+        updateTime(start);
+        stats.residentMB = residentMemory() >> 20;
+        return result;
+    }
+};
+
+// Ucitava formulu u postojeci bafer kako bi se memorija klauza ponovo koristila. Broju klauza
+// iz zaglavlja se ne veruje unapred (npr. "p cnf 3 2000000000"): niz klauza raste kako se
+// klauze citaju, a fajl mora imati tacno toliko klauza (posle njih su dozvoljeni samo
+// komentari i oznaka kraja "%" iz SATLIB fajlova)
+inline bool parse(std::istream& input, int& atomCount, NormalForm& res) {
+    std::string buffer;
+    do {
+        input >> buffer;
+        if(buffer == "c")
+            input.ignore(1000, '\n');
+    } while(input && buffer != "p");
+    // procitaj "cnf"
+    input >> buffer;
+
+    int clauseCount = 0;
+    input >> atomCount >> clauseCount;
+    if(!input || atomCount < 0 || clauseCount < 0)
+        return false;
+
+    res.reserve(std::min(clauseCount, 1 << 16));
+    for(int i = 0; i < clauseCount; i++) {
+        if(std::size_t(i) == res.size())
+            res.emplace_back();
+        Clause& clause = res[i];
+        clause.clear();
+        Literal literal;
+        input >> literal;
+        while(input && literal != 0) {
+            // Valuacija ima mesta samo za atome iz zaglavlja
+            if(literal < -atomCount || literal > atomCount)
+                return false;
+            clause.push_back(literal);
+            input >> literal;
+        }
+        if(!input)
+            return false;
+    }
+    res.resize(clauseCount);
+
+    while(input >> buffer) {
+        if(buffer == "%")
+            break;
+        if(buffer != "c")
+            return false;
+        input.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return true;
+}
+
+} // namespace sat
+
+#endif //SAT_H
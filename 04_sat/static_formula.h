@@ -0,0 +1,326 @@
+#ifndef STATIC_FORMULA_H
+#define STATIC_FORMULA_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dimacs.h"
+
+// Formule cija je struktura poznata u vreme prevodjenja (npr. ogranicenja u 05_minisat/brojac.cpp).
+// Formula je vrednost: niz cvorova u postfiksnom redosledu (deca pre roditelja, koren poslednji),
+// pa se NNF i KNF racunaju constexpr funkcijama tokom prevodjenja, a evaluacija i ispis klauza
+// se razvijaju u niz naredbi bez grananja po vrsti cvora i bez alokacije.
+// Atomi su mesta 0, 1, 2, ... koja se vezuju za prave promenljive tek pri upotrebi.
+// Veznici i oblik NNF su isti kao za Formula (tseitin.cpp, gde je i prevodjenje u Formula).
+
+enum class StaticOp : std::uint8_t { False, True, Atom, Not, And, Or, Impl, Eq };
+
+// Za Atom je a mesto, za Not je a indeks deteta, a za binarne veznike a i b
+struct StaticNode {
+    StaticOp op;
+    int a = 0, b = 0;
+};
+
+template<std::size_t N>
+struct StaticFormula {
+    StaticNode nodes[N];
+    static constexpr std::size_t size = N;
+};
+
+constexpr StaticFormula<1> slot(int i) { return {{{StaticOp::Atom, i}}}; }
+constexpr StaticFormula<1> staticFalse = {{{StaticOp::False}}};
+constexpr StaticFormula<1> staticTrue = {{{StaticOp::True}}};
+
+// Nadovezuje cvorove potformula i pomera indekse dece u desnoj
+template<std::size_t L, std::size_t R>
+constexpr StaticFormula<L + R + 1> staticBinary(StaticOp op, const StaticFormula<L>& l, const StaticFormula<R>& r) {
+    StaticFormula<L + R + 1> f{};
+    std::copy(l.nodes, l.nodes + L, f.nodes);
+    for(std::size_t i = 0; i < R; i++) {
+        StaticNode n = r.nodes[i];
+        if(n.op >= StaticOp::Not)
+            n.a += int(L);
+        if(n.op >= StaticOp::And)
+            n.b += int(L);
+        f.nodes[L + i] = n;
+    }
+    f.nodes[L + R] = {op, int(L - 1), int(L + R - 1)};
+    return f;
+}
+
+template<std::size_t N>
+constexpr StaticFormula<N + 1> operator~(const StaticFormula<N>& f) {
+    StaticFormula<N + 1> result{};
+    std::copy(f.nodes, f.nodes + N, result.nodes);
+    result.nodes[N] = {StaticOp::Not, int(N - 1)};
+    return result;
+}
+
+template<std::size_t L, std::size_t R>
+constexpr auto operator&(const StaticFormula<L>& l, const StaticFormula<R>& r) { return staticBinary(StaticOp::And, l, r); }
+template<std::size_t L, std::size_t R>
+constexpr auto operator|(const StaticFormula<L>& l, const StaticFormula<R>& r) { return staticBinary(StaticOp::Or, l, r); }
+template<std::size_t L, std::size_t R>
+constexpr auto impl(const StaticFormula<L>& l, const StaticFormula<R>& r) { return staticBinary(StaticOp::Impl, l, r); }
+template<std::size_t L, std::size_t R>
+constexpr auto eq(const StaticFormula<L>& l, const StaticFormula<R>& r) { return staticBinary(StaticOp::Eq, l, r); }
+
+// Broj mesta (najvece mesto + 1)
+constexpr int slotCount(std::span<const StaticNode> f) {
+    int count = 0;
+    for(const StaticNode& n : f)
+        if(n.op == StaticOp::Atom)
+            count = std::max(count, n.a + 1);
+    return count;
+}
+
+// Evaluacija obilaskom niza; values[i] je vrednost mesta i. Koristi se za formule poznate
+// tek u vreme izvrsavanja (fromFormula) i za provere tokom prevodjenja
+template<typename Values>
+constexpr bool evaluate(std::span<const StaticNode> f, const Values& values) {
+    std::vector<bool> r(f.size());
+    for(std::size_t i = 0; i < f.size(); i++) {
+        const StaticNode& n = f[i];
+        switch(n.op) {
+            case StaticOp::False: r[i] = false; break;
+            case StaticOp::True:  r[i] = true; break;
+            case StaticOp::Atom:  r[i] = values[n.a]; break;
+            case StaticOp::Not:   r[i] = !r[n.a]; break;
+            case StaticOp::And:   r[i] = r[n.a] && r[n.b]; break;
+            case StaticOp::Or:    r[i] = r[n.a] || r[n.b]; break;
+            case StaticOp::Impl:  r[i] = !r[n.a] || r[n.b]; break;
+            case StaticOp::Eq:    r[i] = r[n.a] == r[n.b]; break;
+        }
+    }
+    return r.back();
+}
+
+template<StaticNode N, typename Values>
+constexpr bool evaluateNode(const bool* r, const Values& values) {
+    if constexpr(N.op == StaticOp::False)
+        return false;
+    else if constexpr(N.op == StaticOp::True)
+        return true;
+    else if constexpr(N.op == StaticOp::Atom)
+        return values[N.a];
+    else if constexpr(N.op == StaticOp::Not)
+        return !r[N.a];
+    else if constexpr(N.op == StaticOp::And)
+        return r[N.a] && r[N.b];
+    else if constexpr(N.op == StaticOp::Or)
+        return r[N.a] || r[N.b];
+    else if constexpr(N.op == StaticOp::Impl)
+        return !r[N.a] || r[N.b];
+    else
+        return r[N.a] == r[N.b];
+}
+
+// Evaluacija formule poznate u vreme prevodjenja: za svaki cvor po jedna naredba
+template<auto F, typename Values>
+constexpr bool evaluate(const Values& values) {
+    bool r[F.size] = {};
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        ((r[I] = evaluateNode<F.nodes[I]>(r, values)), ...);
+    }(std::make_index_sequence<F.size>{});
+    return r[F.size - 1];
+}
+
+// NNF kao nnf(f, negated) u tseitin.cpp; potformula ekvivalencije se prevodi za oba polariteta
+constexpr int nnfNode(std::span<const StaticNode> f, int i, bool neg, std::vector<StaticNode>& out) {
+    auto add = [&](StaticNode n) {
+        out.push_back(n);
+        return int(out.size() - 1);
+    };
+    const StaticNode& n = f[i];
+    switch(n.op) {
+        case StaticOp::False:
+            return add({neg ? StaticOp::True : StaticOp::False});
+        case StaticOp::True:
+            return add({neg ? StaticOp::False : StaticOp::True});
+        case StaticOp::Atom: {
+            int atom = add(n);
+            return neg ? add({StaticOp::Not, atom}) : atom;
+        }
+        case StaticOp::Not:
+            return nnfNode(f, n.a, !neg, out);
+        case StaticOp::And:
+        case StaticOp::Or: {
+            int l = nnfNode(f, n.a, neg, out);
+            int r = nnfNode(f, n.b, neg, out);
+            return add({(n.op == StaticOp::And) != neg ? StaticOp::And : StaticOp::Or, l, r});
+        }
+        case StaticOp::Impl: {
+            int l = nnfNode(f, n.a, !neg, out);
+            int r = nnfNode(f, n.b, neg, out);
+            return add({neg ? StaticOp::And : StaticOp::Or, l, r});
+        }
+        case StaticOp::Eq: {
+            // (~A | B) & (A | ~B), odnosno (A & ~B) | (~A & B) pod negacijom
+            StaticOp inner = neg ? StaticOp::And : StaticOp::Or;
+            int l0 = nnfNode(f, n.a, !neg, out);
+            int r0 = nnfNode(f, n.b, neg, out);
+            int first = add({inner, l0, r0});
+            int l1 = nnfNode(f, n.a, neg, out);
+            int r1 = nnfNode(f, n.b, !neg, out);
+            int second = add({inner, l1, r1});
+            return add({neg ? StaticOp::Or : StaticOp::And, first, second});
+        }
+    }
+    return -1;
+}
+
+template<auto F>
+constexpr std::vector<StaticNode> nnfNodes() {
+    std::vector<StaticNode> out;
+    nnfNode(F.nodes, int(F.size - 1), false, out);
+    return out;
+}
+
+// NNF formule F, izracunata tokom prevodjenja
+template<auto F>
+constexpr auto staticNnf = [] {
+    StaticFormula<nnfNodes<F>().size()> result{};
+    std::vector<StaticNode> nodes = nnfNodes<F>();
+    std::copy(nodes.begin(), nodes.end(), result.nodes);
+    return result;
+}();
+
+// KNF: literal mesta i je i + 1, odnosno -(i + 1), kao u DIMACS formatu.
+// Klauze su sredjene kao u cnf iz 03: literali sortirani i bez ponavljanja, bez tautologija
+// i bez ponovljenih klauza
+template<std::size_t L, std::size_t C>
+struct StaticCnf {
+    std::array<int, L> literals;
+    std::array<std::size_t, C + 1> starts;
+    static constexpr std::size_t clauseCount = C;
+};
+
+using StaticClauses = std::vector<std::vector<int>>;
+
+// Sortira literale i uklanja ponavljanja; vraca false za tautologiju
+constexpr bool normalizeClause(std::vector<int>& clause) {
+    auto less = [](int x, int y) { return std::abs(x) != std::abs(y) ? std::abs(x) < std::abs(y) : x < y; };
+    std::sort(clause.begin(), clause.end(), less);
+    clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+    for(std::size_t i = 1; i < clause.size(); i++)
+        if(clause[i] == -clause[i - 1])
+            return false;
+    return true;
+}
+
+constexpr StaticClauses cnfClauses(std::span<const StaticNode> f) {
+    std::vector<StaticClauses> sets(f.size());
+    for(std::size_t i = 0; i < f.size(); i++) {
+        const StaticNode& n = f[i];
+        switch(n.op) {
+            case StaticOp::False: sets[i] = {{}}; break;
+            case StaticOp::True: break;
+            case StaticOp::Atom: sets[i] = {{n.a + 1}}; break;
+            case StaticOp::Not: sets[i] = {{-(f[n.a].a + 1)}}; break;
+            case StaticOp::And:
+                sets[i] = sets[n.a];
+                sets[i].insert(sets[i].end(), sets[n.b].begin(), sets[n.b].end());
+                break;
+            case StaticOp::Or:
+                for(const auto& l : sets[n.a])
+                    for(const auto& r : sets[n.b]) {
+                        std::vector<int> clause = l;
+                        clause.insert(clause.end(), r.begin(), r.end());
+                        if(normalizeClause(clause))
+                            sets[i].push_back(clause);
+                    }
+                break;
+            default: break;
+        }
+    }
+    StaticClauses result = sets.back();
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+template<auto F>
+constexpr std::size_t cnfLiteralCount() {
+    std::size_t count = 0;
+    for(const auto& clause : cnfClauses(staticNnf<F>.nodes))
+        count += clause.size();
+    return count;
+}
+
+// KNF formule F, izracunata tokom prevodjenja
+template<auto F>
+constexpr auto staticCnf = [] {
+    StaticClauses clauses = cnfClauses(staticNnf<F>.nodes);
+    StaticCnf<cnfLiteralCount<F>(), cnfClauses(staticNnf<F>.nodes).size()> result{};
+    std::size_t k = 0;
+    for(std::size_t i = 0; i < clauses.size(); i++) {
+        result.starts[i] = k;
+        for(int literal : clauses[i])
+            result.literals[k++] = literal;
+    }
+    result.starts[clauses.size()] = k;
+    return result;
+}();
+
+template<std::size_t L, std::size_t C, typename Values>
+constexpr bool evaluate(const StaticCnf<L, C>& cnf, const Values& values) {
+    for(std::size_t i = 0; i < C; i++) {
+        bool satisfied = false;
+        for(std::size_t k = cnf.starts[i]; k < cnf.starts[i + 1]; k++) {
+            int literal = cnf.literals[k];
+            satisfied |= literal > 0 ? bool(values[literal - 1]) : !values[-literal - 1];
+        }
+        if(!satisfied)
+            return false;
+    }
+    return true;
+}
+
+// Da li F, njena NNF i KNF imaju istu vrednost za sve valuacije mesta (za static_assert)
+template<auto F>
+constexpr bool staticNormalFormsAgree() {
+    int slots = slotCount(F.nodes);
+    std::vector<bool> values(std::size_t(slots), false);
+    for(std::uint64_t m = 0; m < (std::uint64_t(1) << slots); m++) {
+        for(int i = 0; i < slots; i++)
+            values[std::size_t(i)] = (m >> i) & 1;
+        bool value = evaluate(F.nodes, values);
+        if(evaluate(staticNnf<F>.nodes, values) != value || evaluate(staticCnf<F>, values) != value)
+            return false;
+    }
+    return true;
+}
+
+template<auto F, std::size_t C>
+void addClause(ClauseSink& sink, std::span<const int> atoms) {
+    constexpr const auto& cnf = staticCnf<F>;
+    constexpr std::size_t start = cnf.starts[C];
+    [&]<std::size_t... K>(std::index_sequence<K...>) {
+        std::array<int, sizeof...(K)> clause = {(cnf.literals[start + K] > 0 ? atoms[cnf.literals[start + K] - 1]
+                                                                            : -atoms[-cnf.literals[start + K] - 1])...};
+        sink.add(clause.data(), clause.size());
+    }(std::make_index_sequence<cnf.starts[C + 1] - start>{});
+}
+
+// Dodaje klauze KNF formule F tako da mesto i postaje promenljiva atoms[i]:
+// za svaku klauzu po jedan poziv add sa literalima poznatim tokom prevodjenja
+template<auto F>
+void addClauses(ClauseSink& sink, std::span<const int> atoms) {
+    [&]<std::size_t... C>(std::index_sequence<C...>) {
+        (addClause<F, C>(sink, atoms), ...);
+    }(std::make_index_sequence<staticCnf<F>.clauseCount>{});
+}
+
+template<auto F>
+void addClauses(ClauseSink& sink, std::initializer_list<int> atoms) {
+    addClauses<F>(sink, std::span<const int>(atoms.begin(), atoms.size()));
+}
+
+#endif //STATIC_FORMULA_H
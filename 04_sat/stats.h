@@ -0,0 +1,118 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Merenje faza obrade formula (simplify, nnf, cnf, tseitin, resavanje, ...): za svaku fazu
+// vreme, broj obidjenih i napravljenih cvorova, najveci broj zivih cvorova tokom faze,
+// velicina rezultata i broj klauza i promenljivih. Izvestaj se ispisuje kao JSON, pa se
+// rezultati razlicitih verzija mogu porediti.
+// Merenje se ukljucuje sa FORMULA_STATS (opcija u CMakeLists.txt); bez toga se makroi ne
+// prevode u nista, pa brojaci u obilascima i pravljenju cvorova ne kostaju nista.
+// Brojaci nisu atomicni: pretpostavlja se da se formule obradjuju u jednoj niti.
+// Zivi cvorovi su cvorovi formula u areni; cvorovi AIG-a se broje samo kao napravljeni.
+
+struct StatsCounters {
+    std::uint64_t visited = 0;
+    std::uint64_t allocated = 0;
+    std::uint64_t live = 0;
+    std::uint64_t peakLive = 0;
+};
+
+StatsCounters& statsCounters() {
+    static StatsCounters counters;
+    return counters;
+}
+
+struct StageStats {
+    std::string name;
+    double seconds = 0;
+    std::uint64_t visited = 0;
+    std::uint64_t allocated = 0;
+    std::uint64_t peakLive = 0;
+    std::uint64_t outputNodes = 0;
+    std::uint64_t clauses = 0;
+    std::uint64_t variables = 0;
+};
+
+constexpr int StatsFormatVersion = 1;
+
+struct StatsReport {
+    std::vector<StageStats> stages;
+
+    void json(std::ostream& out) const {
+        out << "{\"format\": " << StatsFormatVersion << ", \"stages\": [";
+        for(std::size_t i = 0; i < stages.size(); i++) {
+            const StageStats& s = stages[i];
+            out << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << s.name << "\", \"seconds\": " << s.seconds
+                << ", \"visited\": " << s.visited << ", \"allocated\": " << s.allocated
+                << ", \"peak_live\": " << s.peakLive << ", \"output_nodes\": " << s.outputNodes
+                << ", \"clauses\": " << s.clauses << ", \"variables\": " << s.variables << "}";
+        }
+        out << (stages.empty() ? "" : "\n") << "]}" << std::endl;
+    }
+};
+
+// Faza traje od konstrukcije do stop() ili destrukcije; velicina rezultata se upisuje posle
+// stop(), pa ni njeno racunanje (npr. obilazak rezultata) ne ulazi u fazu. Faze mogu biti ugnjezdene
+struct ScopedStage {
+    using Clock = std::chrono::steady_clock;
+
+    StatsReport& report;
+    StageStats stats;
+    StatsCounters start;
+    Clock::time_point startTime;
+    bool stopped = false;
+
+    ScopedStage(StatsReport& report, std::string name) : report(report), start(statsCounters()), startTime(Clock::now()) {
+        stats.name = std::move(name);
+        statsCounters().peakLive = statsCounters().live;
+    }
+
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+
+    void stop() {
+        if(stopped)
+            return;
+        stopped = true;
+        StatsCounters& now = statsCounters();
+        stats.seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+        stats.visited = now.visited - start.visited;
+        stats.allocated = now.allocated - start.allocated;
+        stats.peakLive = now.peakLive;
+        now.peakLive = std::max(now.peakLive, start.peakLive);
+    }
+
+    ~ScopedStage() {
+        stop();
+        report.stages.push_back(std::move(stats));
+    }
+};
+
+#ifdef FORMULA_STATS
+#define STATS_ADD(field, n) (statsCounters().field += (n))
+#define STATS_ALLOCATE()                                                                  \
+    do {                                                                                  \
+        StatsCounters& statsNow_ = statsCounters();                                       \
+        statsNow_.allocated++;                                                            \
+        statsNow_.peakLive = std::max(statsNow_.peakLive, ++statsNow_.live);              \
+    } while(false)
+#define STATS_RELEASE() (statsCounters().live--)
+#define STATS_STAGE(report, name) ScopedStage statsStage_(report, name)
+#define STATS_OUTPUT(field, value) (statsStage_.stop(), statsStage_.stats.field = (value))
+#else
+#define STATS_ADD(field, n) ((void)0)
+#define STATS_ALLOCATE() ((void)0)
+#define STATS_RELEASE() ((void)0)
+#define STATS_STAGE(report, name) ((void)0)
+#define STATS_OUTPUT(field, value) ((void)0)
+#endif
+
+#endif //STATS_H
@@ -2,9 +2,30 @@
 #include <variant>
 #include <optional>
 #include <memory>
+#include <utility>
 #include <vector>
 #include <map>
 #include <set>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include "dimacs.h"
+#include "sat.h"
+#include "dag.h"
+#include "aig.h"
+#include "stats.h"
+#include "static_formula.h"
 
 // Structures for defining a Formula
 struct False;
@@ -19,19 +40,388 @@ using FormulaPtr = std::shared_ptr<Formula>;
 struct False {};
 struct True {};
 struct Atom { std::string name; };
-struct Not { FormulaPtr subformula; };
+struct Not {
+    FormulaPtr subformula;
+    ~Not();
+};
 struct Binary {
     enum Type { And, Or, Impl, Eq } type;
     FormulaPtr left, right;
+    ~Binary();
+};
+
+// Grananje po vrsti cvora: match(f, lambde...) poziva lambdu za alternativu koju cvor sadrzi,
+// i to po referenci, bez kopiranja. std::visit bira lambdu jednim skokom po indeksu alternative
+// umesto niza provera is<T>, a lambda sa auto parametrom pokriva sve preostale vrste.
+template<typename... Cases>
+struct Overloaded : Cases... { using Cases::operator()...; };
+
+template<typename... Cases>
+decltype(auto) match(const Formula& f, Cases... cases) { return std::visit(Overloaded{cases...}, f); }
+
+template<typename... Cases>
+decltype(auto) match(const FormulaPtr& f, Cases... cases) { return std::visit(Overloaded{cases...}, *f); }
+
+// Jedinstvena tabela (hash-consing): cvor se pravi samo ako strukturno jednak cvor
+// vec ne postoji, pa su jednake formule uvek isti pokazivac. Cvor odredjuju vrsta cvora
+// i pokazivaci na potformule (koje su i same jedinstvene), odnosno ime atoma.
+std::size_t mixHash(std::size_t h) {
+    h *= 0x9E3779B97F4A7C15;
+    return h ^ (h >> 29);
+}
+
+// Hes cvora ~sub, odnosno (left type right), samo od pokazivaca na potformule
+// 0 oznacava prazno mesto u tabeli, pa hes nikad nije 0
+std::size_t notHash(const Formula* sub) {
+    std::size_t h = mixHash(std::size_t(sub) ^ 3);
+    return h ? h : 1;
+}
+
+std::size_t binaryHash(Binary::Type type, const Formula* left, const Formula* right) {
+    std::size_t h = mixHash(mixHash(std::size_t(left) ^ (4 + 8 * type)) ^ std::size_t(right));
+    return h ? h : 1;
+}
+
+std::size_t nodeHash(const Formula& f) {
+    std::size_t h = match(f,
+        [&](const Atom& a) { return mixHash(std::hash<std::string>()(a.name) ^ f.index()); },
+        [&](const Not& n) { return notHash(n.subformula.get()); },
+        [&](const Binary& b) { return binaryHash(b.type, b.left.get(), b.right.get()); },
+        [&](const auto&) { return mixHash(f.index() + 1); });
+    return h ? h : 1;
+}
+
+bool sameNode(const Formula& f, const Formula& g) {
+    if(f.index() != g.index())
+        return false;
+    return match(f,
+        [&](const Atom& a) { return a.name == std::get<Atom>(g).name; },
+        [&](const Not& n) { return n.subformula == std::get<Not>(g).subformula; },
+        [&](const Binary& b) {
+            const Binary& c = std::get<Binary>(g);
+            return b.type == c.type && b.left == c.left && b.right == c.right;
+        },
+        [&](const auto&) { return true; });
+}
+
+// Arena za cvorove formula: memorija se uzima od sistema u velikim blokovima, pa je pravljenje
+// cvora obicno samo pomeranje pokazivaca. Memorija unistenog cvora se vraca u listu slobodnih
+// mesta njegove velicine i koristi za sledeci cvor te velicine, pa arena ne raste dok ne raste
+// broj zivih cvorova. Blokovi se vracaju sistemu odjednom (clear) kada u areni nema zivih cvorova.
+struct NodeArena {
+    static constexpr std::size_t BlockSize = 1 << 16;
+    // Mesta su poravnata na Granule bajtova; mesta do SizeClasses * Granule bajtova se ponovo koriste
+    static constexpr std::size_t Granule = 16;
+    static constexpr std::size_t SizeClasses = 16;
+
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::size_t used = BlockSize;
+    std::size_t allocated = 0;
+    std::atomic<std::size_t> live = 0;
+    // Broj unistenih cvorova; njihova memorija ostaje zauzeta dok postoje slabi pokazivaci na njih
+    std::atomic<std::size_t> destroyed = 0;
+    // Arena iz ArenaScope koji je zavrsen: oslobadja se cim u njoj vise nema zivih cvorova
+    bool retired = false;
+    // Slobodna mesta po velicini. Cvor moze da se unisti u bilo kojoj niti, pa se njegovo mesto
+    // atomicno dodaje u returned; allocate (pod bravom pozivaoca) preuzima celu tu listu odjednom
+    // kada mu ponestane mesta u free, pa mesto iz liste skida samo jedna nit u svakom trenutku.
+    std::array<FreeSlot*, SizeClasses> free{};
+    std::array<std::atomic<FreeSlot*>, SizeClasses> returned{};
+
+    static std::size_t sizeClass(std::size_t size, std::size_t align) {
+        return align <= Granule ? (size + Granule - 1) / Granule - 1 : SizeClasses;
+    }
+
+    void* allocate(std::size_t size, std::size_t align) {
+        allocated++;
+        live++;
+        STATS_ALLOCATE();
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            if(!free[c] && returned[c].load(std::memory_order_relaxed))
+                free[c] = returned[c].exchange(nullptr, std::memory_order_acquire);
+            if(FreeSlot* slot = free[c]) {
+                free[c] = slot->next;
+                return slot;
+            }
+            size = (c + 1) * Granule;
+            align = Granule;
+        }
+        used = (used + align - 1) / align * align;
+        if(used + size > BlockSize) {
+            blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(BlockSize));
+            used = 0;
+        }
+        void* p = blocks.back().get() + used;
+        used += size;
+        return p;
+    }
+
+    void deallocate(void* p, std::size_t size, std::size_t align) {
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            FreeSlot* slot = new(p) FreeSlot{returned[c].load(std::memory_order_relaxed)};
+            while(!returned[c].compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {}
+        }
+        live--;
+        STATS_RELEASE();
+    }
+
+    bool clear() {
+        if(live > 0)
+            return false;
+        blocks.clear();
+        used = BlockSize;
+        free.fill(nullptr);
+        for(auto& list : returned)
+            list.store(nullptr, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+// Arena u koju ova nit smesta nove cvorove (vidi ArenaScope); nullptr je zajednicka arena
+thread_local NodeArena* scopeArena = nullptr;
+
+// Alokator preko kog std::allocate_shared smesta cvor zajedno sa brojacem referenci u arenu
+template<typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    NodeArena* arena;
+
+    explicit ArenaAllocator(NodeArena* arena) : arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, std::size_t n) { arena->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    template<typename U>
+    void destroy(U* p) {
+        p->~U();
+        arena->destroyed++;
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+};
+
+// Tabela cuva slabe pokazivace, pa ne odrzava cvorove u zivotu: kada se formula unisti,
+// njen unos istekne, a istekli unosi se uklanjaju kada se tabela prosiruje. Tabela je niz sa
+// otvorenim adresiranjem (linearno trazenje) koji pamti i hes svakog cvora, pa se pri trazenju
+// ne pravi kljuc, a cvor se cita (zakljucava i poredi) samo kada mu je hes jednak trazenom.
+struct UniqueTable {
+    struct Entry {
+        std::size_t hash = 0;
+        std::weak_ptr<Formula> node;
+    };
+
+    std::mutex mutex;
+    NodeArena arena;
+    // Arene iz ArenaScope, i zavrsene dok u njima jos ima zivih cvorova
+    std::vector<std::unique_ptr<NodeArena>> scopes;
+    std::vector<Entry> entries = std::vector<Entry>(1024);
+    // Zauzeta mesta, ukljucujuci istekle unose
+    std::size_t used = 0;
+    // destroyedNodes() pri poslednjem izbacivanju isteklih unosa
+    std::size_t destroyedAtSweep = 0;
+
+    std::size_t size() const { return used; }
+
+    std::size_t destroyedNodes() const {
+        std::size_t count = arena.destroyed;
+        for(const auto& scope : scopes)
+            count += scope->destroyed;
+        return count;
+    }
+
+    // Not i Binary imaju destruktor, pa nemaju implicitni konstruktor premestanja: std::move bi
+    // ih kopirao, uz atomicne promene brojaca referenci potformula. Cvor se zato pravi od delova
+    // iz f, koji se premestaju.
+    FormulaPtr allocate(Formula& f) {
+        ArenaAllocator<Formula> allocator(scopeArena ? scopeArena : &arena);
+        return std::visit(Overloaded{
+            [&](Not& n) {
+                return std::allocate_shared<Formula>(allocator, std::in_place_type<Not>, std::move(n.subformula));
+            },
+            [&](Binary& b) {
+                return std::allocate_shared<Formula>(allocator, std::in_place_type<Binary>, b.type,
+                                                     std::move(b.left), std::move(b.right));
+            },
+            [&](auto& g) { return std::allocate_shared<Formula>(allocator, std::move(g)); }}, f);
+    }
+
+    // Premesta unose u tabelu sa capacity mesta
+    void rebuild(std::size_t capacity) {
+        std::vector<Entry> old = std::exchange(entries, std::vector<Entry>(capacity));
+        used = 0;
+        for(Entry& entry : old)
+            if(entry.hash != 0)
+                place(entry.hash, std::move(entry.node));
+    }
+
+    // Izbacuje istekle unose (zivi unosi su posle toga najvise cetvrtina mesta) i oslobadja
+    // arene zavrsenih ArenaScope u kojima vise nema zivih cvorova
+    void sweep() {
+        destroyedAtSweep = destroyedNodes();
+        std::vector<Entry> live;
+        for(Entry& entry : entries)
+            if(entry.hash != 0 && !entry.node.expired())
+                live.push_back(std::move(entry));
+        std::size_t capacity = 1024;
+        while(capacity < 4 * live.size())
+            capacity *= 2;
+        entries.assign(capacity, Entry{});
+        used = 0;
+        for(Entry& entry : live)
+            place(entry.hash, std::move(entry.node));
+        std::erase_if(scopes, [](const auto& scope) { return scope->retired && scope->live == 0; });
+    }
+
+    // Kada su tri cetvrtine tabele zauzete, istekli unosi se izbacuju ako ih je bar polovina
+    // (arena broji unistene cvorove), a inace se tabela samo udvostrucuje. Hes je u unosu, pa duze
+    // trazenje pri vecoj popunjenosti ne cita cvorove, a tabela zauzima upola manje memorije.
+    void reserve(std::size_t count) {
+        if(4 * (used + count) <= 3 * entries.size())
+            return;
+        if(2 * (destroyedNodes() - destroyedAtSweep) >= used)
+            sweep();
+        while(4 * (used + count) > 3 * entries.size())
+            rebuild(2 * entries.size());
+    }
+
+    // Upisuje unos za cvor za koji se zna da nije u tabeli (mesto mora postojati, vidi reserve)
+    void place(std::size_t hash, std::weak_ptr<Formula> node) {
+        std::size_t mask = entries.size() - 1;
+        std::size_t i = hash & mask;
+        while(entries[i].hash != 0)
+            i = (i + 1) & mask;
+        entries[i] = {hash, std::move(node)};
+        used++;
+    }
+
+    void prefetch(std::size_t hash) const {
+        __builtin_prefetch(&entries[hash & (entries.size() - 1)]);
+    }
+
+    // Trazi cvor sa hesom hash za koji same vraca true, bez upisivanja (poziva se pod bravom)
+    template<typename Same>
+    FormulaPtr find(std::size_t hash, Same same) const {
+        std::size_t mask = entries.size() - 1;
+        for(std::size_t i = hash & mask; entries[i].hash != 0; i = (i + 1) & mask)
+            if(entries[i].hash == hash)
+                if(FormulaPtr node = entries[i].node.lock(); node && same(*node))
+                    return node;
+        return nullptr;
+    }
+
+    // Poziva se pod bravom (mutex). Istekli unosi ostaju do sledeceg sweep(): provera da li je
+    // unos istekao bi citala sam cvor, pa se cvorovi citaju samo kada im je hes jednak trazenom.
+    FormulaPtr intern(Formula f, std::size_t hash) {
+        reserve(1);
+        std::size_t mask = entries.size() - 1;
+        std::size_t i = hash & mask;
+        for(; entries[i].hash != 0; i = (i + 1) & mask)
+            if(entries[i].hash == hash)
+                if(FormulaPtr node = entries[i].node.lock(); node && sameNode(*node, f))
+                    return node;
+        FormulaPtr node = allocate(f);
+        entries[i] = {hash, node};
+        used++;
+        return node;
+    }
+
+    FormulaPtr intern(Formula f) {
+        std::size_t hash = nodeHash(f);
+        return intern(std::move(f), hash);
+    }
 };
 
-FormulaPtr ptr(const Formula& f) { return std::make_shared<Formula>(f); }
+UniqueTable& uniqueTable() {
+    static UniqueTable table;
+    return table;
+}
+
+FormulaPtr ptr(Formula f) {
+    UniqueTable& table = uniqueTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.intern(std::move(f));
+}
+
+// Vraca svu memoriju cvorova odjednom, npr. posle obrade jednog problema
+// Uspeva samo ako nijedna formula vise nije ziva
+bool releaseFormulas() {
+    UniqueTable& table = uniqueTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    table.sweep();
+    return table.size() == 0 && table.arena.clear();
+}
+
+// Arena jednog problema: dok je ArenaScope ziv, nove cvorove ova nit smesta u njegovu arenu.
+// Kada se zavrsi, arena se vraca sistemu cim u njoj vise nema zivih cvorova, i kada su cvorovi
+// drugih problema (u zajednickoj ili drugim arenama) jos zivi, sto releaseFormulas ne moze.
+// Cvor iz arene problema moze da se deli i sa kasnijim formulama (jedinstvena tabela); tada
+// arena ostaje dok i takve formule ne nestanu.
+struct ArenaScope {
+    NodeArena* arena;
+    NodeArena* previous;
+
+    ArenaScope() {
+        UniqueTable& table = uniqueTable();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        arena = table.scopes.emplace_back(std::make_unique<NodeArena>()).get();
+        previous = std::exchange(scopeArena, arena);
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ~ArenaScope() {
+        scopeArena = previous;
+        UniqueTable& table = uniqueTable();
+        std::lock_guard<std::mutex> lock(table.mutex);
+        arena->retired = true;
+        table.sweep();
+    }
+};
+
+// Unistavanje formule bez rekurzije: potformule cvora koji se unistava se ne unistavaju
+// odmah (sto bi kod dubokih formula prepunilo stek), vec se odlazu na stek i unistavaju redom
+void release(FormulaPtr& f) {
+    static thread_local std::vector<FormulaPtr>* pending = nullptr;
+    if(!f)
+        return;
+    if(pending) {
+        pending->push_back(std::move(f));
+        return;
+    }
+    // Cvor koji jos neko koristi se ne unistava, pa stek nije potreban
+    if(f.use_count() > 1) {
+        f.reset();
+        return;
+    }
+    std::vector<FormulaPtr> stack;
+    pending = &stack;
+    stack.push_back(std::move(f));
+    while(!stack.empty()) {
+        FormulaPtr g = std::move(stack.back());
+        stack.pop_back();
+    }
+    pending = nullptr;
+}
+
+Not::~Not() { release(subformula); }
+Binary::~Binary() {
+    release(left);
+    release(right);
+}
 
 template<typename T>
 bool is(const FormulaPtr& f) { return std::holds_alternative<T>(*f);}
 
 template<typename T>
-T as(const FormulaPtr& f) { return std::get<T>(*f); }
+const T& as(const FormulaPtr& f) { return std::get<T>(*f); }
 
 // Valuation
 using Valuation = std::map<std::string, bool>;
@@ -39,101 +429,239 @@ using Valuation = std::map<std::string, bool>;
 // AtomSet
 using AtomSet = std::set<std::string>;
 
-int complexity(const FormulaPtr& f) {
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return 0;
-    if(is<Not>(f))
-        return 1 + complexity(as<Not>(f).subformula);
-    if(is<Binary>(f))
-        return 1 + complexity(as<Binary>(f).left) + complexity(as<Binary>(f).right);
-    return 0;
+// Obilazak formule bez rekurzije
+// Duboke formule (npr. konjunkcija milion atoma) bi rekurzijom prepunile stek programa,
+// zato funkcije nad formulama koriste eksplicitni stek
+
+// i-ta potformula formule f, ili nullptr ako je nema
+const FormulaPtr* subformula(const FormulaPtr& f, int i) {
+    return match(f,
+        [&](const Not& n) -> const FormulaPtr* { return i == 0 ? &n.subformula : nullptr; },
+        [&](const Binary& b) -> const FormulaPtr* { return i == 0 ? &b.left : i == 1 ? &b.right : nullptr; },
+        [](const auto&) -> const FormulaPtr* { return nullptr; });
 }
 
-std::string print(const FormulaPtr& f) {
-    if(is<False>(f)) return "F";
-    if(is<True>(f))  return "T";
-    if(is<Atom>(f))  return as<Atom>(f).name;
-    if(is<Not>(f))   return "~" + print(as<Not>(f).subformula);
-    if(is<Binary>(f)) {
-        std::string sign;
-        switch(as<Binary>(f).type) {
-            case Binary::And:  sign = "&";   break;
-            case Binary::Or:   sign = "|";   break;
-            case Binary::Impl: sign = "->";  break;
-            case Binary::Eq:   sign = "<->"; break;
+// walk poziva visit(g, i) za cvor g pre obilaska njegove i-te potformule i jos jednom posle
+// poslednje, pa se isti obilazak koristi za prefiksni, infiksni i postfiksni redosled
+template<typename Visit>
+void walk(const FormulaPtr& f, Visit visit) {
+    std::vector<std::pair<const FormulaPtr*, int>> stack = {{&f, 0}};
+    while(!stack.empty()) {
+        auto [g, i] = stack.back();
+        if(i == 0)
+            STATS_ADD(visited, 1);
+        visit(*g, i);
+        if(const FormulaPtr* sub = subformula(*g, i)) {
+            stack.back().second++;
+            stack.emplace_back(sub, 0);
+        } else
+            stack.pop_back();
+    }
+}
+
+// fold racuna rezultat u postfiksnom redosledu: child(frame, i) vraca stanje i-tog potomka
+// (stanje pored cvora moze da nosi i dodatne podatke, npr. da li je cvor pod negacijom),
+// a combine(frame, args) pravi rezultat cvora od rezultata potomaka
+template<typename Result, typename Frame, typename Child, typename Combine>
+Result fold(Frame root, Child child, Combine combine) {
+    std::vector<std::pair<Frame, int>> stack = {{root, 0}};
+    std::vector<Result> results;
+    Result args[4];
+    while(!stack.empty()) {
+        auto& [frame, i] = stack.back();
+        std::optional<Frame> next = child(frame, i);
+        if(next) {
+            i++;
+            stack.emplace_back(*next, 0);
+            continue;
+        }
+        for(int k = i - 1; k >= 0; k--) {
+            args[k] = std::move(results.back());
+            results.pop_back();
         }
-        return "(" + print(as<Binary>(f).left) + " " + sign + " " + print(as<Binary>(f).right) + ")";
+        STATS_ADD(visited, 1);
+        results.push_back(combine(std::as_const(frame), args));
+        stack.pop_back();
+    }
+    return std::move(results.back());
+}
+
+// Najcesci slucaj: stanje je sam cvor, a potomci su njegove potformule
+template<typename Result, typename Combine>
+Result fold(const FormulaPtr& f, Combine combine) {
+    auto child = [](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    return fold<Result>(&f, child, [&](const FormulaPtr* g, Result* args) { return combine(*g, args); });
+}
+
+// Kao fold, ali se rezultat racuna jednom za svaki kljuc stanja (npr. cvor i polaritet).
+// Kako su iste potformule isti cvor, formula se obradjuje kao DAG: zajednicke potformule
+// se ne obilaze ponovo, a rezultat je DAG velicine linearne u velicini ulaza.
+template<typename Result, typename Frame, typename Key, typename Child, typename Combine>
+Result foldShared(Frame root, Key key, Child child, Combine combine) {
+    std::unordered_map<std::uintptr_t, Result> memo;
+    auto memoChild = [&](const Frame& frame, int i) -> std::optional<Frame> {
+        if(memo.contains(key(frame)))
+            return {};
+        return child(frame, i);
+    };
+    return fold<Result>(root, memoChild, [&](const Frame& frame, Result* args) -> Result {
+        auto it = memo.find(key(frame));
+        if(it != memo.end())
+            return it->second;
+        Result result = combine(frame, args);
+        memo.emplace(key(frame), result);
+        return result;
+    });
+}
+
+// Najcesci slucaj: kljuc je sam cvor
+template<typename Result, typename Combine>
+Result foldShared(const FormulaPtr& f, Combine combine) {
+    auto key = [](const FormulaPtr* g) { return reinterpret_cast<std::uintptr_t>(g->get()); };
+    auto child = [](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    return foldShared<Result>(&f, key, child, [&](const FormulaPtr* g, Result* args) { return combine(*g, args); });
+}
+
+// Broj razlicitih cvorova formule (velicina DAG-a)
+std::size_t dagSize(const FormulaPtr& f) {
+    std::size_t count = 0;
+    foldShared<int>(f, [&](const FormulaPtr&, int*) {
+        count++;
+        return 0;
+    });
+    return count;
+}
+
+// Broj veznika u stablu formule. Ne treba rezultat po cvoru, pa umesto fold (koji za svaki cvor
+// posebno trazi i-tu potformulu i slaze rezultate potomaka) cvorovi idu kroz stek, uz jedan
+// match po cvoru.
+int complexity(const FormulaPtr& f) {
+    int count = 0;
+    std::vector<const Formula*> stack = {f.get()};
+    while(!stack.empty()) {
+        const Formula* g = stack.back();
+        stack.pop_back();
+        match(*g,
+            [&](const Not& n) {
+                count++;
+                stack.push_back(n.subformula.get());
+            },
+            [&](const Binary& b) {
+                count++;
+                stack.push_back(b.right.get());
+                stack.push_back(b.left.get());
+            },
+            [](const auto&) {});
+    }
+    return count;
+}
+
+std::string sign(Binary::Type type) {
+    switch(type) {
+        case Binary::And:  return "&";
+        case Binary::Or:   return "|";
+        case Binary::Impl: return "->";
+        case Binary::Eq:   return "<->";
     }
     return "";
 }
 
+std::string print(const FormulaPtr& f) {
+    std::string result;
+    walk(f, [&](const FormulaPtr& g, int i) {
+        match(g,
+            [&](const False&) { result += "F"; },
+            [&](const True&) { result += "T"; },
+            [&](const Atom& a) { result += a.name; },
+            [&](const Not&) {
+                if(i == 0)
+                    result += "~";
+            },
+            [&](const Binary& b) {
+                if(i == 0)
+                    result += "(";
+                else if(i == 1)
+                    result += " " + sign(b.type) + " ";
+                else
+                    result += ")";
+            });
+    });
+    return result;
+}
+
 bool evaluate(const FormulaPtr& f, Valuation& v) {
-    if(is<False>(f))
-        return false;
-    if(is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return v[as<Atom>(f).name];
-    if(is<Not>(f))
-        return !evaluate(as<Not>(f).subformula, v);
-    if(is<Binary>(f)) {
-        bool evalL = evaluate(as<Binary>(f).left, v);
-        bool evalR = evaluate(as<Binary>(f).right, v);
-        switch(as<Binary>(f).type) {
-            case Binary::And:  return evalL && evalR;
-            case Binary::Or:   return evalL || evalR;
-            case Binary::Impl: return !evalL || evalR;
-            case Binary::Eq:   return evalL == evalR;
-        }
-    }
-    return false;
+    return fold<bool>(f, [&](const FormulaPtr& g, bool* args) {
+        return match(g,
+            [](const False&) { return false; },
+            [](const True&) { return true; },
+            [&](const Atom& a) -> bool { return v[a.name]; },
+            [&](const Not&) { return !args[0]; },
+            [&](const Binary& b) {
+                switch(b.type) {
+                    case Binary::And:  return args[0] && args[1];
+                    case Binary::Or:   return args[0] || args[1];
+                    case Binary::Impl: return !args[0] || args[1];
+                    case Binary::Eq:   return args[0] == args[1];
+                }
+                return false;
+            });
+    });
 }
 
+// Zbog jedinstvene tabele strukturno jednake formule su isti cvor
 bool equal(const FormulaPtr& f, const FormulaPtr& g) {
-    if(f->index() != g->index())
-        return false;
+    return f == g;
+}
 
-    if(is<False>(f) || is<True>(f))
-        return true;
-    if(is<Atom>(f))
-        return as<Atom>(f).name == as<Atom>(g).name;
-    if(is<Not>(f))
-        return equal(as<Not>(f).subformula, as<Not>(g).subformula);
-    if(is<Binary>(f)) {
-        return as<Binary>(f).type == as<Binary>(g).type &&
-               equal(as<Binary>(f).left, as<Binary>(g).left) &&
-               equal(as<Binary>(f).right, as<Binary>(g).right);
-    }
-    return false;
+// Smena potformula: svako pojavljivanje kljuca iz s zamenjuje se odgovarajucom formulom, i to
+// sve smene odjednom (u umetnutim formulama se nista dalje ne menja). Kljuc je sam cvor, jer su
+// zbog jedinstvene tabele jednake formule isti cvor, pa je poredjenje jedna pretraga u hes mapi.
+// Potformula u kojoj nista nije zamenjeno se ne pravi ponovo, vec se vraca isti cvor,
+// a zajednicke potformule se obradjuju jednom.
+using Substitution = std::unordered_map<const Formula*, FormulaPtr>;
+
+FormulaPtr substitute(const FormulaPtr& f, const Substitution& s) {
+    if(s.empty())
+        return f;
+    auto key = [](const FormulaPtr* g) { return reinterpret_cast<std::uintptr_t>(g->get()); };
+    auto child = [&](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(s.contains(g->get()))
+            return {};
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    auto combine = [&](const FormulaPtr* frame, FormulaPtr* args) -> FormulaPtr {
+        const FormulaPtr& g = *frame;
+        if(auto it = s.find(g.get()); it != s.end())
+            return it->second;
+        return match(g,
+            [&](const Not& n) { return args[0] == n.subformula ? g : ptr(Not{args[0]}); },
+            [&](const Binary& b) {
+                return args[0] == b.left && args[1] == b.right ? g : ptr(Binary{b.type, args[0], args[1]});
+            },
+            [&](const auto&) { return g; });
+    };
+    return foldShared<FormulaPtr>(&f, key, child, combine);
 }
 
 FormulaPtr substitute(const FormulaPtr& f, const FormulaPtr& what, const FormulaPtr& with) {
-    if(equal(f, what))
-        return with;
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return f;
-    if(is<Not>(f))
-        return ptr(Not{substitute(as<Not>(f).subformula, what, with)});
-    if(is<Binary>(f)) {
-        auto binaryF = as<Binary>(f);
-        return ptr(Binary{
-            binaryF.type,
-            substitute(binaryF.left, what, with),
-            substitute(binaryF.right, what, with)
-        });
-    }
-    return FormulaPtr{};
+    return substitute(f, Substitution{{what.get(), with}});
 }
 
 void getAtoms(const FormulaPtr& f, AtomSet& atoms) {
-    if(is<Atom>(f))
-        atoms.insert(as<Atom>(f).name);
-    else if(is<Not>(f))
-        getAtoms(as<Not>(f).subformula, atoms);
-    else if(is<Binary>(f)) {
-        getAtoms(as<Binary>(f).left, atoms);
-        getAtoms(as<Binary>(f).right, atoms);
-    }
+    walk(f, [&](const FormulaPtr& g, int) {
+        if(is<Atom>(g))
+            atoms.insert(std::get<Atom>(*g).name);
+    });
 }
 
 bool next(Valuation& v) {
@@ -187,102 +715,131 @@ std::optional<Valuation> isSatisfiable(const FormulaPtr& f) {
 }
 
 FormulaPtr simplify(const FormulaPtr& f) {
-    if(is<False>(f) || is<True>(f) || is<Atom>(f))
-        return f;
-    if(is<Not>(f)) {
-        FormulaPtr s = simplify(as<Not>(f).subformula);
-        if(is<True>(s))
-            return ptr(False{});
-        if(is<False>(s))
-            return ptr(True{});
-        return ptr(Not{s});
-    }
-    auto b = as<Binary>(f);
-    FormulaPtr ls = simplify(b.left);
-    FormulaPtr rs = simplify(b.right);
-    if(b.type == Binary::And) {
-        if(is<False>(ls) || is<False>(rs))
-            return ptr(False{});
-        if(is<True>(ls))
-            return rs;
-        if(is<True>(rs))
-            return ls;
-        return ptr(Binary{Binary::And, ls, rs});
-    }
-    if(b.type == Binary::Or) {
-        if(is<True>(ls) || is<True>(rs))
-            return ptr(True{});
-        if(is<False>(ls))
-            return rs;
-        if(is<False>(rs))
-            return ls;
-        return ptr(Binary{Binary::Or, ls, rs});
-    }
-    if(b.type == Binary::Impl) {
-        if(is<False>(ls) || is<True>(rs))
-            return ptr(True{});
-        if(is<True>(ls))
-            return rs;
-        if(is<False>(rs))
-            return ptr(Not{ls});
-        return ptr(Binary{Binary::Impl, ls, rs});
-    }
-    if(b.type == Binary::Eq) {
-        if(is<True>(ls))
-            return rs;
-        if(is<True>(rs))
-            return ls;
-        if(is<False>(ls) && is<False>(rs))
-            return ptr(True{});
-        if(is<False>(ls))
-            return ptr(Not{rs});
-        if(is<False>(rs))
-            return ptr(Not{ls});
-        return ptr(Binary{Binary::Eq, ls, rs});
-    }
-    return FormulaPtr{};
-}
-
-FormulaPtr nnf(const FormulaPtr& f);
+    return foldShared<FormulaPtr>(f, [](const FormulaPtr& g, FormulaPtr* args) -> FormulaPtr {
+        return match(g,
+            [&](const Not&) {
+                const FormulaPtr& s = args[0];
+                if(is<True>(s))
+                    return ptr(False{});
+                if(is<False>(s))
+                    return ptr(True{});
+                return ptr(Not{s});
+            },
+            [&](const Binary& b) {
+                auto type = b.type;
+                const FormulaPtr& ls = args[0];
+                const FormulaPtr& rs = args[1];
+                if(type == Binary::And) {
+                    if(is<False>(ls) || is<False>(rs))
+                        return ptr(False{});
+                    if(is<True>(ls))
+                        return rs;
+                    if(is<True>(rs))
+                        return ls;
+                    return ptr(Binary{Binary::And, ls, rs});
+                }
+                if(type == Binary::Or) {
+                    if(is<True>(ls) || is<True>(rs))
+                        return ptr(True{});
+                    if(is<False>(ls))
+                        return rs;
+                    if(is<False>(rs))
+                        return ls;
+                    return ptr(Binary{Binary::Or, ls, rs});
+                }
+                if(type == Binary::Impl) {
+                    if(is<False>(ls) || is<True>(rs))
+                        return ptr(True{});
+                    if(is<True>(ls))
+                        return rs;
+                    if(is<False>(rs))
+                        return ptr(Not{ls});
+                    return ptr(Binary{Binary::Impl, ls, rs});
+                }
+                if(is<True>(ls))
+                    return rs;
+                if(is<True>(rs))
+                    return ls;
+                if(is<False>(ls) && is<False>(rs))
+                    return ptr(True{});
+                if(is<False>(ls))
+                    return ptr(Not{rs});
+                if(is<False>(rs))
+                    return ptr(Not{ls});
+                return ptr(Binary{Binary::Eq, ls, rs});
+            },
+            [&](const auto&) { return g; });
+    });
+}
+
+// Stanje obilaska za NNF: cvor i da li se nalazi pod negacijom
+// Svaki cvor se prevodi najvise jednom za svaki polaritet, pa ugnjezdene ekvivalencije
+// (cije se potformule javljaju u oba polariteta) ne dovode do eksponencijalnog rada
+struct NnfFrame {
+    const FormulaPtr* f;
+    bool negated;
+};
+
+FormulaPtr nnf(const FormulaPtr& f, bool negated) {
+    auto child = [](const NnfFrame& frame, int i) -> std::optional<NnfFrame> {
+        const FormulaPtr& g = *frame.f;
+        bool neg = frame.negated;
+        if(is<Not>(g) && i == 0)
+            return NnfFrame{subformula(g, 0), !neg};
+        if(!is<Binary>(g) || i >= 4)
+            return {};
+        switch(as<Binary>(g).type) {
+            case Binary::And:
+            case Binary::Or:
+                if(i < 2)
+                    return NnfFrame{subformula(g, i), neg};
+                break;
+            case Binary::Impl:
+                if(i < 2)
+                    return NnfFrame{subformula(g, i), i == 0 ? !neg : neg};
+                break;
+            case Binary::Eq:
+                // (~A | B) & (A | ~B), odnosno (A & ~B) | (~A & B) pod negacijom
+                return NnfFrame{subformula(g, i % 2), (i == 0 || i == 3) != neg};
+        }
+        return {};
+    };
+    auto combine = [](const NnfFrame& frame, FormulaPtr* args) -> FormulaPtr {
+        const FormulaPtr& g = *frame.f;
+        bool neg = frame.negated;
+        return match(g,
+            [&](const False&) { return neg ? ptr(True{}) : g; },
+            [&](const True&) { return neg ? ptr(False{}) : g; },
+            [&](const Atom&) { return neg ? ptr(Not{g}) : g; },
+            [&](const Not&) { return args[0]; },
+            [&](const Binary& b) {
+                switch(b.type) {
+                    case Binary::And:
+                        return ptr(Binary{neg ? Binary::Or : Binary::And, args[0], args[1]});
+                    case Binary::Or:
+                        return ptr(Binary{neg ? Binary::And : Binary::Or, args[0], args[1]});
+                    case Binary::Impl:
+                        return ptr(Binary{neg ? Binary::And : Binary::Or, args[0], args[1]});
+                    case Binary::Eq:
+                        return ptr(Binary{neg ? Binary::Or : Binary::And,
+                                          ptr(Binary{neg ? Binary::And : Binary::Or, args[0], args[1]}),
+                                          ptr(Binary{neg ? Binary::And : Binary::Or, args[2], args[3]})});
+                }
+                return FormulaPtr{};
+            });
+    };
+    auto key = [](const NnfFrame& frame) {
+        return reinterpret_cast<std::uintptr_t>(frame.f->get()) | frame.negated;
+    };
+    return foldShared<FormulaPtr>(NnfFrame{&f, negated}, key, child, combine);
+}
 
 FormulaPtr nnfNot(const FormulaPtr& f) {
-    if(is<Atom>(f))
-        return ptr(Not{f});
-    if(is<Not>(f))
-        return nnf(as<Not>(f).subformula);
-    auto b = as<Binary>(f);
-    if(b.type == Binary::And)
-        return ptr(Binary{Binary::Or, nnfNot(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Or)
-        return ptr(Binary{Binary::And, nnfNot(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Impl)
-        return ptr(Binary{Binary::And, nnf(b.left), nnfNot(b.right)});
-    if(b.type == Binary::Eq)
-        return ptr(Binary{
-            Binary::Or,
-            ptr(Binary{Binary::And, nnf(b.left), nnfNot(b.right)}),
-            ptr(Binary{Binary::And, nnfNot(b.left), nnf(b.right)})
-        });
+    return nnf(f, true);
 }
 
 FormulaPtr nnf(const FormulaPtr& f) {
-   if(is<False>(f) || is<True>(f) || is<Atom>(f))
-       return f;
-   if(is<Not>(f))
-       return nnfNot(as<Not>(f).subformula);
-   auto b = as<Binary>(f);
-   if(b.type == Binary::And)
-       return ptr(Binary{Binary::And, nnf(b.left), nnf(b.right)});
-   if(b.type == Binary::Or)
-       return ptr(Binary{Binary::Or, nnf(b.left), nnf(b.right)});
-   if(b.type == Binary::Impl)
-       return ptr(Binary{Binary::Or, nnfNot(b.left), nnf(b.right)});
-   if(b.type == Binary::Eq)
-       return ptr(Binary{Binary::And,
-                         ptr(Binary{Binary::Or, nnfNot(b.left), nnf(b.right)}),
-                         ptr(Binary{Binary::Or, nnf(b.left), nnfNot(b.right)})
-                  });
-   return FormulaPtr{};
+    return nnf(f, false);
 }
 
 struct Literal {
@@ -293,37 +850,180 @@ struct Literal {
 using Clause = std::vector<Literal>;
 using NormalForm = std::vector<Clause>;
 
-template<typename List>
-List concat(const List& l, const List& r) {
-    List result;
-    std::copy(begin(l), end(l), std::back_inserter(result));
-    std::copy(begin(r), end(r), std::back_inserter(result));
-    return result;
+// Tokom pravljenja KNF klauza je sortiran skup celobrojnih literala: atom broj i je literal i,
+// a njegova negacija -i. Literali su sortirani po atomu, pa su ponovljeni i komplementarni
+// literali susedni: ponovljeni se izbacuju, a klauza sa komplementarnim (tautologija) odmah odbacuje.
+using IntClause = std::vector<int>;
+
+bool literalLess(int a, int b) {
+    return std::abs(a) < std::abs(b) || (std::abs(a) == std::abs(b) && a < b);
+}
+
+// Vraca false ako je klauza tautologija
+bool normalize(IntClause& c) {
+    std::sort(begin(c), end(c), literalLess);
+    c.erase(std::unique(begin(c), end(c)), end(c));
+    for(std::size_t i = 1; i < c.size(); i++)
+        if(c[i] == -c[i - 1])
+            return false;
+    return true;
+}
+
+// 64-bitni potpis klauze (Blumov filter njenih literala): D moze biti podskup od C
+// samo ako je svaki bit potpisa od D postavljen i u potpisu od C
+std::uint64_t clauseSignature(const IntClause& c) {
+    std::uint64_t signature = 0;
+    for(int literal : c)
+        signature |= std::uint64_t(1) << ((2 * std::abs(literal) + (literal < 0)) % 64);
+    return signature;
+}
+
+// Skup klauza bez tautologija i bez klauza koje sadrze neku drugu klauzu (podsumpcija):
+// nova klauza se odbacuje ako je neka postojeca njen podskup (unapred), a postojece klauze
+// koje su nadskup nove se uklanjaju (unazad)
+struct ClauseSet {
+    std::vector<IntClause> clauses;
+    std::vector<std::uint64_t> signatures;
+    std::vector<bool> removed;
+    std::size_t live = 0;
+    // Klauze po literalima koje sadrze, i po svom prvom literalu (0 za praznu klauzu)
+    std::unordered_map<int, std::vector<std::size_t>> occurrences, first;
+
+    std::size_t size() const { return live; }
+
+    // Da li je klauza sub podskup klauze super
+    static bool subsumes(const IntClause& sub, std::uint64_t subSignature, const IntClause& super, std::uint64_t superSignature) {
+        return (subSignature & ~superSignature) == 0 &&
+               std::includes(begin(super), end(super), begin(sub), end(sub), literalLess);
+    }
+
+    void add(IntClause c) {
+        if(!normalize(c))
+            return;
+        std::uint64_t signature = clauseSignature(c);
+
+        // Podskup od c pocinje nekim literalom iz c, ili je prazan
+        for(int key : c)
+            if(auto it = first.find(key); it != first.end())
+                for(std::size_t d : it->second)
+                    if(!removed[d] && subsumes(clauses[d], signatures[d], c, signature))
+                        return;
+        if(auto it = first.find(0); it != first.end() && !it->second.empty())
+            return;
+
+        // Nadskup od c sadrzi svaki literal iz c, pa je dovoljno pregledati najkracu listu
+        if(c.empty()) {
+            std::fill(begin(removed), end(removed), true);
+            live = 0;
+        }
+        else {
+            int rarest = *std::min_element(begin(c), end(c), [&](int a, int b) {
+                return occurrences[a].size() < occurrences[b].size();
+            });
+            for(std::size_t e : occurrences[rarest])
+                if(!removed[e] && subsumes(c, signature, clauses[e], signatures[e])) {
+                    removed[e] = true;
+                    live--;
+                }
+        }
+
+        std::size_t index = clauses.size();
+        for(int literal : c)
+            occurrences[literal].push_back(index);
+        first[c.empty() ? 0 : c[0]].push_back(index);
+        clauses.push_back(std::move(c));
+        signatures.push_back(signature);
+        removed.push_back(false);
+        live++;
+    }
+
+    template<typename Visit>
+    void forEach(Visit visit) const {
+        for(std::size_t i = 0; i < clauses.size(); i++)
+            if(!removed[i])
+                visit(clauses[i]);
+    }
+};
+
+// Konjunkcija: klauze manjeg skupa se dodaju u veci
+ClauseSet conjoin(ClauseSet& l, ClauseSet& r) {
+    if(l.size() < r.size())
+        std::swap(l, r);
+    r.forEach([&](const IntClause& c) { l.add(c); });
+    return std::move(l);
 }
 
-NormalForm cross(const NormalForm& l, const NormalForm& r) {
-    NormalForm result;
-    for(const auto& lc : l)
-        for(const auto& rc : r)
-            result.push_back(concat(lc, rc));
+// Disjunkcija: unija svake klauze levog i svake klauze desnog skupa (distributivnost)
+ClauseSet disjoin(const ClauseSet& l, const ClauseSet& r) {
+    ClauseSet result;
+    l.forEach([&](const IntClause& lc) {
+        r.forEach([&](const IntClause& rc) {
+            IntClause c = lc;
+            c.insert(end(c), begin(rc), end(rc));
+            result.add(std::move(c));
+        });
+    });
     return result;
 }
 
+// Numeracija atoma formule, azbucnim redom
+struct AtomNumbering {
+    std::unordered_map<std::string, int> index;
+    std::vector<std::string> names = {""};
+
+    int literal(const std::string& name, bool pos) {
+        auto [it, inserted] = index.try_emplace(name, int(names.size()));
+        if(inserted)
+            names.push_back(name);
+        return pos ? it->second : -it->second;
+    }
+
+    NormalForm toNormalForm(const ClauseSet& set) const {
+        NormalForm result;
+        set.forEach([&](const IntClause& c) {
+            Clause clause;
+            for(int literal : c)
+                clause.push_back(Literal{literal > 0, names[std::abs(literal)]});
+            result.push_back(std::move(clause));
+        });
+        return result;
+    }
+};
+
+// KNF formule u NNF distributivnoscu; klauze se prave kao skupovi celobrojnih literala,
+// pa rezultat nema tautologija, ponovljenih literala ni podsumiranih klauza
 NormalForm cnf(const FormulaPtr& f) {
-    if(is<True>(f))
-        return {};
-    if(is<False>(f))
-        return {{}};
-    if(is<Atom>(f))
-        return {{Literal{true, as<Atom>(f).name}}};
-    if(is<Not>(f))
-        return {{Literal{false, as<Atom>(as<Not>(f).subformula).name}}};
-    auto b = as<Binary>(f);
-    if(b.type == Binary::And)
-        return concat(cnf(b.left), cnf(b.right));
-    if(b.type == Binary::Or)
-        return cross(cnf(b.left), cnf(b.right));
-    return NormalForm{};
+    AtomNumbering atoms;
+    AtomSet names;
+    getAtoms(f, names);
+    for(const std::string& name : names)
+        atoms.literal(name, true);
+
+    ClauseSet result = fold<ClauseSet>(f, [&](const FormulaPtr& g, ClauseSet* args) -> ClauseSet {
+        ClauseSet set;
+        return match(g,
+            [&](const False&) {
+                set.add({});
+                return set;
+            },
+            [&](const True&) { return set; },
+            [&](const Atom& a) {
+                set.add({atoms.literal(a.name, true)});
+                return set;
+            },
+            [&](const Not& n) {
+                set.add({atoms.literal(as<Atom>(n.subformula).name, false)});
+                return set;
+            },
+            [&](const Binary& b) {
+                if(b.type == Binary::And)
+                    return conjoin(args[0], args[1]);
+                if(args[0].size() < args[1].size())
+                    std::swap(args[0], args[1]);
+                return disjoin(args[0], args[1]);
+            });
+    });
+    return atoms.toNormalForm(result);
 }
 
 void print(const NormalForm& f) {
@@ -338,36 +1038,56 @@ void print(const NormalForm& f) {
 
 // cetvrti cas
 std::string tseitinRec(const FormulaPtr& f, int& subCount, NormalForm& cnf) {
-    if(is<False>(f)) {
-        std::string sub = "s" + std::to_string(++subCount);
-        cnf.push_back({Literal{false, sub}});
-        return sub;
-    }
-    if(is<True>(f)) {
-        std::string sub = "s" + std::to_string(++subCount);
-        cnf.push_back({Literal{true, sub}});
-        return sub;
-    }
-    if(is<Atom>(f))
-        return as<Atom>(f).name;
-    if(is<Not>(f)) {
-        std::string subformula = tseitinRec(as<Not>(f).subformula, subCount, cnf);
-        std::string substitution = "s" + std::to_string(++subCount);
-        cnf.push_back({Literal{false, subformula}, Literal{false, substitution}});
-        cnf.push_back({Literal{true, subformula}, Literal{true, substitution}});
-        return substitution;
-    }
-    Binary b = as<Binary>(f);
-    std::string l = tseitinRec(b.left, subCount, cnf);
-    std::string r = tseitinRec(b.right, subCount, cnf);
-    std::string sub= "s" + std::to_string(++subCount);
-    if(b.type == Binary::And) {
-        cnf.push_back({Literal{false, sub}, Literal{true, l}});
-        cnf.push_back({Literal{false, sub}, Literal{true, r}});
-        cnf.push_back({Literal{true, sub}, Literal{false, l}, Literal{false, r}});
-        return sub;
-    }
-    // isto za ostale slucajeve
+    return fold<std::string>(f, [&](const FormulaPtr& g, std::string* args) -> std::string {
+        return match(g,
+            [&](const False&) {
+                std::string sub = "s" + std::to_string(++subCount);
+                cnf.push_back({Literal{false, sub}});
+                return sub;
+            },
+            [&](const True&) {
+                std::string sub = "s" + std::to_string(++subCount);
+                cnf.push_back({Literal{true, sub}});
+                return sub;
+            },
+            [&](const Atom& a) { return a.name; },
+            [&](const Not&) {
+                const std::string& subformula = args[0];
+                std::string substitution = "s" + std::to_string(++subCount);
+                cnf.push_back({Literal{false, subformula}, Literal{false, substitution}});
+                cnf.push_back({Literal{true, subformula}, Literal{true, substitution}});
+                return substitution;
+            },
+            [&](const Binary& b) {
+                Binary::Type type = b.type;
+                const std::string& l = args[0];
+                const std::string& r = args[1];
+                std::string sub = "s" + std::to_string(++subCount);
+                if(type == Binary::And) {
+                    cnf.push_back({Literal{false, sub}, Literal{true, l}});
+                    cnf.push_back({Literal{false, sub}, Literal{true, r}});
+                    cnf.push_back({Literal{true, sub}, Literal{false, l}, Literal{false, r}});
+                    return sub;
+                }
+                if(type == Binary::Or) {
+                    cnf.push_back({Literal{false, sub}, Literal{true, l}, Literal{true, r}});
+                    cnf.push_back({Literal{true, sub}, Literal{false, l}});
+                    cnf.push_back({Literal{true, sub}, Literal{false, r}});
+                    return sub;
+                }
+                if(type == Binary::Impl) {
+                    cnf.push_back({Literal{false, sub}, Literal{false, l}, Literal{true, r}});
+                    cnf.push_back({Literal{true, sub}, Literal{true, l}});
+                    cnf.push_back({Literal{true, sub}, Literal{false, r}});
+                    return sub;
+                }
+                cnf.push_back({Literal{false, sub}, Literal{false, l}, Literal{true, r}});
+                cnf.push_back({Literal{false, sub}, Literal{true, l}, Literal{false, r}});
+                cnf.push_back({Literal{true, sub}, Literal{true, l}, Literal{true, r}});
+                cnf.push_back({Literal{true, sub}, Literal{false, l}, Literal{false, r}});
+                return sub;
+            });
+    });
 }
 
 NormalForm tseitin(const FormulaPtr& f) {
@@ -378,7 +1098,904 @@ NormalForm tseitin(const FormulaPtr& f) {
     return cnf;
 }
 
-int main() {
+// Tseitinova transformacija nad celobrojnim literalima
+// Atomi i pomocne promenljive su brojevi 1, 2, 3, ... kao u DIMACS formatu,
+// pa se rezultat moze direktno proslediti SAT resavacu
+using IntNormalForm = std::vector<IntClause>;
+
+struct AtomTable {
+    std::unordered_map<std::string, int> index;
+    // names[i] je ime promenljive i, pomocne promenljive nemaju ime
+    std::vector<std::string> names = {""};
+
+    int intern(const std::string& name) {
+        auto [it, inserted] = index.try_emplace(name, (int)names.size());
+        if(inserted)
+            names.push_back(name);
+        return it->second;
+    }
+
+    int fresh() {
+        names.emplace_back();
+        return (int)names.size() - 1;
+    }
+
+    int count() const { return (int)names.size() - 1; }
+};
+
+// Polaritet potformule: pozitivan ako se pojavljuje pod parnim brojem negacija
+// (leva strana implikacije se racuna kao negacija), negativan ako se pojavljuje
+// pod neparnim, a oba ako se nalazi ispod ekvivalencije
+enum Polarity { Positive = 1, Negative = 2, Both = 3 };
+
+Polarity flip(Polarity p) {
+    if(p == Positive) return Negative;
+    if(p == Negative) return Positive;
+    return Both;
+}
+
+struct PolarityFrame {
+    const FormulaPtr* f;
+    Polarity p;
+};
+
+// Za pozitivnu potformulu dovoljno je s -> F, a za negativnu F -> s
+// (Plaisted-Greenbaum). Sa polaritetom Both dobijamo punu Tseitinovu transformaciju.
+int tseitinIntRec(const FormulaPtr& f, AtomTable& atoms, ClauseSink& cnf, Polarity p) {
+    auto child = [](const PolarityFrame& frame, int i) -> std::optional<PolarityFrame> {
+        const FormulaPtr* sub = subformula(*frame.f, i);
+        if(!sub)
+            return {};
+        if(is<Not>(*frame.f))
+            return PolarityFrame{sub, flip(frame.p)};
+        auto type = std::get<Binary>(**frame.f).type;
+        if(type == Binary::Eq)
+            return PolarityFrame{sub, Both};
+        if(type == Binary::Impl && i == 0)
+            return PolarityFrame{sub, flip(frame.p)};
+        return PolarityFrame{sub, frame.p};
+    };
+    auto combine = [&](const PolarityFrame& frame, int* args) -> int {
+        return match(*frame.f,
+            [&](const False&) {
+                int sub = atoms.fresh();
+                cnf.add({-sub});
+                return sub;
+            },
+            [&](const True&) {
+                int sub = atoms.fresh();
+                cnf.add({sub});
+                return sub;
+            },
+            [&](const Atom& a) { return atoms.intern(a.name); },
+            // Negaciji ne treba nova promenljiva, dovoljno je promeniti znak literala
+            [&](const Not&) { return -args[0]; },
+            [&](const Binary& b) {
+                int l = args[0], r = args[1];
+                int sub = atoms.fresh();
+                bool pos = frame.p & Positive, neg = frame.p & Negative;
+                switch(b.type) {
+                    case Binary::And:
+                        if(pos) {
+                            cnf.add({-sub, l});
+                            cnf.add({-sub, r});
+                        }
+                        if(neg)
+                            cnf.add({sub, -l, -r});
+                        break;
+                    case Binary::Or:
+                        if(pos)
+                            cnf.add({-sub, l, r});
+                        if(neg) {
+                            cnf.add({sub, -l});
+                            cnf.add({sub, -r});
+                        }
+                        break;
+                    case Binary::Impl:
+                        if(pos)
+                            cnf.add({-sub, -l, r});
+                        if(neg) {
+                            cnf.add({sub, l});
+                            cnf.add({sub, -r});
+                        }
+                        break;
+                    case Binary::Eq:
+                        if(pos) {
+                            cnf.add({-sub, -l, r});
+                            cnf.add({-sub, l, -r});
+                        }
+                        if(neg) {
+                            cnf.add({sub, l, r});
+                            cnf.add({sub, -l, -r});
+                        }
+                        break;
+                }
+                return sub;
+            });
+    };
+    return fold<int>(PolarityFrame{&f, p}, child, combine);
+}
+
+void tseitinInt(const FormulaPtr& f, AtomTable& atoms, ClauseSink& cnf) {
+    int sub = tseitinIntRec(f, atoms, cnf, Both);
+    cnf.add({sub});
+}
+
+IntNormalForm tseitinInt(const FormulaPtr& f, AtomTable& atoms) {
+    IntNormalForm cnf;
+    NormalFormSink sink(cnf);
+    tseitinInt(f, atoms, sink);
+    return cnf;
+}
+
+void plaistedGreenbaum(const FormulaPtr& f, AtomTable& atoms, ClauseSink& cnf) {
+    int sub = tseitinIntRec(f, atoms, cnf, Positive);
+    cnf.add({sub});
+}
+
+IntNormalForm plaistedGreenbaum(const FormulaPtr& f, AtomTable& atoms) {
+    IntNormalForm cnf;
+    NormalFormSink sink(cnf);
+    plaistedGreenbaum(f, atoms, sink);
+    return cnf;
+}
+
+// Strukturno hesiranje (kao kod AIG): svaka potformula se svodi na konjunkciju
+// ili ekvivalenciju dva literala sa uredjenim operandima, tako da iste potformule
+// (npr. p & q i ~(~q | ~p)) dobijaju istu promenljivu. Konstante i dvostruke
+// negacije se eliminisu vec prilikom izgradnje.
+// Klauze se generisu tek na kraju, po polaritetu sa kojim se kapija koristi.
+struct StructuralHash {
+    struct Gate {
+        Binary::Type type;
+        int l, r;
+        bool operator==(const Gate&) const = default;
+    };
+    struct GateHash {
+        std::size_t operator()(const Gate& g) const {
+            std::size_t h = g.type;
+            h = h * 1000003 ^ std::hash<int>()(g.l);
+            return h * 1000003 ^ std::hash<int>()(g.r);
+        }
+    };
+
+    AtomTable& atoms;
+    std::unordered_map<Gate, int, GateHash> table;
+    std::unordered_map<const Formula*, int> visited;
+    // Za svaku promenljivu: kapija koju definise (r == 0 za atome) i vec generisani polariteti
+    std::vector<Gate> gates;
+    std::vector<unsigned char> emitted;
+    int trueLiteral = 0;
+
+    explicit StructuralHash(AtomTable& atoms) : atoms(atoms) {}
+
+    int top() {
+        if(trueLiteral == 0)
+            trueLiteral = atoms.fresh();
+        return trueLiteral;
+    }
+
+    bool isConstant(int l) const { return trueLiteral != 0 && std::abs(l) == trueLiteral; }
+
+    int gate(Binary::Type type, int l, int r) {
+        if(l > r)
+            std::swap(l, r);
+        auto [it, inserted] = table.try_emplace(Gate{type, l, r}, 0);
+        if(inserted) {
+            it->second = atoms.fresh();
+            if((int)gates.size() <= it->second) {
+                gates.resize(it->second + 1, Gate{Binary::And, 0, 0});
+                emitted.resize(it->second + 1, 0);
+            }
+            gates[it->second] = Gate{type, l, r};
+        }
+        return it->second;
+    }
+
+    int mkAnd(int l, int r) {
+        if(isConstant(l))
+            return l == trueLiteral ? r : l;
+        if(isConstant(r))
+            return r == trueLiteral ? l : r;
+        if(l == r)
+            return l;
+        if(l == -r)
+            return -top();
+        return gate(Binary::And, l, r);
+    }
+
+    int mkEq(int l, int r) {
+        if(isConstant(l))
+            return l == trueLiteral ? r : -r;
+        if(isConstant(r))
+            return r == trueLiteral ? l : -l;
+        if(l == r)
+            return top();
+        if(l == -r)
+            return -top();
+        // l <-> ~r je isto sto i ~(l <-> r), pa znak izvlacimo ispred kapije
+        int sign = (l < 0) == (r < 0) ? 1 : -1;
+        return sign * gate(Binary::Eq, std::abs(l), std::abs(r));
+    }
+
+    int build(const FormulaPtr& f) {
+        auto child = [&](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+            if(visited.contains(g->get()))
+                return {};
+            if(const FormulaPtr* sub = subformula(*g, i))
+                return sub;
+            return {};
+        };
+        auto combine = [&](const FormulaPtr* g, int* args) -> int {
+            auto it = visited.find(g->get());
+            if(it != visited.end())
+                return it->second;
+            int result = match(*g,
+                [&](const False&) { return -top(); },
+                [&](const True&) { return top(); },
+                [&](const Atom& a) { return atoms.intern(a.name); },
+                [&](const Not&) { return -args[0]; },
+                [&](const Binary& b) {
+                    int l = args[0], r = args[1];
+                    switch(b.type) {
+                        case Binary::And:  return mkAnd(l, r);
+                        case Binary::Or:   return -mkAnd(-l, -r);
+                        case Binary::Impl: return -mkAnd(l, -r);
+                        case Binary::Eq:   return mkEq(l, r);
+                    }
+                    return 0;
+                });
+            visited[g->get()] = result;
+            return result;
+        };
+        return fold<int>(&f, child, combine);
+    }
+
+    // Generise klauze kapija potrebne da bi literal root vazio sa polaritetom p
+    // Kapija se obradjuje ponovo samo ako se pojavi sa polaritetom koji jos nije generisan
+    void require(int root, Polarity rootPolarity, ClauseSink& cnf) {
+        std::vector<std::pair<int, Polarity>> stack = {{root, rootPolarity}};
+        while(!stack.empty()) {
+            auto [l, p] = stack.back();
+            stack.pop_back();
+            int g = std::abs(l);
+            if(l < 0)
+                p = flip(p);
+            if(g >= (int)gates.size() || gates[g].r == 0)
+                continue;
+            int missing = p & ~emitted[g];
+            if(missing == 0)
+                continue;
+            emitted[g] |= missing;
+
+            auto [type, a, b] = gates[g];
+            if(type == Binary::And) {
+                if(missing & Positive) {
+                    cnf.add({-g, a});
+                    cnf.add({-g, b});
+                }
+                if(missing & Negative)
+                    cnf.add({g, -a, -b});
+                stack.emplace_back(b, Polarity(missing));
+                stack.emplace_back(a, Polarity(missing));
+            } else {
+                if(missing & Positive) {
+                    cnf.add({-g, -a, b});
+                    cnf.add({-g, a, -b});
+                }
+                if(missing & Negative) {
+                    cnf.add({g, a, b});
+                    cnf.add({g, -a, -b});
+                }
+                stack.emplace_back(b, Both);
+                stack.emplace_back(a, Both);
+            }
+        }
+    }
+};
+
+void tseitinHashed(const FormulaPtr& f, AtomTable& atoms, ClauseSink& cnf, Polarity p = Positive) {
+    StructuralHash hash(atoms);
+    int root = hash.build(f);
+    hash.require(root, p, cnf);
+    if(hash.trueLiteral != 0)
+        cnf.add({hash.trueLiteral});
+    cnf.add({root});
+}
+
+IntNormalForm tseitinHashed(const FormulaPtr& f, AtomTable& atoms, Polarity p = Positive) {
+    IntNormalForm cnf;
+    NormalFormSink sink(cnf);
+    tseitinHashed(f, atoms, sink, p);
+    return cnf;
+}
+
+// AIG (aig.h) sa jednim izlazom za formulu f; names[i] je ime ulaza i
+Aig toAig(const FormulaPtr& f, std::vector<std::string>& names) {
+    Aig aig;
+    std::unordered_map<std::string, std::uint32_t> inputs;
+    aig.outputs.push_back(foldShared<std::uint32_t>(f, [&](const FormulaPtr& g, std::uint32_t* args) {
+        return match(g,
+            [](const False&) { return Aig::FalseLiteral; },
+            [](const True&) { return Aig::TrueLiteral; },
+            [&](const Atom& a) {
+                auto [it, inserted] = inputs.try_emplace(a.name, 0);
+                if(inserted) {
+                    it->second = aig.input();
+                    names.push_back(a.name);
+                }
+                return it->second;
+            },
+            [&](const Not&) { return args[0] ^ 1; },
+            [&](const Binary& b) {
+                switch(b.type) {
+                    case Binary::And:  return aig.mkAnd(args[0], args[1]);
+                    case Binary::Or:   return aig.mkOr(args[0], args[1]);
+                    case Binary::Impl: return aig.mkOr(args[0] ^ 1, args[1]);
+                    case Binary::Eq:   return aig.mkEq(args[0], args[1]);
+                }
+                return Aig::FalseLiteral;
+            });
+    }));
+    return aig;
+}
+
+// Formula literala l iz AIG-a; negirana kapija cija su oba ulaza negirana postaje disjunkcija
+FormulaPtr toFormula(const Aig& aig, std::uint32_t l, const std::vector<std::string>& names) {
+    std::vector<FormulaPtr> formulas(2 * aig.nodes.size());
+    formulas[Aig::FalseLiteral] = ptr(False{});
+    formulas[Aig::TrueLiteral] = ptr(True{});
+    for(std::size_t i = 0; i < aig.inputs.size(); i++) {
+        formulas[Aig::literal(aig.inputs[i])] = ptr(Atom{names[i]});
+        formulas[Aig::literal(aig.inputs[i], true)] = ptr(Not{formulas[Aig::literal(aig.inputs[i])]});
+    }
+    std::vector<bool> needed = aig.reachable();
+    for(std::uint32_t n = 1; n < aig.nodes.size(); n++) {
+        if(!needed[n] || !aig.isAnd(n))
+            continue;
+        auto [a, b] = aig.nodes[n];
+        FormulaPtr& positive = formulas[Aig::literal(n)];
+        positive = ptr(Binary{Binary::And, formulas[a], formulas[b]});
+        if(Aig::isComplemented(a) && Aig::isComplemented(b))
+            formulas[Aig::literal(n, true)] = ptr(Binary{Binary::Or, formulas[a ^ 1], formulas[b ^ 1]});
+        else
+            formulas[Aig::literal(n, true)] = ptr(Not{positive});
+    }
+    return formulas[l];
+}
+
+// Tseitinovo kodiranje AIG-a (svi izlazi moraju da vaze). Kapija g = a & b daje (~g | a) i
+// (~g | b) ako se koristi pozitivno, a (g | ~a | ~b) ako se koristi negativno (Plaisted-Greenbaum);
+// polariteti se racunaju od izlaza ka ulazima, a negirana grana menja polaritet
+void tseitinAig(const Aig& aig, const std::vector<std::string>& names, AtomTable& atoms, ClauseSink& cnf) {
+    std::vector<unsigned char> polarity(aig.nodes.size());
+    for(std::uint32_t output : aig.outputs)
+        polarity[Aig::node(output)] |= Aig::isComplemented(output) ? Negative : Positive;
+    for(std::size_t n = aig.nodes.size(); n-- > 1;)
+        if(polarity[n] && aig.isAnd(std::uint32_t(n)))
+            for(std::uint32_t l : {aig.nodes[n].left, aig.nodes[n].right})
+                polarity[Aig::node(l)] |= Aig::isComplemented(l) ? flip(Polarity(polarity[n])) : Polarity(polarity[n]);
+
+    std::vector<int> variables(aig.nodes.size());
+    for(std::size_t i = 0; i < aig.inputs.size(); i++)
+        variables[aig.inputs[i]] = atoms.intern(names[i]);
+    auto literal = [&](std::uint32_t l) { return Aig::isComplemented(l) ? -variables[Aig::node(l)] : variables[Aig::node(l)]; };
+    for(std::uint32_t n = 1; n < aig.nodes.size(); n++) {
+        if(!polarity[n] || !aig.isAnd(n))
+            continue;
+        int g = variables[n] = atoms.fresh();
+        int a = literal(aig.nodes[n].left), b = literal(aig.nodes[n].right);
+        if(polarity[n] & Positive) {
+            cnf.add({-g, a});
+            cnf.add({-g, b});
+        }
+        if(polarity[n] & Negative)
+            cnf.add({g, -a, -b});
+    }
+    for(std::uint32_t output : aig.outputs) {
+        if(output == Aig::FalseLiteral)
+            cnf.add(nullptr, 0);
+        else if(output != Aig::TrueLiteral)
+            cnf.add({literal(output)});
+    }
+}
+
+// Prevodjenje klauza sa imenovanim literalima u DIMACS brojeve
+IntNormalForm toDimacs(const NormalForm& f, AtomTable& atoms) {
+    IntNormalForm cnf;
+    cnf.reserve(f.size());
+    for(const auto& clause : f) {
+        IntClause c;
+        c.reserve(clause.size());
+        for(const auto& literal : clause) {
+            int atom = atoms.intern(literal.name);
+            c.push_back(literal.pos ? atom : -atom);
+        }
+        cnf.push_back(std::move(c));
+    }
+    return cnf;
+}
+
+void printDimacs(const IntNormalForm& cnf, int atomCount, std::ostream& out) {
+    DimacsWriter writer(out, atomCount, cnf.size());
+    for(const auto& clause : cnf)
+        writer.add(clause);
+}
+
+// Semanticka jednakost i posledica
+// Formule se najpre porede simulacijom: potpis formule su njene vrednosti za 64 * SimulationWords
+// slucajnih valuacija. Razliciti potpisi dokazuju da formule nisu jednake bez poziva resavaca,
+// a tek kada se potpisi poklope resavac proverava da li je miter ~(f <-> g) nezadovoljiv.
+constexpr int SimulationWords = 4;
+using Signature = std::array<std::uint64_t, SimulationWords>;
+
+struct SignatureHash {
+    std::size_t operator()(const Signature& s) const {
+        std::size_t h = 0;
+        for(std::uint64_t word : s)
+            h = h * 1000003 ^ std::hash<std::uint64_t>()(word);
+        return h;
+    }
+};
+
+// Slucajne vrednosti atoma zavise samo od imena, pa su iste u svim formulama (splitmix64)
+std::uint64_t simulationWord(const std::string& name, int word) {
+    std::uint64_t x = std::hash<std::string>()(name) + 0x9E3779B97F4A7C15ull * (word + 1);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+Signature signature(const FormulaPtr& f) {
+    return foldShared<Signature>(f, [](const FormulaPtr& g, Signature* args) {
+        Signature r{};
+        match(g,
+            [&](const False&) {},
+            [&](const True&) { r.fill(~std::uint64_t(0)); },
+            [&](const Atom& a) {
+                for(int j = 0; j < SimulationWords; j++)
+                    r[j] = simulationWord(a.name, j);
+            },
+            [&](const Not&) {
+                for(int j = 0; j < SimulationWords; j++)
+                    r[j] = ~args[0][j];
+            },
+            [&](const Binary& b) {
+                for(int j = 0; j < SimulationWords; j++)
+                    switch(b.type) {
+                        case Binary::And:  r[j] = args[0][j] & args[1][j]; break;
+                        case Binary::Or:   r[j] = args[0][j] | args[1][j]; break;
+                        case Binary::Impl: r[j] = ~args[0][j] | args[1][j]; break;
+                        case Binary::Eq:   r[j] = ~(args[0][j] ^ args[1][j]); break;
+                    }
+            });
+        return r;
+    });
+}
+
+// Podrazumevani budzet za jedan poziv resavaca u proverama ispod, da jedan tezak par formula
+// ne bi zaustavio npr. deduplikaciju hiljada formula
+constexpr sat::Limits MiterLimits{1.0, 100000};
+
+// Zadovoljivost preko Tseitinove KNF (sa strukturnim hesiranjem, pa se zajednicki delovi
+// formula u miteru kodiraju jednom) i DPLL resavaca; Unknown ako se budzet potrosi
+sat::Result satisfiable(const FormulaPtr& f, const sat::Limits& limits = MiterLimits) {
+    AtomTable atoms;
+    sat::NormalForm cnf = tseitinHashed(f, atoms);
+    sat::Solver solver;
+    solver.limits = limits;
+    return solver.solve(cnf, atoms.count());
+}
+
+// Odgovor provere kada formula nije zadovoljiva; prazno ako resavac nije stigao do odgovora
+std::optional<bool> whenUnsatisfiable(const FormulaPtr& f, const sat::Limits& limits) {
+    sat::Result result = satisfiable(f, limits);
+    if(result == sat::Unknown)
+        return {};
+    return result == sat::Unsat;
+}
+
+FormulaPtr miter(const FormulaPtr& f, const FormulaPtr& g) {
+    return ptr(Not{ptr(Binary{Binary::Eq, f, g})});
+}
+
+std::optional<bool> equivalent(const FormulaPtr& f, const FormulaPtr& g, const sat::Limits& limits = MiterLimits) {
+    if(f == g)
+        return true;
+    if(signature(f) != signature(g))
+        return false;
+    return whenUnsatisfiable(miter(f, g), limits);
+}
+
+// Da li je g logicka posledica formule f
+std::optional<bool> implies(const FormulaPtr& f, const FormulaPtr& g, const sat::Limits& limits = MiterLimits) {
+    if(f == g)
+        return true;
+    Signature sf = signature(f), sg = signature(g);
+    for(int j = 0; j < SimulationWords; j++)
+        if(sf[j] & ~sg[j])
+            return false;
+    return whenUnsatisfiable(ptr(Binary{Binary::And, f, ptr(Not{g})}), limits);
+}
+
+// Ispis odgovora provere: 1, 0 ili ? ako odgovor nije poznat
+std::string verdict(std::optional<bool> answer) {
+    return answer ? (*answer ? "1" : "0") : "?";
+}
+
+// Deli formule na klase semanticki jednakih: za svaku formulu vraca indeks prve formule iz
+// njene klase. Resavac poredi formulu samo sa predstavnicima klasa sa istim potpisom. Kada
+// resavac potrosi budzet, formule se smatraju razlicitim (obe ostaju), a poziv se broji u undecided.
+std::vector<std::size_t> deduplicate(const std::vector<FormulaPtr>& formulas, std::size_t* solverCalls = nullptr,
+                                     std::size_t* undecided = nullptr, const sat::Limits& limits = MiterLimits) {
+    std::unordered_map<Signature, std::vector<std::size_t>, SignatureHash> classes;
+    std::unordered_map<const Formula*, std::size_t> seen;
+    std::vector<std::size_t> representative(formulas.size());
+    std::size_t calls = 0, unknown = 0;
+    for(std::size_t i = 0; i < formulas.size(); i++) {
+        auto [it, inserted] = seen.try_emplace(formulas[i].get(), i);
+        if(!inserted) {
+            representative[i] = representative[it->second];
+            continue;
+        }
+        representative[i] = i;
+        std::vector<std::size_t>& candidates = classes[signature(formulas[i])];
+        for(std::size_t c : candidates) {
+            calls++;
+            sat::Result result = satisfiable(miter(formulas[c], formulas[i]), limits);
+            if(result == sat::Unknown)
+                unknown++;
+            if(result == sat::Unsat) {
+                representative[i] = c;
+                break;
+            }
+        }
+        if(representative[i] == i)
+            candidates.push_back(i);
+    }
+    if(solverCalls)
+        *solverCalls = calls;
+    if(undecided)
+        *undecided = unknown;
+    return representative;
+}
+
+// Binarni zapis formula (dag.h): vrsta cvora je indeks alternative, a za binarne veznike
+// 4 + vrsta veznika. Zbog jedinstvene tabele zajednicke potformule se zapisuju jednom,
+// i to i kada su delovi razlicitih formula.
+constexpr char FormulaFormat[] = "PDAG";
+
+void save(const std::vector<FormulaPtr>& formulas, std::ostream& out) {
+    DagWriter writer(FormulaFormat);
+    std::unordered_map<const Formula*, std::uint32_t> indices;
+    auto child = [&](const FormulaPtr* g, int i) -> std::optional<const FormulaPtr*> {
+        if(indices.contains(g->get()))
+            return {};
+        if(const FormulaPtr* sub = subformula(*g, i))
+            return sub;
+        return {};
+    };
+    auto combine = [&](const FormulaPtr* g, std::uint32_t* args) -> std::uint32_t {
+        auto [it, inserted] = indices.try_emplace(g->get(), 0);
+        if(!inserted)
+            return it->second;
+        std::uint8_t kind = std::uint8_t((*g)->index());
+        it->second = match(*g,
+            [&](const Atom& a) { return writer.add(kind, a.name, {}); },
+            [&](const Not&) { return writer.add(kind, {}, {args[0]}); },
+            [&](const Binary& b) { return writer.add(std::uint8_t(kind + b.type), {}, {args[0], args[1]}); },
+            [&](const auto&) { return writer.add(kind, {}, {}); });
+        return it->second;
+    };
+    for(const FormulaPtr& f : formulas)
+        writer.root(fold<std::uint32_t>(&f, child, combine));
+    writer.write(out);
+}
+
+// Otvara zapis i proverava da su vrste cvorova i broj dece ispravni,
+// pa load i evaluate nad zapisom ne moraju nista da proveravaju
+bool openFormulas(DagImage& image, std::string_view bytes) {
+    if(!image.open(bytes, FormulaFormat))
+        return false;
+    for(std::uint32_t i = 0; i < image.nodeCount; i++) {
+        DagNode node = image.node(i);
+        static constexpr std::uint32_t arity[] = {0, 0, 0, 1, 2, 2, 2, 2};
+        if(node.kind >= 8 || node.childCount != arity[node.kind] || node.symbol.empty() != (node.kind != 2))
+            return false;
+    }
+    return true;
+}
+
+// Pravi cvorove iz zapisa; kroz jedinstvenu tabelu, pa su formule isti cvorovi kao pre cuvanja
+void load(const DagImage& image, std::vector<FormulaPtr>& formulas) {
+    std::vector<FormulaPtr> nodes(image.nodeCount);
+    for(std::uint32_t i = 0; i < image.nodeCount; i++) {
+        DagNode node = image.node(i);
+        if(node.kind == 0)
+            nodes[i] = ptr(False{});
+        else if(node.kind == 1)
+            nodes[i] = ptr(True{});
+        else if(node.kind == 2)
+            nodes[i] = ptr(Atom{std::string(node.symbol)});
+        else if(node.kind == 3)
+            nodes[i] = ptr(Not{nodes[node.child()]});
+        else {
+            const FormulaPtr& left = nodes[node.child()];
+            nodes[i] = ptr(Binary{Binary::Type(node.kind - 4), left, nodes[node.child()]});
+        }
+    }
+    for(std::uint32_t i = 0; i < image.rootCount; i++)
+        formulas.push_back(nodes[image.root(i)]);
+}
+
+// Vrednost formule direktno nad zapisom, bez pravljenja cvorova: cvorovi su u topoloskom
+// redosledu, pa je dovoljan jedan prolaz do korena (atomi kojih nema u valuaciji su netacni)
+bool evaluate(const DagImage& image, std::uint32_t root, const Valuation& v) {
+    std::vector<std::uint8_t> values(root + 1);
+    for(std::uint32_t i = 0; i <= root; i++) {
+        DagNode node = image.node(i);
+        switch(node.kind) {
+            case 0: values[i] = 0; break;
+            case 1: values[i] = 1; break;
+            case 2: {
+                auto it = v.find(std::string(node.symbol));
+                values[i] = it != v.end() && it->second;
+                break;
+            }
+            case 3: values[i] = !values[node.child()]; break;
+            default: {
+                bool left = values[node.child()], right = values[node.child()];
+                switch(Binary::Type(node.kind - 4)) {
+                    case Binary::And:  values[i] = left && right; break;
+                    case Binary::Or:   values[i] = left || right; break;
+                    case Binary::Impl: values[i] = !left || right; break;
+                    case Binary::Eq:   values[i] = left == right; break;
+                }
+            }
+        }
+    }
+    return values[root];
+}
+
+// Formula poznata u vreme prevodjenja (static_formula.h), gde mesto i postaje atoms[i].
+// Jednake potformule su isti cvor, pa je npr. toFormula(staticNnf<F>) isti cvor kao nnf(toFormula(F))
+template<std::size_t N>
+FormulaPtr toFormula(const StaticFormula<N>& f, const std::vector<FormulaPtr>& atoms) {
+    std::vector<FormulaPtr> nodes(N);
+    for(std::size_t i = 0; i < N; i++) {
+        const StaticNode& n = f.nodes[i];
+        switch(n.op) {
+            case StaticOp::False: nodes[i] = ptr(False{}); break;
+            case StaticOp::True:  nodes[i] = ptr(True{}); break;
+            case StaticOp::Atom:  nodes[i] = atoms[n.a]; break;
+            case StaticOp::Not:   nodes[i] = ptr(Not{nodes[n.a]}); break;
+            default:
+                nodes[i] = ptr(Binary{Binary::Type(int(n.op) - int(StaticOp::And)), nodes[n.a], nodes[n.b]});
+        }
+    }
+    return nodes.back();
+}
+
+// Obrnuto: formula u istom zapisu (deljeni cvor se zapisuje jednom), a u atoms se redom
+// dodaju imena mesta. Zapis se evaluira sa evaluate(nodes, values) bez obilaska cvorova Formula
+std::vector<StaticNode> fromFormula(const FormulaPtr& f, std::vector<std::string>& atoms) {
+    std::vector<StaticNode> nodes;
+    std::unordered_map<std::string, int> slots;
+    foldShared<int>(f, [&](const FormulaPtr& g, int* args) {
+        nodes.push_back(match(g,
+            [](const False&) { return StaticNode{StaticOp::False}; },
+            [](const True&) { return StaticNode{StaticOp::True}; },
+            [&](const Atom& a) {
+                auto [it, inserted] = slots.try_emplace(a.name, int(atoms.size()));
+                if(inserted)
+                    atoms.push_back(a.name);
+                return StaticNode{StaticOp::Atom, it->second};
+            },
+            [&](const Not&) { return StaticNode{StaticOp::Not, args[0]}; },
+            [&](const Binary& b) { return StaticNode{StaticOp(int(StaticOp::And) + int(b.type)), args[0], args[1]}; }));
+        return int(nodes.size() - 1);
+    });
+    return nodes;
+}
+
+// Slucajna formula sa priblizno nodeCount cvorova (negacije, konjunkcije, disjunkcije i implikacije)
+// Cvorove spajamo nasumicno pa je dubina formule logaritamska
+FormulaPtr randomFormula(int nodeCount, int atomCount, std::mt19937& rng) {
+    std::vector<FormulaPtr> pool;
+    std::vector<FormulaPtr> atoms;
+    for(int i = 1; i <= atomCount; i++)
+        atoms.push_back(ptr(Atom{"p" + std::to_string(i)}));
+
+    int leafCount = nodeCount * 2 / 5;
+    for(int i = 0; i < leafCount; i++)
+        pool.push_back(atoms[rng() % atoms.size()]);
+
+    while(pool.size() > 1) {
+        std::swap(pool[rng() % pool.size()], pool.back());
+        FormulaPtr l = pool.back();
+        pool.pop_back();
+        std::swap(pool[rng() % pool.size()], pool.back());
+        FormulaPtr r = pool.back();
+        pool.pop_back();
+        auto type = Binary::Type(rng() % 3);
+        FormulaPtr f = ptr(Binary{type, l, r});
+        if(rng() % 2 == 0)
+            f = ptr(Not{f});
+        pool.push_back(f);
+    }
+    return pool.back();
+}
+
+template<typename Function>
+double measure(Function function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchmarkTseitin(int nodeCount, int atomCount) {
+    std::mt19937 rng(42);
+    FormulaPtr f = randomFormula(nodeCount, atomCount, rng);
+    std::cout << "Connectives: " << complexity(f) << std::endl;
+
+    std::size_t stringClauses = 0, intClauses = 0, pgClauses = 0, hashedClauses = 0;
+    double stringTime = measure([&]() {
+        AtomTable atoms;
+        stringClauses = toDimacs(tseitin(f), atoms).size();
+    });
+    double intTime = measure([&]() {
+        AtomTable atoms;
+        intClauses = tseitinInt(f, atoms).size();
+    });
+    double pgTime = measure([&]() {
+        AtomTable atoms;
+        pgClauses = plaistedGreenbaum(f, atoms).size();
+    });
+    double hashedTime = measure([&]() {
+        AtomTable atoms;
+        hashedClauses = tseitinHashed(f, atoms).size();
+    });
+    std::cout << "String Tseitin + DIMACS: " << stringTime << "s, " << stringClauses << " clauses" << std::endl;
+    std::cout << "Integer Tseitin: " << intTime << "s, " << intClauses << " clauses" << std::endl;
+    std::cout << "Plaisted-Greenbaum: " << pgTime << "s, " << pgClauses << " clauses" << std::endl;
+    std::cout << "Structural hashing: " << hashedTime << "s, " << hashedClauses << " clauses" << std::endl;
+
+    CountingSink counter;
+    double streamTime = measure([&]() {
+        AtomTable atoms;
+        plaistedGreenbaum(f, atoms, counter);
+    });
+    std::cout << "Plaisted-Greenbaum, counting only: " << streamTime << "s, " << counter.clauseCount << " clauses" << std::endl;
+}
+
+// Vreme i broj napravljenih cvorova za pojedinacne transformacije
+// Formula je konjunkcija malih formula, da KNF ne bi eksplodirala
+void benchmarkNormalForms(int conjunctCount) {
+    std::mt19937 rng(42);
+    {
+        // Cvorovi ovog problema su u posebnoj areni, koja se vraca sistemu na kraju bloka
+        ArenaScope scope;
+        NodeArena& arena = *scope.arena;
+        auto stage = [&](const char* name, auto function) {
+            std::size_t before = arena.allocated;
+            double time = measure(function);
+            std::cout << name << ": " << time << "s, " << arena.allocated - before << " nodes allocated" << std::endl;
+        };
+        FormulaPtr f = ptr(True{}), simplified, negationNormal;
+        NormalForm clauses;
+        stage("Build", [&]() {
+            for(int i = 0; i < conjunctCount; i++)
+                f = ptr(Binary{Binary::And, randomFormula(8, 50, rng), f});
+        });
+        stage("Simplify", [&]() { simplified = simplify(f); });
+        stage("NNF", [&]() { negationNormal = nnf(simplified); });
+        stage("CNF", [&]() { clauses = cnf(negationNormal); });
+        std::cout << clauses.size() << " clauses, " << arena.blocks.size() << " arena blocks" << std::endl;
+    }
+    std::cout << "Problem arena released: " << uniqueTable().scopes.empty() << std::endl;
+    std::cout << "Arena released: " << releaseFormulas() << std::endl;
+}
+
+// Cela obrada jedne formule, faza po faza, sa merenjem (stats.h): uproscavanje, NNF,
+// KNF distributivnoscu, Plaisted-Greenbaum, resavanje i AIG. Izvestaj je JSON
+void profilePipeline(int conjunctCount, std::ostream& out) {
+    std::mt19937 rng(42);
+    StatsReport report;
+    {
+        FormulaPtr f = ptr(True{}), simplified, negationNormal;
+        {
+            STATS_STAGE(report, "build");
+            for(int i = 0; i < conjunctCount; i++)
+                f = ptr(Binary{Binary::And, randomFormula(8, 50, rng), f});
+            STATS_OUTPUT(outputNodes, dagSize(f));
+        }
+        {
+            STATS_STAGE(report, "simplify");
+            simplified = simplify(f);
+            STATS_OUTPUT(outputNodes, dagSize(simplified));
+        }
+        {
+            STATS_STAGE(report, "nnf");
+            negationNormal = nnf(simplified);
+            STATS_OUTPUT(outputNodes, dagSize(negationNormal));
+        }
+        {
+            STATS_STAGE(report, "cnf");
+            NormalForm normalForm = cnf(negationNormal);
+            AtomSet atoms;
+            STATS_OUTPUT(clauses, normalForm.size());
+            STATS_OUTPUT(variables, (getAtoms(negationNormal, atoms), atoms.size()));
+        }
+        AtomTable atoms;
+        IntNormalForm encoded;
+        {
+            STATS_STAGE(report, "tseitin");
+            encoded = plaistedGreenbaum(simplified, atoms);
+            STATS_OUTPUT(clauses, encoded.size());
+            STATS_OUTPUT(variables, atoms.count());
+        }
+        {
+            STATS_STAGE(report, "solve");
+            sat::Solver solver;
+            solver.solve(encoded, atoms.count());
+            STATS_OUTPUT(clauses, encoded.size());
+            STATS_OUTPUT(variables, atoms.count());
+        }
+        std::vector<std::string> names;
+        Aig aig;
+        {
+            STATS_STAGE(report, "aig");
+            aig = optimize(toAig(simplified, names));
+            STATS_OUTPUT(outputNodes, aig.andCount());
+        }
+        {
+            STATS_STAGE(report, "tseitin aig");
+            AtomTable aigAtoms;
+            CountingSink sink;
+            tseitinAig(aig, names, aigAtoms, sink);
+            STATS_OUTPUT(clauses, sink.clauseCount);
+            STATS_OUTPUT(variables, aigAtoms.count());
+        }
+    }
+    report.json(out);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1 && std::string(argv[1]) == "--bench-nf") {
+        benchmarkNormalForms(argc > 2 ? std::stoi(argv[2]) : 100000);
+        return 0;
+    }
+    // Izvestaj o fazama obrade: tseitin --stats [broj konjunkata] [fajl]
+    if(argc > 1 && std::string(argv[1]) == "--stats") {
+#ifndef FORMULA_STATS
+        std::cerr << "--stats needs a build with -DFORMULA_STATS=ON" << std::endl;
+        return 1;
+#endif
+        int conjunctCount = argc > 2 ? std::stoi(argv[2]) : 10000;
+        if(argc > 3) {
+            std::ofstream output(argv[3]);
+            profilePipeline(conjunctCount, output);
+        } else
+            profilePipeline(conjunctCount, std::cout);
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--bench") {
+        benchmarkTseitin(argc > 2 ? std::stoi(argv[2]) : 1000000, argc > 3 ? std::stoi(argv[3]) : 1000);
+        return 0;
+    }
+    // Klauze se upisuju u fajl tokom kodiranja, bez cuvanja cele KNF u memoriji
+    if(argc > 2 && std::string(argv[1]) == "--dimacs") {
+        std::mt19937 rng(42);
+        FormulaPtr f = randomFormula(argc > 3 ? std::stoi(argv[3]) : 1000000, 1000, rng);
+        std::ofstream output(argv[2], std::ios::binary);
+        AtomTable atoms;
+        DimacsWriter writer(output);
+        plaistedGreenbaum(f, atoms, writer);
+        writer.close();
+        std::cout << writer.atomCount << " atoms, " << writer.clauseCount << " clauses" << std::endl;
+        return 0;
+    }
+
     FormulaPtr p = ptr(Atom{"p"});
     FormulaPtr q = ptr(Atom{"q"});
     FormulaPtr pAndq = ptr(Binary{Binary::And, p, q});
@@ -388,6 +2005,10 @@ int main() {
     Valuation v = {{"p", true}, {"q", false}};
     std::cout << (evaluate(pAndq, v) ? "True" : "False") << std::endl;
 
+    // Strukturno jednake formule su isti cvor
+    FormulaPtr pAndq2 = ptr(Binary{Binary::And, ptr(Atom{"p"}), ptr(Atom{"q"})});
+    std::cout << "Same node: " << (pAndq == pAndq2) << std::endl;
+
     table(pAndq);
 
     auto satV = isSatisfiable(pAndq);
@@ -428,6 +2049,114 @@ int main() {
     std::cout << "CNF: ";
     print(cnfFormula);
 
+    AtomTable atoms;
+    IntNormalForm dimacs = tseitinInt(notFormula, atoms);
+    printDimacs(dimacs, atoms.count(), std::cout);
+
+    AtomTable pgAtoms;
+    IntNormalForm pg = plaistedGreenbaum(notFormula, pgAtoms);
+    printDimacs(pg, pgAtoms.count(), std::cout);
+
+    // (p & q) | ~(~q | ~p) se svodi na jednu kapiju
+    FormulaPtr shared = ptr(Binary{Binary::Or, pAndq, ptr(Not{ptr(Binary{Binary::Or, ptr(Not{q}), ptr(Not{p})})})});
+    AtomTable hashedAtoms;
+    IntNormalForm hashed = tseitinHashed(shared, hashedAtoms);
+    printDimacs(hashed, hashedAtoms.count(), std::cout);
+
+    // Duboka formula: p0 & (p1 & (p2 & ...)) sa milion atoma
+    FormulaPtr deep = ptr(True{});
+    for(int i = 0; i < 1000000; i++)
+        deep = ptr(Binary{Binary::And, ptr(Atom{"p" + std::to_string(i % 100)}), deep});
+    AtomTable deepAtoms;
+    CountingSink deepCounter;
+    plaistedGreenbaum(deep, deepAtoms, deepCounter);
+    std::cout << "Deep formula: " << tseitin(deep).size() << " clauses, "
+              << deepCounter.clauseCount << " clauses with Plaisted-Greenbaum" << std::endl;
+
+    std::cout << "Equivalent: " << verdict(equivalent(ptr(Binary{Binary::Impl, p, q}), ptr(Binary{Binary::Or, ptr(Not{p}), q})))
+              << ' ' << verdict(equivalent(p, q)) << ", implies: " << verdict(implies(pAndq, p)) << ' '
+              << verdict(implies(p, pAndq)) << std::endl;
+
+    // Mnogo slucajnih formula nad malo atoma: vecina je jednaka nekoj ranijoj
+    std::mt19937 rng(42);
+    std::vector<FormulaPtr> formulas;
+    for(int i = 0; i < 2000; i++)
+        formulas.push_back(randomFormula(6, 3, rng));
+    std::size_t solverCalls = 0, undecided = 0;
+    std::vector<std::size_t> classes = deduplicate(formulas, &solverCalls, &undecided);
+    std::size_t classCount = 0;
+    for(std::size_t i = 0; i < classes.size(); i++)
+        classCount += classes[i] == i;
+    std::cout << "Deduplicated " << formulas.size() << " formulas into " << classCount << " classes, "
+              << solverCalls << " solver calls, " << undecided << " undecided" << std::endl;
+
+    // Binarni zapis: formule i NNF duboke formule se cuvaju u bafer u memoriji, pa se citaju iz
+    // njega (isto kao iz fajla mapiranog u memoriju, vidi MappedFile)
+    std::vector<FormulaPtr> saved = formulas;
+    saved.push_back(nnf(ptr(Not{deep})));
+    std::stringstream buffer;
+    save(saved, buffer);
+    std::string bytes = buffer.str();
+    DagImage image;
+    std::vector<FormulaPtr> loaded;
+    if(openFormulas(image, bytes)) {
+        load(image, loaded);
+        std::cout << "Binary DAG: " << image.nodeCount << " nodes, " << bytes.size() << " bytes, same formulas: "
+                  << (loaded == saved) << ", value " << evaluate(image, image.root(image.rootCount - 1), v) << std::endl;
+    }
+
+    // Formula poznata u vreme prevodjenja (korak brojaca iz 05_minisat/brojac.cpp): NNF i KNF
+    // su izracunate tokom prevodjenja, a evaluacija je niz naredbi
+    constexpr auto increment = eq(slot(3), ~slot(1)) & eq(slot(2), ~eq(slot(0), slot(1)));
+    std::vector<FormulaPtr> counterAtoms = {ptr(Atom{"p1"}), ptr(Atom{"q1"}), ptr(Atom{"p2"}), ptr(Atom{"q2"})};
+    FormulaPtr counterStep = toFormula(increment, counterAtoms);
+    std::vector<std::string> slotNames;
+    std::vector<StaticNode> converted = fromFormula(counterStep, slotNames);
+    bool sameValues = true;
+    for(int m = 0; m < 16; m++) {
+        bool values[4];
+        Valuation counterValuation;
+        for(int i = 0; i < 4; i++)
+            counterValuation[print(counterAtoms[i])] = values[i] = (m >> i) & 1;
+        std::vector<bool> convertedValues;
+        for(const std::string& name : slotNames)
+            convertedValues.push_back(counterValuation[name]);
+        bool value = evaluate<increment>(values);
+        sameValues &= value == evaluate(counterStep, counterValuation) && value == evaluate(converted, convertedValues);
+    }
+    std::cout << "Static formula: " << print(counterStep) << std::endl;
+    std::cout << "Static NNF same node: " << (toFormula(staticNnf<increment>, counterAtoms) == nnf(counterStep))
+              << ", CNF " << staticCnf<increment>.clauseCount << " clauses (runtime " << cnf(nnf(counterStep)).size()
+              << "), same values: " << sameValues << std::endl;
+
+    // AIG: slucajna formula nad malo atoma ima mnogo suvisnih kapija
+    std::mt19937 aigRng(7);
+    FormulaPtr redundant = randomFormula(3000, 8, aigRng);
+    std::vector<std::string> aigNames;
+    Aig aig = toAig(redundant, aigNames);
+    std::vector<AigStep> steps;
+    Aig optimized = optimize(aig, &steps);
+    std::cout << "AIG: " << dagSize(redundant) << " formula nodes, " << aig.andCount() << " ands, depth " << aig.depth();
+    for(const AigStep& step : steps)
+        std::cout << " -> " << step.pass << ": " << step.ands << " ands, depth " << step.depth;
+    std::cout << std::endl;
+    AtomTable aigAtoms, optimizedAtoms, formulaAtoms;
+    CountingSink aigClauses, optimizedClauses, formulaClauses;
+    tseitinAig(aig, aigNames, aigAtoms, aigClauses);
+    tseitinAig(optimized, aigNames, optimizedAtoms, optimizedClauses);
+    plaistedGreenbaum(redundant, formulaAtoms, formulaClauses);
+    FormulaPtr minimized = toFormula(optimized, optimized.outputs[0], aigNames);
+    std::cout << "AIG CNF: " << formulaClauses.clauseCount << " clauses from formula, " << aigClauses.clauseCount
+              << " from AIG, " << optimizedClauses.clauseCount << " optimized; back to formula: "
+              << dagSize(minimized) << " nodes, equivalent: " << verdict(equivalent(minimized, redundant)) << std::endl;
+
+    // Duboka formula: balansiranje uklanja ponovljene atome i smanjuje dubinu
+    std::vector<std::string> deepNames;
+    Aig deepAig = toAig(deep, deepNames);
+    Aig balanced = balance(deepAig);
+    std::cout << "Deep AIG: " << deepAig.andCount() << " ands, depth " << deepAig.depth() << " -> balanced: "
+              << balanced.andCount() << " ands, depth " << balanced.depth() << std::endl;
+
     return 0;
 }
 
@@ -1,12 +1,13 @@
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <map>
-
-using Clause = std::vector<int>;
-using NormalForm = std::vector<Clause>;
+#include "../04_sat/dimacs.h"
+#include "../04_sat/static_formula.h"
 
 int atomCount = 0;
-NormalForm cnf;
+// Klauze se ne cuvaju, vec se odmah prosledjuju odredistu (brojanje ili ispis)
+ClauseSink* cnf = nullptr;
 
 std::map<int, int> pi;
 std::map<int, int> qi;
@@ -24,44 +25,46 @@ int q(int i) {
     return qi[i];
 }
 
-void clause(const Clause& c) {
-    cnf.push_back(c);
-}
+// Ogranicenja su formule nad mestima p(i), q(i), p(j), q(j), pa se njihove KNF
+// racunaju tokom prevodjenja (../04_sat/static_formula.h)
+constexpr auto pI = slot(0), qI = slot(1), pJ = slot(2), qJ = slot(3);
+
+// Brojac (p, q) u koraku j je za jedan veci nego u koraku i (po modulu 4)
+constexpr auto increment = eq(qJ, ~qI) & eq(pJ, ~eq(pI, qI));
+// Stanja u koracima i i j su razlicita
+constexpr auto different = ~(eq(pI, pJ) & eq(qI, qJ));
+
+static_assert(staticNormalFormsAgree<increment>() && staticCnf<increment>.clauseCount == 6);
+static_assert(staticNormalFormsAgree<different>() && staticCnf<different>.clauseCount == 4);
 
 void R(int i, int j) {
-    clause({-q(j), -q(i)});
-    clause({q(j), q(i)});
-    clause({-p(j), p(i), q(i)});
-    clause({-p(j), -p(i), -q(i)});
-    clause({p(j), p(i), -q(i)});
-    clause({p(j), -p(i), q(i)});
+    addClauses<increment>(*cnf, {p(i), q(i), p(j), q(j)});
 }
 
 void nJ(int i, int j) {
-    clause({p(i), p(j), q(i), q(j)});
-    clause({p(i), p(j), -q(i), -q(j)});
-    clause({-p(i), -p(j), q(i), q(j)});
-    clause({-p(i), -p(j), -q(i), -q(j)});
+    addClauses<different>(*cnf, {p(i), q(i), p(j), q(j)});
 }
 
-int main() {
+void encode(ClauseSink& sink) {
+    cnf = &sink;
     R(1, 2);
     R(2, 3);
     R(3, 4);
     R(4, 5);
     nJ(1, 5);
+}
 
-    std::cout << "p cnf " << atomCount << " " << cnf.size() << std::endl;
-    for(const auto& c : cnf) {
-        for(const auto& l : c)
-            std::cout << l << " ";
-        std::cout << 0 << std::endl;
+int main(int argc, char* argv[]) {
+    // Pisemo u jednom prolazu, a zaglavlje se popunjava na kraju (../04_sat/dimacs.h)
+    if(argc > 1) {
+        std::ofstream output(argv[1]);
+        DimacsWriter writer(output);
+        encode(writer);
+        return 0;
     }
 
+    DimacsWriter writer(std::cout);
+    encode(writer);
+
     return 0;
 }
-
-
-
-
-
@@ -1,15 +1,24 @@
 #ifndef FOL_H
 #define FOL_H
 
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include "../04_sat/dag.h"
+
 // Definisemo strukture za opisivanje termova
 // Term moze biti
 // 1. Promenljiva (npr. x)
@@ -59,17 +68,177 @@ struct Quantifier {
 
 // Pomocne funkcije
 
+// Arena za cvorove formula i termova: memorija se uzima od sistema u velikim blokovima, pa je
+// pravljenje cvora obicno samo pomeranje pokazivaca. Memorija unistenog cvora se vraca u listu slobodnih
+// mesta njegove velicine i koristi za sledeci cvor te velicine, pa arena ne raste dok ne raste
+// broj zivih cvorova. Blokovi se vracaju sistemu odjednom (clear) kada u areni nema zivih cvorova.
+struct NodeArena {
+    static constexpr std::size_t BlockSize = 1 << 16;
+    // Mesta su poravnata na Granule bajtova; mesta do SizeClasses * Granule bajtova se ponovo koriste
+    static constexpr std::size_t Granule = 16;
+    static constexpr std::size_t SizeClasses = 16;
+
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::size_t used = BlockSize;
+    std::size_t allocated = 0;
+    std::atomic<std::size_t> live = 0;
+    // Arena iz ArenaScope koji je zavrsen: oslobadja se cim u njoj vise nema zivih cvorova
+    bool retired = false;
+    // Slobodna mesta po velicini. Cvor moze da se unisti u bilo kojoj niti, pa se njegovo mesto
+    // atomicno dodaje u returned; allocate (pod bravom pozivaoca) preuzima celu tu listu odjednom
+    // kada mu ponestane mesta u free, pa mesto iz liste skida samo jedna nit u svakom trenutku.
+    std::array<FreeSlot*, SizeClasses> free{};
+    std::array<std::atomic<FreeSlot*>, SizeClasses> returned{};
+
+    static std::size_t sizeClass(std::size_t size, std::size_t align) {
+        return align <= Granule ? (size + Granule - 1) / Granule - 1 : SizeClasses;
+    }
+
+    void* allocate(std::size_t size, std::size_t align) {
+        allocated++;
+        live++;
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            if(!free[c])
+                free[c] = returned[c].exchange(nullptr, std::memory_order_acquire);
+            if(FreeSlot* slot = free[c]) {
+                free[c] = slot->next;
+                return slot;
+            }
+            size = (c + 1) * Granule;
+            align = Granule;
+        }
+        used = (used + align - 1) / align * align;
+        if(used + size > BlockSize) {
+            blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(BlockSize));
+            used = 0;
+        }
+        void* p = blocks.back().get() + used;
+        used += size;
+        return p;
+    }
+
+    void deallocate(void* p, std::size_t size, std::size_t align) {
+        if(std::size_t c = sizeClass(size, align); c < SizeClasses) {
+            FreeSlot* slot = new(p) FreeSlot{returned[c].load(std::memory_order_relaxed)};
+            while(!returned[c].compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {}
+        }
+        live--;
+    }
+
+    bool clear() {
+        if(live > 0)
+            return false;
+        blocks.clear();
+        used = BlockSize;
+        free.fill(nullptr);
+        for(auto& list : returned)
+            list.store(nullptr, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+// Arena u koju ova nit smesta nove cvorove (vidi ArenaScope); nullptr je zajednicka arena
+inline thread_local NodeArena* scopeArena = nullptr;
+
+// Alokator preko kog std::allocate_shared smesta cvor zajedno sa brojacem referenci u arenu
+template<typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    NodeArena* arena;
+
+    explicit ArenaAllocator(NodeArena* arena) : arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, std::size_t n) { arena->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+};
+
+struct NodePool {
+    std::mutex mutex;
+    NodeArena arena;
+    // Arene iz ArenaScope, i zavrsene dok u njima jos ima zivih cvorova
+    std::vector<std::unique_ptr<NodeArena>> scopes;
+
+    // Oslobadja arene zavrsenih ArenaScope u kojima vise nema zivih cvorova
+    void sweep() {
+        std::erase_if(scopes, [](const auto& scope) { return scope->retired && scope->live == 0; });
+    }
+};
+
+NodePool& nodePool() {
+    static NodePool pool;
+    return pool;
+}
+
+template<typename T>
+std::shared_ptr<T> allocateNode(T node) {
+    NodePool& pool = nodePool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return std::allocate_shared<T>(ArenaAllocator<T>(scopeArena ? scopeArena : &pool.arena), std::move(node));
+}
+
 // ptr Pravi pokazivac na formulu/term
-TermPtr ptr(const Term& term) { return std::make_shared<Term>(term); }
-FormulaPtr ptr(const Formula& formula) { return std::make_shared<Formula>(formula); }
+TermPtr ptr(Term term) { return allocateNode(std::move(term)); }
+FormulaPtr ptr(Formula formula) { return allocateNode(std::move(formula)); }
+
+// releaseNodes Vraca svu memoriju formula i termova odjednom (uspeva samo ako nijedan cvor nije ziv)
+bool releaseNodes() {
+    NodePool& pool = nodePool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.sweep();
+    return pool.arena.clear();
+}
+
+// Arena jednog problema: dok je ArenaScope ziv, nove formule i termove ova nit smesta u njegovu
+// arenu. Kada se zavrsi, arena se vraca sistemu cim u njoj vise nema zivih cvorova, i kada su
+// cvorovi drugih problema jos zivi, sto releaseNodes ne moze.
+struct ArenaScope {
+    NodeArena* arena;
+    NodeArena* previous;
+
+    ArenaScope() {
+        NodePool& pool = nodePool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        arena = pool.scopes.emplace_back(std::make_unique<NodeArena>()).get();
+        previous = std::exchange(scopeArena, arena);
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ~ArenaScope() {
+        scopeArena = previous;
+        NodePool& pool = nodePool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        arena->retired = true;
+        pool.sweep();
+    }
+};
 
 // is Proverava da li je formula/term odredjenog tipa
 template<typename T> bool is(const TermPtr& term) { return std::holds_alternative<T>(*term); }
 template<typename T> bool is(const FormulaPtr& formula) { return std::holds_alternative<T>(*formula); }
 
-// as Pretvara formulu/term u odredjeni tip
-template<typename T> T as(const TermPtr& term) { return std::get<T>(*term); }
-template<typename T> T as(const FormulaPtr& formula) { return std::get<T>(*formula); }
+// as Vraca referencu na formulu/term odredjenog tipa (bez kopiranja)
+template<typename T> const T& as(const TermPtr& term) { return std::get<T>(*term); }
+template<typename T> const T& as(const FormulaPtr& formula) { return std::get<T>(*formula); }
+
+// match Grana po vrsti formule/terma: std::visit poziva lambdu za alternativu koju cvor sadrzi
+// (po referenci, bez kopiranja) jednim skokom po indeksu, umesto niza provera is<T>
+template<typename... Cases>
+struct Overloaded : Cases... { using Cases::operator()...; };
+template<typename... Cases>
+decltype(auto) match(const TermPtr& term, Cases... cases) { return std::visit(Overloaded{cases...}, *term); }
+template<typename... Cases>
+decltype(auto) match(const FormulaPtr& formula, Cases... cases) { return std::visit(Overloaded{cases...}, *formula); }
 
 
 // Definisemo strukture za opisivanje signature i interpretacije
@@ -117,24 +286,18 @@ bool checkSignature(const TermPtr& term, const Signature& s) {
 }
 
 bool checkSignature(const FormulaPtr& formula, const Signature& s) {
-    if(is<Atom>(formula)) {
-        const auto& atom = as<Atom>(formula);
-        if(!s.relations.contains(atom.symbol))
-            return false;
-        for(const auto& arg : atom.args)
-            if(!checkSignature(arg, s))
+    return match(formula,
+        [&](const Atom& atom) {
+            if(!s.relations.contains(atom.symbol))
                 return false;
-        return true;
-    }
-    if(is<Not>(formula))
-        return checkSignature(as<Not>(formula).subformula, s);
-    if(is<Binary>(formula)) {
-        const auto& binary = as<Binary>(formula);
-        return checkSignature(binary.l, s) && checkSignature(binary.r, s);
-    }
-    if(is<Quantifier>(formula))
-        return checkSignature(as<Quantifier>(formula).subformula, s);
-    return false;
+            for(const auto& arg : atom.args)
+                if(!checkSignature(arg, s))
+                    return false;
+            return true;
+        },
+        [&](const Not& n) { return checkSignature(n.subformula, s); },
+        [&](const Binary& binary) { return checkSignature(binary.l, s) && checkSignature(binary.r, s); },
+        [&](const Quantifier& qf) { return checkSignature(qf.subformula, s); });
 }
 
 // Evaluacija formule
@@ -157,44 +320,41 @@ unsigned evaluate(const TermPtr& term, const LStructure& s, const Valuation& val
 }
 
 bool evaluate(const FormulaPtr& formula, const LStructure& s, const Valuation& val) {
-    // Ako je atomicna formula, evaluiramo argumente i primenjujemo relaciju iz interpretacije
-    if (is<Atom>(formula)) {
-        const auto& atom = as<Atom>(formula);
-        std::vector<unsigned> args;
-        for(const auto& arg : atom.args)
-            args.push_back(evaluate(arg, s, val));
-        return s.relations.at(atom.symbol)(args);
-    }
-    if (is<Not>(formula))
-        return !evaluate(as<Not>(formula).subformula, s, val);
-    if (is<Binary>(formula)) {
-        auto binary = as<Binary>(formula);
-        bool lEval = evaluate(binary.l, s, val);
-        bool rEval = evaluate(binary.r, s, val);
-        switch(binary.type) {
-            case Binary::And:  return lEval && rEval;
-            case Binary::Or:   return lEval || rEval;
-            case Binary::Impl: return !lEval || rEval;
-            case Binary::Eq:  return lEval == rEval;
-        }
-    }
-    if (is<Quantifier>(formula)) {
-        auto qf = as<Quantifier>(formula);
-        // Ako je univerzalni kvantifikator, provedemo evaluaciju za svaku vrednost iz domena
-        if(qf.type == Quantifier::All) {
-            // Pravimo kopiju valuacije (nije efikasno, ali nam je okej)
-            Valuation valQuantified(val);
-            // Za svaku vrednost domena postavljamo vrednost promenljiive i evaluiramo potformulu
-            for(const auto& value : s.domain) {
-                valQuantified[qf.var] = value;
-                if(!evaluate(qf.subformula, s, valQuantified))
-                    return false;
+    return match(formula,
+        // Ako je atomicna formula, evaluiramo argumente i primenjujemo relaciju iz interpretacije
+        [&](const Atom& atom) {
+            std::vector<unsigned> args;
+            for(const auto& arg : atom.args)
+                args.push_back(evaluate(arg, s, val));
+            return s.relations.at(atom.symbol)(args);
+        },
+        [&](const Not& n) { return !evaluate(n.subformula, s, val); },
+        [&](const Binary& binary) {
+            bool lEval = evaluate(binary.l, s, val);
+            bool rEval = evaluate(binary.r, s, val);
+            switch(binary.type) {
+                case Binary::And:  return lEval && rEval;
+                case Binary::Or:   return lEval || rEval;
+                case Binary::Impl: return !lEval || rEval;
+                case Binary::Eq:  return lEval == rEval;
             }
-            // Ako je svaka vrednost domena zadovoljila formulu, vracamo true
-            return true;
-        }
-        // Ako je egzistencijalni kvantifikator, provedemo evaluaciju za svaku vrednost iz domena
-        if(qf.type == Quantifier::Exists) {
+            return false;
+        },
+        [&](const Quantifier& qf) {
+            // Ako je univerzalni kvantifikator, provedemo evaluaciju za svaku vrednost iz domena
+            if(qf.type == Quantifier::All) {
+                // Pravimo kopiju valuacije (nije efikasno, ali nam je okej)
+                Valuation valQuantified(val);
+                // Za svaku vrednost domena postavljamo vrednost promenljiive i evaluiramo potformulu
+                for(const auto& value : s.domain) {
+                    valQuantified[qf.var] = value;
+                    if(!evaluate(qf.subformula, s, valQuantified))
+                        return false;
+                }
+                // Ako je svaka vrednost domena zadovoljila formulu, vracamo true
+                return true;
+            }
+            // Ako je egzistencijalni kvantifikator, provedemo evaluaciju za svaku vrednost iz domena
             // Pravimo kopiju valuacije (nije efikasno, ali nam je okej)
             Valuation valQuantified(val);
             // Za svaku vrednost domena postavljamo vrednost promenljiive i evaluiramo potformulu
@@ -205,9 +365,7 @@ bool evaluate(const FormulaPtr& formula, const LStructure& s, const Valuation& v
                     return true;
             }
             return false;
-        }
-    }
-    return false;
+        });
 }
 
 // Dohvatanje svih promenljivih koje se pojavljuju u formuli
@@ -234,38 +392,36 @@ void getVariables(const TermPtr& term, std::set<std::string>& vars) {
 }
 
 void getVariables(const FormulaPtr& formula, std::set<std::string>& vars, bool includeBound) {
-    if (is<Atom>(formula)) {
-        for(const auto& arg : as<Atom>(formula).args)
-            getVariables(arg, vars);
-    }
-    if (is<Not>(formula))
-        getVariables(as<Not>(formula).subformula, vars, includeBound);
-    if (is<Binary>(formula)) {
-        auto binary = as<Binary>(formula);
-        getVariables(binary.l, vars, includeBound);
-        getVariables(binary.r, vars, includeBound);
-    }
-    if (is<Quantifier>(formula)) {
+    match(formula,
+        [&](const Atom& atom) {
+            for(const auto& arg : atom.args)
+                getVariables(arg, vars);
+        },
+        [&](const Not& n) { getVariables(n.subformula, vars, includeBound); },
+        [&](const Binary& binary) {
+            getVariables(binary.l, vars, includeBound);
+            getVariables(binary.r, vars, includeBound);
+        },
         // Ako je kvantifikator, imamo dve varijante u zavisnosti od toga da li trazimo samo slobodne promenljive
-        auto qf = as<Quantifier>(formula);
-        // Ako trazimo sve promenljive, dodajemo promenljivu kvantifikatora u skup i rekurzivno trazimo promenljive u potformuli
-        if (includeBound) {
-            getVariables(qf.subformula, vars, includeBound);
-            vars.insert(qf.var);
-        }
-        // Ako trazimo samo slobodne promenljive:
-        // 1. Dohvatamo promenljive u potformuli u poseban skup
-        // 2. Uklanjamo kvantifikovanu promenljivu iz tog skupa (jer je vezana)
-        // 3. Dodajemo preostale promenljive u glavni skup promenljivih
-        // Ovo mozemo optimizovati tako sto odmah dodamo sve u skup, a zatim uklonimo kvantifikovanu promenljivu
-        // samo ako je nismo imali u skupu pre toga - ovo implementiramo
-        else {
-            bool varHasFreeOccurrence = vars.contains(qf.var);
-            getVariables(qf.subformula, vars, includeBound);
-            if (!varHasFreeOccurrence)
-                vars.erase(qf.var);
-        }
-    }
+        [&](const Quantifier& qf) {
+            // Ako trazimo sve promenljive, dodajemo promenljivu kvantifikatora u skup i rekurzivno trazimo promenljive u potformuli
+            if (includeBound) {
+                getVariables(qf.subformula, vars, includeBound);
+                vars.insert(qf.var);
+            }
+            // Ako trazimo samo slobodne promenljive:
+            // 1. Dohvatamo promenljive u potformuli u poseban skup
+            // 2. Uklanjamo kvantifikovanu promenljivu iz tog skupa (jer je vezana)
+            // 3. Dodajemo preostale promenljive u glavni skup promenljivih
+            // Ovo mozemo optimizovati tako sto odmah dodamo sve u skup, a zatim uklonimo kvantifikovanu promenljivu
+            // samo ako je nismo imali u skupu pre toga - ovo implementiramo
+            else {
+                bool varHasFreeOccurrence = vars.contains(qf.var);
+                getVariables(qf.subformula, vars, includeBound);
+                if (!varHasFreeOccurrence)
+                    vars.erase(qf.var);
+            }
+        });
 }
 
 bool containsVariable(const TermPtr& term, const std::string& var) {
@@ -319,7 +475,7 @@ TermPtr substitute(const TermPtr& term, const std::string& var, const TermPtr& s
     }
     // Ako je funkcija, rekurzivno smenjujemo pojavljivanja promenljive u argumentima
     if(is<Function>(term)) {
-        auto function = as<Function>(term);
+        const auto& function = as<Function>(term);
         std::vector<TermPtr> args;
         for(const auto& arg : function.args)
             args.push_back(substitute(arg, var, subterm));
@@ -329,35 +485,31 @@ TermPtr substitute(const TermPtr& term, const std::string& var, const TermPtr& s
 }
 
 FormulaPtr substitute(const FormulaPtr& formula, const std::string& var, const TermPtr& term) {
-    // Ako je atomicna formula, rekurzivno smenjujemo pojavljivanja promenljive u argumentima
-    if(is<Atom>(formula)) {
-        auto atom = as<Atom>(formula);
-        std::vector<TermPtr> args;
-        for(const auto& arg : atom.args)
-            args.push_back(substitute(arg, var, term));
-        return ptr(Atom{atom.symbol, args});
-    }
-    if(is<Not>(formula))
-        return ptr(Not{substitute(as<Not>(formula).subformula, var, term)});
-    if(is<Binary>(formula)) {
-        auto binary = as<Binary>(formula);
-        return ptr(Binary{binary.type, substitute(binary.l, var, term), substitute(binary.r, var, term)});
-    }
-    if(is<Quantifier>(formula)) {
-        auto qf = as<Quantifier>(formula);
-        if (qf.var == var)
-            return formula;
-        if (containsVariable(term, qf.var)) {
-            std::string u = uniqueVar(formula, term);
-            // U potformuli smenjujemo vezanu promenljivu novom promenljivom "u"
-            FormulaPtr subformula = substitute(qf.subformula, qf.var, ptr(Variable{u}));
-            // Primenjujemo smenu nad potformulom i vracamo formulu kvantifikovanu promenljivom "u"
-            return ptr(Quantifier{qf.type, u, substitute(subformula, var, term)});
-        }
-        // Primenjujemo smenu nad potformulom i vracamo kvantifikovanu formulu
-        return ptr(Quantifier{qf.type, qf.var, substitute(qf.subformula, var, term)});
-    }
-    return nullptr;
+    return match(formula,
+        // Ako je atomicna formula, rekurzivno smenjujemo pojavljivanja promenljive u argumentima
+        [&](const Atom& atom) {
+            std::vector<TermPtr> args;
+            for(const auto& arg : atom.args)
+                args.push_back(substitute(arg, var, term));
+            return ptr(Atom{atom.symbol, args});
+        },
+        [&](const Not& n) { return ptr(Not{substitute(n.subformula, var, term)}); },
+        [&](const Binary& binary) {
+            return ptr(Binary{binary.type, substitute(binary.l, var, term), substitute(binary.r, var, term)});
+        },
+        [&](const Quantifier& qf) {
+            if (qf.var == var)
+                return formula;
+            if (containsVariable(term, qf.var)) {
+                std::string u = uniqueVar(formula, term);
+                // U potformuli smenjujemo vezanu promenljivu novom promenljivom "u"
+                FormulaPtr subformula = substitute(qf.subformula, qf.var, ptr(Variable{u}));
+                // Primenjujemo smenu nad potformulom i vracamo formulu kvantifikovanu promenljivom "u"
+                return ptr(Quantifier{qf.type, u, substitute(subformula, var, term)});
+            }
+            // Primenjujemo smenu nad potformulom i vracamo kvantifikovanu formulu
+            return ptr(Quantifier{qf.type, qf.var, substitute(qf.subformula, var, term)});
+        });
 }
 
 // Ispis formule
@@ -366,7 +518,7 @@ void print(const TermPtr& term) {
     if (is<Variable>(term))
         std::cout << as<Variable>(term).name;
     if (is<Function>(term)) {
-        auto function = as<Function>(term);
+        const auto& function = as<Function>(term);
         std::cout << function.symbol;
         if(!function.args.empty()) {
             std::cout << "(";
@@ -381,45 +533,143 @@ void print(const TermPtr& term) {
 }
 
 void print(const FormulaPtr& formula) {
-    if(is<Atom>(formula)) {
-        auto atom = as<Atom>(formula);
-        std::cout << atom.symbol;
-        if(!atom.args.empty()) {
+    match(formula,
+        [](const Atom& atom) {
+            std::cout << atom.symbol;
+            if(!atom.args.empty()) {
+                std::cout << "(";
+                print(atom.args[0]);
+                for (unsigned i = 1; i < atom.args.size(); i++) {
+                    std::cout << ", ";
+                    print(atom.args[i]);
+                }
+                std::cout << ")";
+            }
+        },
+        [](const Not& n) {
+            std::cout << "~";
+            print(n.subformula);
+        },
+        [](const Binary& binary) {
             std::cout << "(";
-            print(atom.args[0]);
-            for (unsigned i = 1; i < atom.args.size(); i++) {
-                std::cout << ", ";
-                print(atom.args[i]);
+            print(binary.l);
+            switch(binary.type) {
+                case Binary::And:  std::cout << " & "; break;
+                case Binary::Or:   std::cout << " | "; break;
+                case Binary::Impl: std::cout << " -> "; break;
+                case Binary::Eq:   std::cout << " <-> "; break;
             }
+            print(binary.r);
             std::cout << ")";
+        },
+        [](const Quantifier& qf) {
+            switch(qf.type) {
+                case Quantifier::All: std::cout << "A"; break;
+                case Quantifier::Exists: std::cout << "E"; break;
+            }
+            std::cout << qf.var << " ";
+            print(qf.subformula);
+        });
+}
+
+
+// Binarni zapis formula (../04_sat/dag.h)
+// Termovi i formule su u istoj tabeli cvorova, a cvor koji se deli (isti pokazivac) se zapisuje jednom
+constexpr char FolFormat[] = "FDAG";
+
+enum FolNodeKind : std::uint8_t { VariableNode, FunctionNode, AtomNode, NotNode, BinaryNode, AllNode = BinaryNode + 4, ExistsNode };
+
+struct FolWriter {
+    DagWriter dag{FolFormat};
+    std::unordered_map<const void*, std::uint32_t> indices;
+
+    std::uint32_t add(const TermPtr& term) {
+        if(auto it = indices.find(term.get()); it != indices.end())
+            return it->second;
+        std::uint32_t index;
+        if(is<Variable>(term))
+            index = dag.add(VariableNode, as<Variable>(term).name, {});
+        else {
+            const auto& function = as<Function>(term);
+            std::vector<std::uint32_t> args;
+            for(const auto& arg : function.args)
+                args.push_back(add(arg));
+            index = dag.add(FunctionNode, function.symbol, args);
         }
+        return indices[term.get()] = index;
     }
-    if(is<Not>(formula)) {
-        std::cout << "~";
-        print(as<Not>(formula).subformula);
+
+    std::uint32_t add(const FormulaPtr& formula) {
+        if(auto it = indices.find(formula.get()); it != indices.end())
+            return it->second;
+        std::uint32_t index = match(formula,
+            [&](const Atom& atom) {
+                std::vector<std::uint32_t> args;
+                for(const auto& arg : atom.args)
+                    args.push_back(add(arg));
+                return dag.add(AtomNode, atom.symbol, args);
+            },
+            [&](const Not& n) { return dag.add(NotNode, {}, {add(n.subformula)}); },
+            [&](const Binary& binary) {
+                std::uint32_t l = add(binary.l);
+                return dag.add(std::uint8_t(BinaryNode + int(binary.type)), {}, {l, add(binary.r)});
+            },
+            [&](const Quantifier& qf) { return dag.add(std::uint8_t(AllNode + int(qf.type)), qf.var, {add(qf.subformula)}); });
+        return indices[formula.get()] = index;
     }
-    if(is<Binary>(formula)) {
-        auto binary = as<Binary>(formula);
-        std::cout << "(";
-        print(binary.l);
-        switch(binary.type) {
-            case Binary::And:  std::cout << " & "; break;
-            case Binary::Or:   std::cout << " | "; break;
-            case Binary::Impl: std::cout << " -> "; break;
-            case Binary::Eq:   std::cout << " <-> "; break;
-        }
-        print(binary.r);
-        std::cout << ")";
+};
+
+void save(const std::vector<FormulaPtr>& formulas, std::ostream& out) {
+    FolWriter writer;
+    for(const auto& formula : formulas)
+        writer.dag.root(writer.add(formula));
+    writer.dag.write(out);
+}
+
+// Ucitava formule iz zapisa (npr. mapiranog fajla), uz proveru da je svaki cvor ispravan:
+// argumenti funkcija i atoma moraju biti termovi, a potformule formule
+bool load(std::string_view bytes, std::vector<FormulaPtr>& formulas) {
+    DagImage image;
+    if(!image.open(bytes, FolFormat))
+        return false;
+    std::vector<TermPtr> terms(image.nodeCount);
+    std::vector<FormulaPtr> nodes(image.nodeCount);
+    for(std::uint32_t i = 0; i < image.nodeCount; i++) {
+        DagNode node = image.node(i);
+        std::vector<std::uint32_t> children(node.childCount);
+        for(auto& child : children)
+            child = node.child();
+        bool termArgs = node.kind == FunctionNode || node.kind == AtomNode;
+        for(std::uint32_t child : children)
+            if(termArgs ? !terms[child] : !nodes[child])
+                return false;
+        std::vector<TermPtr> args;
+        if(termArgs)
+            for(std::uint32_t child : children)
+                args.push_back(terms[child]);
+        std::string symbol(node.symbol);
+
+        if(node.kind == VariableNode && children.empty())
+            terms[i] = ptr(Variable{symbol});
+        else if(node.kind == FunctionNode)
+            terms[i] = ptr(Function{symbol, args});
+        else if(node.kind == AtomNode)
+            nodes[i] = ptr(Atom{symbol, args});
+        else if(node.kind == NotNode && children.size() == 1)
+            nodes[i] = ptr(Not{nodes[children[0]]});
+        else if(node.kind >= BinaryNode && node.kind < AllNode && children.size() == 2)
+            nodes[i] = ptr(Binary{Binary::Type(node.kind - BinaryNode), nodes[children[0]], nodes[children[1]]});
+        else if((node.kind == AllNode || node.kind == ExistsNode) && children.size() == 1)
+            nodes[i] = ptr(Quantifier{Quantifier::Type(node.kind - AllNode), symbol, nodes[children[0]]});
+        else
+            return false;
     }
-    if(is<Quantifier>(formula)) {
-        auto qf = as<Quantifier>(formula);
-        switch(qf.type) {
-            case Quantifier::All: std::cout << "A"; break;
-            case Quantifier::Exists: std::cout << "E"; break;
-        }
-        std::cout << qf.var << " ";
-        print(qf.subformula);
+    for(std::uint32_t i = 0; i < image.rootCount; i++) {
+        if(!nodes[image.root(i)])
+            return false;
+        formulas.push_back(nodes[image.root(i)]);
     }
+    return true;
 }
 
 #endif //FOL_H
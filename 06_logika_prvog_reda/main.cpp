@@ -1,3 +1,5 @@
+#include <sstream>
+
 #include "fol.h"
 
 unsigned zero(const std::vector<unsigned>&) { return 0; }
@@ -60,5 +62,16 @@ int main() {
         print(sub); std::cout << std::endl;
     }
 
+    // Binarni zapis: formule se cuvaju u bafer u memoriji i ponovo ucitavaju iz njega
+    std::stringstream buffer;
+    save({existsEvenAndOddX, existsY, sub}, buffer);
+    std::vector<FormulaPtr> loaded;
+    if(load(buffer.str(), loaded)) {
+        std::cout << "nakon ucitavanja:" << std::endl;
+        for(const auto& formula : loaded) {
+            print(formula); std::cout << std::endl;
+        }
+    }
+
     return 0;
 }